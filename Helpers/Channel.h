@@ -0,0 +1,208 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "Platform.h"        // _mm_pause
+
+// --- КАНАЛ: PRODUCER-CONSUMER С BOUNDED QUEUE ---
+// Мьютекс + две condvar. Пайплайн дампа работает на Ring (ниже), Chan остаётся
+// простой эталонной реализацией — с ним сравнивает -bench.
+template<typename T>
+struct Chan {
+    std::deque<T>           q;
+    std::mutex              mtx;
+    std::condition_variable cv_pop, cv_push;
+    size_t                  cap;
+    bool                    closed = false;
+
+    explicit Chan(size_t c) : cap(c) {}
+
+    // Возвращает false если канал закрыт
+    bool send(T item) {
+        std::unique_lock<std::mutex> lk(mtx);
+        cv_push.wait(lk, [&]{ return q.size() < cap || closed; });
+        if (closed) return false;
+        q.push_back(std::move(item));
+        cv_pop.notify_one();
+        return true;
+    }
+
+    // Возвращает false когда закрыт И пуст
+    bool recv(T& item) {
+        std::unique_lock<std::mutex> lk(mtx);
+        cv_pop.wait(lk, [&]{ return !q.empty() || closed; });
+        if (q.empty()) return false;
+        item = std::move(q.front());
+        q.pop_front();
+        cv_push.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lk(mtx);
+        closed = true;
+        cv_pop.notify_all();
+        cv_push.notify_all();
+    }
+};
+
+// --- КАНАЛ: LOCK-FREE BOUNDED MPMC RING ---
+// Кольцо слотов с номерами последовательности (схема Вьюкова): send/recv — один CAS
+// на позицию, без мьютекса. Ожидание: короткий spin на _mm_pause, затем парковка на
+// C++20 atomic::wait (WaitOnAddress). Будим, только если кто-то реально спит, и один
+// раз на batch. close() — как у Chan: send → false, recv дочитывает остаток и
+// возвращает false на пустом закрытом канале. Закрывать — после выхода продюсеров.
+template<typename T>
+struct Ring {
+    struct alignas(64) Slot {
+        std::atomic<size_t> seq;
+        T                   val;
+    };
+
+    static const int kSpin = 128;
+
+    std::unique_ptr<Slot[]> slots;
+    size_t                  mask;
+
+    alignas(64) std::atomic<size_t>   head{ 0 };        // следующая позиция записи
+    alignas(64) std::atomic<size_t>   tail{ 0 };        // следующая позиция чтения
+    alignas(64) std::atomic<unsigned> pushEpoch{ 0 };   // «появились данные»
+    std::atomic<int>                  sleepingRecv{ 0 };
+    alignas(64) std::atomic<unsigned> popEpoch{ 0 };    // «освободилось место»
+    std::atomic<int>                  sleepingSend{ 0 };
+    std::atomic<bool>                 closed{ false };
+
+    // Ёмкость округляется вверх до степени двойки
+    explicit Ring(size_t c) {
+        size_t cap = 2;
+        while (cap < c) cap <<= 1;
+        slots.reset(new Slot[cap]);
+        for (size_t i = 0; i < cap; ++i) slots[i].seq.store(i, std::memory_order_relaxed);
+        mask = cap - 1;
+    }
+
+    // Не блокируются. При неудаче item не тронут.
+    bool trySend(T& item) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& s = slots[pos & mask];
+            const size_t   seq = s.seq.load(std::memory_order_acquire);
+            const intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    s.val = std::move(item);
+                    s.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false;                                   // полон
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryRecv(T& item) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& s = slots[pos & mask];
+            const size_t   seq = s.seq.load(std::memory_order_acquire);
+            const intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (dif == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    item = std::move(s.val);
+                    s.seq.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false;                                   // пуст
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Публикация → fence → проверка спящих; у спящего: счётчик → fence → повторная попытка.
+    // Одна из сторон обязательно увидит другую, потерянных пробуждений нет.
+    static void wake(std::atomic<unsigned>& epoch, std::atomic<int>& sleeping) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) > 0) {
+            epoch.fetch_add(1, std::memory_order_release);
+            epoch.notify_all();
+        }
+    }
+
+    // Возвращает false если канал закрыт
+    bool send(T item) {
+        for (int spin = 0;; ++spin) {
+            if (closed.load(std::memory_order_acquire)) return false;
+            if (trySend(item)) { wake(pushEpoch, sleepingRecv); return true; }
+            if (spin < kSpin) { _mm_pause(); continue; }
+
+            const unsigned key = popEpoch.load(std::memory_order_acquire);
+            sleepingSend.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const bool ok = !closed.load() && trySend(item);
+            if (!ok && !closed.load()) popEpoch.wait(key);
+            sleepingSend.fetch_sub(1);
+            if (ok) { wake(pushEpoch, sleepingRecv); return true; }
+        }
+    }
+
+    // Возвращает false когда закрыт И пуст
+    bool recv(T& item) {
+        for (int spin = 0;; ++spin) {
+            if (tryRecv(item)) { wake(popEpoch, sleepingSend); return true; }
+            if (closed.load(std::memory_order_acquire)) {
+                if (!tryRecv(item)) return false;
+                wake(popEpoch, sleepingSend);
+                return true;
+            }
+            if (spin < kSpin) { _mm_pause(); continue; }
+
+            const unsigned key = pushEpoch.load(std::memory_order_acquire);
+            sleepingRecv.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const bool ok = tryRecv(item);
+            if (!ok && !closed.load()) pushEpoch.wait(key);
+            sleepingRecv.fetch_sub(1);
+            if (ok) { wake(popEpoch, sleepingSend); return true; }
+        }
+    }
+
+    // Отправляет все n (блокируясь при заполнении); меньше n — только если канал закрыли
+    size_t sendBatch(T* items, size_t n) {
+        size_t sent = 0;
+        while (sent < n && !closed.load(std::memory_order_acquire)) {
+            if (trySend(items[sent])) { ++sent; continue; }
+            wake(pushEpoch, sleepingRecv);          // отдаём накопленное, ждём места
+            if (!send(std::move(items[sent]))) break;
+            ++sent;
+        }
+        wake(pushEpoch, sleepingRecv);
+        return sent;
+    }
+
+    // Ждёт хотя бы один элемент, затем забирает до maxN без ожидания; 0 — закрыт и пуст
+    size_t recvBatch(T* out, size_t maxN) {
+        if (maxN == 0 || !recv(out[0])) return 0;
+        size_t n = 1;
+        while (n < maxN && tryRecv(out[n])) ++n;
+        if (n > 1) wake(popEpoch, sleepingSend);
+        return n;
+    }
+
+    // Приблизительное число элементов (для сэмплера трассировки)
+    size_t depth() const {
+        const size_t h = head.load(std::memory_order_relaxed), t = tail.load(std::memory_order_relaxed);
+        return h > t ? h - t : 0;
+    }
+
+    void close() {
+        closed.store(true);
+        pushEpoch.fetch_add(1); pushEpoch.notify_all();
+        popEpoch.fetch_add(1);  popEpoch.notify_all();
+    }
+};
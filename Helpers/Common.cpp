@@ -0,0 +1,36 @@
+#include "Common.h"
+
+bool FileExists(const std::wstring& path) {
+    DWORD a = GetFileAttributesW(path.c_str());
+    return a != INVALID_FILE_ATTRIBUTES && !(a & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+bool ReadWholeFile(const wchar_t* path, std::string& data) {
+    HANDLE h = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (h == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fsz;
+    bool ok = GetFileSizeEx(h, &fsz) != 0;
+    if (ok) {
+        data.resize((size_t)fsz.QuadPart);
+        size_t done = 0;
+        while (ok && done < data.size()) {
+            DWORD got  = 0;
+            DWORD want = (DWORD)min(data.size() - done, (size_t)64 * 1024 * 1024);
+            ok = ReadFile(h, &data[done], want, &got, NULL) && got > 0;
+            done += got;
+        }
+    }
+    CloseHandle(h);
+    return ok;
+}
+
+bool WriteWholeFile(const std::wstring& path, const std::string& data) {
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    DWORD w = 0;
+    BOOL ok = WriteFile(h, data.data(), (DWORD)data.size(), &w, NULL);
+    CloseHandle(h);
+    return ok && w == data.size();
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+
+// --- ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ: ВРЕМЯ И ФАЙЛЫ ЦЕЛИКОМ ---
+// Общие для ядра, форматов выходных файлов и фронтендов.
+
+inline LONGLONG QpcNow() {
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return t.QuadPart;
+}
+
+inline double QpcToMs(LONGLONG ticks) {
+    static const double msPerTick = []() {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        return 1000.0 / (double)f.QuadPart;
+    }();
+    return (double)ticks * msPerTick;
+}
+
+bool FileExists(const std::wstring& path);
+bool ReadWholeFile(const wchar_t* path, std::string& data);
+bool WriteWholeFile(const std::wstring& path, const std::string& data);
@@ -0,0 +1,919 @@
+#pragma once
+#include "Platform.h"
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <immintrin.h>   // AVX2
+
+// --- ТРАНСФОРМЫ КОНТЕНТА: ЗАМЕНА std::regex ОДНИМ ПРОХОДОМ ---
+// Каждый трансформ — потоковый распознаватель одного вида «шума» со строкой замены:
+//   HexArrayFilter     =\s*\{[allowed_chars]{50,}\};  → "= { /* HEX DATA HIDDEN */ };"
+//                      allowed_chars: пробел, таб, \r, \n, 0-9, a-f, A-F, x, X, запятая
+//   Base64Filter       payload после ";base64," (data: URI) от 64 символов и строка
+//                      в кавычках из одного base64 от 256 (нужны оба регистра и цифры)
+//   SpaceRunFilter     пробельная серия с 3+ переводами строки → одна пустая строка,
+//                      без переводов строки от 64 байт → один пробел
+//   MinifiedLineFilter строка от 4 КБ (минифицированный JS/CSS, JSON в одну строку)
+//
+// ContentFilter<Ts...> собирает включённые трансформы на этапе компиляции в один
+// сканер: SIMD-поиск идёт по объединению масок триггеров всех Ts (блок загружается
+// один раз на всех), на триггере трансформы пробуются в порядке списка, и дальше
+// байты потребляет только тот, кто начал кандидата. Провал — разбор продолжается
+// с позиции, которую назвал трансформ (обычно символ, сорвавший совпадение).
+//
+// Вход подаётся окнами любого размера, незавершённое совпадение переживает границу
+// окна. Байты не копируются и не буферизуются: в sink уходят диапазоны исходника
+// (абсолютные смещения) и строки замены. Провалившийся кандидат отдаётся как есть
+// своим диапазоном, поэтому память O(1) при любой длине кандидата. Замена всегда
+// короче заменяемого — вывод не длиннее входа.
+//
+// Sink: literal(const char*, size_t) и source(ULONGLONG off, ULONGLONG len);
+// диапазоны source идут подряд, по возрастанию смещений.
+
+__forceinline bool IsHexBodyChar(unsigned char c) {
+    return (c >= '0' && c <= '9') ||
+           (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F') ||
+           c == 'x' || c == 'X'  || c == ',' ||
+           c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// --- SIMD КЛАССИФИКАТОРЫ ТРАНСФОРМОВ ---
+// Те же слои, что у HasNullByte: AVX2 (32 байта) → SSE2 (16) → скалярный хвост.
+// Разрешённые байты тела за один проход по блоку: цифры и a-f — через беззнаковое
+// сравнение диапазона (min_epu8), A-F и X сводятся к нижнему регистру через c|0x20.
+
+__forceinline bool IsSpaceChar(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+#if defined(__AVX2__)
+__forceinline __m256i SpaceMask256(__m256i v) {
+    return _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),  _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+}
+
+__forceinline __m256i HexBodyMask256(__m256i v) {
+    const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    const __m256i d     = _mm256_sub_epi8(v,     _mm256_set1_epi8('0'));
+    const __m256i a     = _mm256_sub_epi8(lower, _mm256_set1_epi8('a'));
+    __m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);        // 0-9
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(_mm256_min_epu8(a, _mm256_set1_epi8(5)), a)); // a-f A-F
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('x')));          // x X
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v,     _mm256_set1_epi8(',')));
+    return _mm256_or_si256(m, SpaceMask256(v));
+}
+#endif
+
+__forceinline __m128i SpaceMask128(__m128i v) {
+    return _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),  _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+}
+
+__forceinline __m128i HexBodyMask128(__m128i v) {
+    const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    const __m128i d     = _mm_sub_epi8(v,     _mm_set1_epi8('0'));
+    const __m128i a     = _mm_sub_epi8(lower, _mm_set1_epi8('a'));
+    __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_min_epu8(a, _mm_set1_epi8(5)), a));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(lower, _mm_set1_epi8('x')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v,     _mm_set1_epi8(',')));
+    return _mm_or_si128(m, SpaceMask128(v));
+}
+
+// Первый байт, не входящий в тело hex-массива (в т.ч. '}'), или end
+inline const char* SkipHexBody(const char* p, const char* end) {
+    unsigned long i;
+#if defined(__AVX2__)
+    for (; p + 32 <= end; p += 32) {
+        unsigned bad = ~(unsigned)_mm256_movemask_epi8(HexBodyMask256(_mm256_loadu_si256((const __m256i*)p)));
+        if (bad) { _BitScanForward(&i, bad); return p + i; }
+    }
+#endif
+    for (; p + 16 <= end; p += 16) {
+        unsigned bad = ~(unsigned)_mm_movemask_epi8(HexBodyMask128(_mm_loadu_si128((const __m128i*)p))) & 0xFFFF;
+        if (bad) { _BitScanForward(&i, bad); return p + i; }
+    }
+    for (; p < end; ++p)
+        if (!IsHexBodyChar((unsigned char)*p)) return p;
+    return end;
+}
+
+// Байт base64-алфавита: A-Z a-z 0-9 + /
+__forceinline bool IsBase64Char(unsigned char c) {
+    const unsigned char l = c | 0x20;
+    return (l >= 'a' && l <= 'z') || (c >= '0' && c <= '9') || c == '+' || c == '/';
+}
+
+#if defined(__AVX2__)
+__forceinline __m256i Base64Mask256(__m256i v) {
+    const __m256i l = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    const __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+    __m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(l, _mm256_set1_epi8(25)), l);
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('+')));
+    return _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')));
+}
+#endif
+
+__forceinline __m128i Base64Mask128(__m128i v) {
+    const __m128i l = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    const __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(25)), l);
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('+')));
+    return _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+}
+
+// Классы байт серии для проверки «похоже на base64, а не на слово»
+enum { kB64Upper = 1, kB64Lower = 2, kB64Digit = 4 };
+
+__forceinline unsigned Base64Classes128(__m128i v, unsigned keep) {
+    const __m128i u = _mm_sub_epi8(v, _mm_set1_epi8('A'));
+    const __m128i l = _mm_sub_epi8(v, _mm_set1_epi8('a'));
+    const __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    unsigned cls = 0;
+    if ((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(u, _mm_set1_epi8(25)), u)) & keep) cls |= kB64Upper;
+    if ((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(25)), l)) & keep) cls |= kB64Lower;
+    if ((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d)) & keep)  cls |= kB64Digit;
+    return cls;
+}
+
+// Первый байт не из base64-алфавита или end; cls копит классы пройденных байт.
+// Классы считаются только по SSE2-блокам: на серии от 256 байт их хватает.
+inline const char* SkipBase64(const char* p, const char* end, unsigned& cls) {
+    unsigned long i;
+    for (; p + 16 <= end; p += 16) {
+        const __m128i  v   = _mm_loadu_si128((const __m128i*)p);
+        const unsigned bad = ~(unsigned)_mm_movemask_epi8(Base64Mask128(v)) & 0xFFFF;
+        if (cls != (kB64Upper | kB64Lower | kB64Digit)) cls |= Base64Classes128(v, bad ? ~bad & (bad - 1) : 0xFFFF);
+        if (bad) { _BitScanForward(&i, bad); return p + i; }
+    }
+    for (; p < end; ++p) {
+        const unsigned char c = (unsigned char)*p;
+        if (!IsBase64Char(c)) return p;
+        cls |= c >= 'A' && c <= 'Z' ? kB64Upper : c >= 'a' && c <= 'z' ? kB64Lower : c >= '0' && c <= '9' ? kB64Digit : 0;
+    }
+    return end;
+}
+
+// Первый непробельный байт или end; попутно считает '\n' и запоминает последний
+inline const char* SkipSpaceRun(const char* p, const char* end, int& breaks, const char*& lastNl) {
+    unsigned long i;
+#if defined(__AVX2__)
+    for (; p + 32 <= end; p += 32) {
+        const __m256i  v    = _mm256_loadu_si256((const __m256i*)p);
+        const unsigned stop = ~(unsigned)_mm256_movemask_epi8(SpaceMask256(v));
+        unsigned       nl   = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+        if (stop) { _BitScanForward(&i, stop); nl &= (1u << i) - 1; }
+        if (nl)   { unsigned long last; _BitScanReverse(&last, nl); lastNl = p + last; }
+        for (; nl; nl &= nl - 1) ++breaks;
+        if (stop) return p + i;
+    }
+#endif
+    for (; p + 16 <= end; p += 16) {
+        const __m128i  v    = _mm_loadu_si128((const __m128i*)p);
+        const unsigned stop = ~(unsigned)_mm_movemask_epi8(SpaceMask128(v)) & 0xFFFF;
+        unsigned       nl   = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        if (stop) { _BitScanForward(&i, stop); nl &= (1u << i) - 1; }
+        if (nl)   { unsigned long last; _BitScanReverse(&last, nl); lastNl = p + last; }
+        for (; nl; nl &= nl - 1) ++breaks;
+        if (stop) return p + i;
+    }
+    for (; p < end && IsSpaceChar(*p); ++p)
+        if (*p == '\n') { ++breaks; lastNl = p; }
+    return p;
+}
+
+// Маски триггеров считаются в битах, а не в векторах: бит i — байт p[i] из класса.
+// Слово покрывает два блока (AVX2: 64 бита на p[0..64), SSE2: 32 на p[0..32)), так что
+// условия «и через k байт» — сдвиги слова вправо, а второй блок служит lookahead.
+// Одинаковые загрузки у разных трансформов компилятор сводит в одну.
+#if defined(__AVX2__)
+__forceinline ULONGLONG BitsOf256(__m256i lo, __m256i hi) {
+    return (ULONGLONG)(unsigned)_mm256_movemask_epi8(lo) | (ULONGLONG)(unsigned)_mm256_movemask_epi8(hi) << 32;
+}
+
+__forceinline ULONGLONG ByteBits64(const char* p, char c) {
+    const __m256i k = _mm256_set1_epi8(c);
+    return BitsOf256(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), k),
+                     _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 32)), k));
+}
+
+__forceinline ULONGLONG SpaceBits64(const char* p) {
+    return BitsOf256(SpaceMask256(_mm256_loadu_si256((const __m256i*)p)),
+                     SpaceMask256(_mm256_loadu_si256((const __m256i*)(p + 32))));
+}
+
+__forceinline ULONGLONG Base64Bits64(const char* p) {
+    return BitsOf256(Base64Mask256(_mm256_loadu_si256((const __m256i*)p)),
+                     Base64Mask256(_mm256_loadu_si256((const __m256i*)(p + 32))));
+}
+#endif
+
+__forceinline unsigned BitsOf128(__m128i lo, __m128i hi) {
+    return (unsigned)_mm_movemask_epi8(lo) | (unsigned)_mm_movemask_epi8(hi) << 16;
+}
+
+__forceinline unsigned ByteBits32(const char* p, char c) {
+    const __m128i k = _mm_set1_epi8(c);
+    return BitsOf128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), k),
+                     _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 16)), k));
+}
+
+__forceinline unsigned SpaceBits32(const char* p) {
+    return BitsOf128(SpaceMask128(_mm_loadu_si128((const __m128i*)p)),
+                     SpaceMask128(_mm_loadu_si128((const __m128i*)(p + 16))));
+}
+
+__forceinline unsigned Base64Bits32(const char* p) {
+    return BitsOf128(Base64Mask128(_mm_loadu_si128((const __m128i*)p)),
+                     Base64Mask128(_mm_loadu_si128((const __m128i*)(p + 16))));
+}
+
+enum FilterVerdict { kXfMore, kXfReject, kXfMatch };
+
+// kXfMatch: [from, to) заменяется на lit; kXfReject: разбор продолжается с to
+struct FilterMatch {
+    ULONGLONG   from = 0;
+    ULONGLONG   to   = 0;
+    const char* lit  = nullptr;
+    size_t      len  = 0;
+};
+
+__forceinline FilterVerdict FilterReject(FilterMatch& m, ULONGLONG at) {
+    m.to = at;
+    return kXfReject;
+}
+
+__forceinline FilterVerdict FilterReplace(FilterMatch& m, ULONGLONG from, ULONGLONG to, const char* lit, size_t len) {
+    m.from = from; m.to = to; m.lit = lit; m.len = len;
+    return kXfMatch;
+}
+
+// Интерфейс трансформа (используется ContentFilter):
+//   kLookahead — на сколько байт дальше позиции смотрит её триггер;
+//   Trigger32/Trigger16(p) — биты позиций блока p[0..32) / p[0..16), где кандидат
+//       возможен; маски читают не дальше блока + max(32, kLookahead);
+//   Trigger(p, end) — то же скалярно; у конца окна, где lookahead не виден, — true;
+//   begin(p, end, pos, first, last) — начать кандидата с *p (точная проверка);
+//       first — p начало входа, last — окно последнее;
+//   step(p, base, cur, end, m) — потребить байты с cur (окно p с абсолютного base);
+//   finish(end, m) — вход кончился посреди кандидата.
+// Отказ с возвратом к самому триггеру значит «begin здесь не состоялся»: в этой
+// позиции пробуются следующие по приоритету трансформы.
+
+// Hex-массив: "=", пробельные, "{", тело из allowed_chars, "}", ";"
+struct HexArrayFilter {
+    static constexpr int kLookahead = 2;
+
+    enum Phase { kAfterEq, kBody, kAfterBrace };
+
+    Phase     phase = kAfterEq;
+    ULONGLONG eqPos = 0;   // '=' кандидата
+    ULONGLONG count = 0;   // байт в теле
+
+    // '=', за которым '{' или пробельный, а следом '{' или снова пробельный: остальные
+    // '=' автомат отверг бы на первом же символе
+    template<typename W>
+    static __forceinline W Mask(W eq, W br, W ws) { return eq & ((br >> 1) | ((ws >> 1) & ((br | ws) >> 2))); }
+#if defined(__AVX2__)
+    static __forceinline unsigned Trigger32(const char* p) {
+        const ULONGLONG eq = ByteBits64(p, '=');
+        return (unsigned)eq ? (unsigned)Mask(eq, ByteBits64(p, '{'), SpaceBits64(p)) : 0;
+    }
+#endif
+    static __forceinline unsigned Trigger16(const char* p) {
+        const unsigned eq = ByteBits32(p, '=');
+        return eq & 0xFFFF ? Mask(eq, ByteBits32(p, '{'), SpaceBits32(p)) & 0xFFFF : 0;
+    }
+    static __forceinline bool Trigger(const char* p, const char* end) {
+        if (*p != '=') return false;
+        if (p + 1 >= end || p[1] == '{') return true;
+        if (!IsSpaceChar(p[1])) return false;
+        return p + 2 >= end || p[2] == '{' || IsSpaceChar(p[2]);
+    }
+
+    bool begin(const char* p, const char*, ULONGLONG pos, bool, bool) {
+        if (*p != '=') return false;
+        phase = kAfterEq;
+        eqPos = pos;
+        count = 0;
+        return true;
+    }
+
+    FilterVerdict step(const char* p, ULONGLONG base, const char*& cur, const char* end, FilterMatch& m) {
+        while (cur < end) {
+            switch (phase) {
+            case kAfterEq:
+                // Пропускаем пробелы после '='; не '{' → они разбираются заново как текст
+                if (IsSpaceChar(*cur)) { ++cur; break; }
+                if (*cur != '{') return FilterReject(m, eqPos + 1);
+                ++cur;
+                phase = kBody;
+                break;
+            case kBody: {
+                // Сканируем тело: SIMD-прыжок сразу к первому неразрешённому байту
+                const char* s = SkipHexBody(cur, end);
+                count += (ULONGLONG)(s - cur);
+                cur = s;
+                if (cur == end) break;
+                if (*cur != '}') return FilterReject(m, base + (ULONGLONG)(cur - p));
+                ++cur;
+                phase = kAfterBrace;
+                break;
+            }
+            case kAfterBrace: {
+                if (*cur != ';') return FilterReject(m, base + (ULONGLONG)(cur - p));
+                ++cur;
+                const ULONGLONG at = base + (ULONGLONG)(cur - p);
+                if (count < 50) return FilterReject(m, at);
+                static const char kRepl[] = "= { /* HEX DATA HIDDEN */ };";
+                return FilterReplace(m, eqPos, at, kRepl, sizeof(kRepl) - 1);
+            }
+            }
+        }
+        return kXfMore;
+    }
+
+    // Незавершённый кандидат уходит как есть
+    FilterVerdict finish(ULONGLONG end, FilterMatch& m) { return FilterReject(m, end); }
+};
+
+// Base64: payload data: URI (триггер ";base64,") и строка целиком из base64 в кавычках
+// (триггер — кавычка и 4 байта алфавита за ней). Заменяется только payload,
+// "data:image/png;base64," и кавычки остаются.
+struct Base64Filter {
+    static constexpr int    kLookahead = 7;
+    static constexpr size_t kMinUri    = 64;
+    static constexpr size_t kMinQuoted = 256;
+
+    enum Phase { kTag, kRun, kPad };
+
+    Phase     phase = kTag;
+    char      quote = 0;        // 0 — data: URI, иначе закрывающая кавычка
+    int       tag   = 0;        // совпавших байт ";base64,"
+    int       pad   = 0;
+    unsigned  cls   = 0;
+    ULONGLONG start = 0;        // первый байт payload
+    ULONGLONG count = 0;
+
+    static const char* Tag() { return ";base64,"; }
+
+    template<typename W>
+    static __forceinline W Mask(W q, W sc, W b64, W b, W comma) {
+        return (q & (b64 >> 1) & (b64 >> 2) & (b64 >> 3) & (b64 >> 4)) | (sc & (b >> 1) & (comma >> 7));
+    }
+    // ';' в коде на каждой строке, кавычки тоже нередки: сначала дешёвая проверка
+    // кавычки или ";b" по одному блоку, полная маска — только если они есть
+#if defined(__AVX2__)
+    static __forceinline unsigned Trigger32(const char* p) {
+        const __m256i v0 = _mm256_loadu_si256((const __m256i*)p);
+        const __m256i q  = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v0, _mm256_set1_epi8('"')),
+            _mm256_cmpeq_epi8(v0, _mm256_set1_epi8('\''))), _mm256_cmpeq_epi8(v0, _mm256_set1_epi8('`')));
+        const __m256i sb = _mm256_and_si256(_mm256_cmpeq_epi8(v0, _mm256_set1_epi8(';')),
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 1)), _mm256_set1_epi8('b')));
+        if (!_mm256_movemask_epi8(_mm256_or_si256(q, sb))) return 0;
+        return (unsigned)Mask(ByteBits64(p, '"') | ByteBits64(p, '\'') | ByteBits64(p, '`'), ByteBits64(p, ';'),
+                              Base64Bits64(p), ByteBits64(p, 'b'), ByteBits64(p, ','));
+    }
+#endif
+    static __forceinline unsigned Trigger16(const char* p) {
+        const __m128i v0 = _mm_loadu_si128((const __m128i*)p);
+        const __m128i q  = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v0, _mm_set1_epi8('"')),
+            _mm_cmpeq_epi8(v0, _mm_set1_epi8('\''))), _mm_cmpeq_epi8(v0, _mm_set1_epi8('`')));
+        const __m128i sb = _mm_and_si128(_mm_cmpeq_epi8(v0, _mm_set1_epi8(';')),
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 1)), _mm_set1_epi8('b')));
+        if (!_mm_movemask_epi8(_mm_or_si128(q, sb))) return 0;
+        return Mask(ByteBits32(p, '"') | ByteBits32(p, '\'') | ByteBits32(p, '`'), ByteBits32(p, ';'),
+                    Base64Bits32(p), ByteBits32(p, 'b'), ByteBits32(p, ',')) & 0xFFFF;
+    }
+    static __forceinline bool Trigger(const char* p, const char* end) {
+        const char c = *p;
+        if (c == ';') {
+            for (int k = 1; k < 8 && p + k < end; ++k)
+                if (p[k] != Tag()[k]) return false;
+            return true;
+        }
+        if (c != '"' && c != '\'' && c != '`') return false;
+        for (int k = 1; k <= 4 && p + k < end; ++k)
+            if (!IsBase64Char((unsigned char)p[k])) return false;
+        return true;
+    }
+
+    bool begin(const char* p, const char* end, ULONGLONG pos, bool, bool) {
+        if (!Trigger(p, end)) return false;
+        quote = *p == ';' ? 0 : *p;
+        phase = quote ? kRun : kTag;
+        tag   = 1;
+        pad   = 0;
+        cls   = 0;
+        start = pos + 1;
+        count = 0;
+        return true;
+    }
+
+    // Конец серии на *cur (не из алфавита и не '=')
+    FilterVerdict done(ULONGLONG at, char c, FilterMatch& m) {
+        static const char kRepl[] = "/* BASE64 DATA HIDDEN */";
+        // Кавычка, принятая у конца окна авансом, без 4 байт алфавита за ней: триггера
+        // не было, разбор — со следующего байта, как после отказа begin
+        if (quote && count < 4) return FilterReject(m, start);
+        const bool ok = quote ? c == quote && count >= kMinQuoted && cls == (kB64Upper | kB64Lower | kB64Digit)
+                              : count >= kMinUri;
+        return ok ? FilterReplace(m, start, at, kRepl, sizeof(kRepl) - 1) : FilterReject(m, at);
+    }
+
+    FilterVerdict step(const char* p, ULONGLONG base, const char*& cur, const char* end, FilterMatch& m) {
+        while (cur < end) {
+            switch (phase) {
+            case kTag:
+                if (*cur != Tag()[tag]) return FilterReject(m, start);   // ';' + 1
+                ++cur;
+                if (++tag == 8) { phase = kRun; start = base + (ULONGLONG)(cur - p); }
+                break;
+            case kRun: {
+                const char* s = SkipBase64(cur, end, cls);
+                count += (ULONGLONG)(s - cur);
+                cur = s;
+                if (cur == end) break;
+                if (*cur == '=') { phase = kPad; break; }
+                return done(base + (ULONGLONG)(cur - p), *cur, m);
+            }
+            case kPad:
+                if (*cur == '=' && pad < 2) { ++pad; ++cur; break; }
+                return done(base + (ULONGLONG)(cur - p), *cur, m);
+            }
+        }
+        return kXfMore;
+    }
+
+    // Payload URI может кончаться вместе с файлом; строке нужна закрывающая кавычка
+    FilterVerdict finish(ULONGLONG end, FilterMatch& m) {
+        return phase != kTag && !quote ? done(end, 0, m) : FilterReject(m, end);
+    }
+};
+
+// Пробельная серия. Триггер — '\n', за которым ещё два, и между соседними не больше
+// kGap - 1 пробельных (две пустые строки подряд, в т.ч. с отступом), или 16 пробельных
+// подряд: серии короче не заменяются, а отступы и одиночные пустые строки в коде на
+// каждом шагу. С 3+ переводами строки заменяется всё до последнего '\n' — остаются
+// одна пустая строка и отступ следующей; '\n' не потребляется, с него
+// MinifiedLineFilter меряет строку.
+struct SpaceRunFilter {
+    static constexpr int    kLookahead = 17;
+    static constexpr int    kGap       = 8;   // степень двойки (NextWithin)
+    static constexpr int    kMinBreaks = 3;
+    static constexpr size_t kMinRun    = 64;
+
+    // Скалярный триггер побайтно: 16 пробельных подряд или цепочка из трёх '\n'
+    // (с "\r\n" в начале). Досматривается и через границу окна — в step.
+    struct Probe {
+        int ws    = 0;   // пробельных подряд с начала
+        int found = 0;   // '\n' цепочки; 0 — ждём '\n' после '\r', -1 — цепочки нет
+        int gap   = 0;
+
+        void init(char c) {
+            ws    = IsSpaceChar(c);
+            found = c == '\n' ? 1 : c == '\r' ? 0 : -1;
+            gap   = 0;
+        }
+        // 1 — триггер, 0 — нет, -1 — нужны ещё байты
+        int next(char c) {
+            ws = ws && IsSpaceChar(c) ? ws + 1 : 0;
+            if (ws >= 16) return 1;
+            if (found == 0) found = c == '\n' ? 1 : -1;
+            else if (found > 0) {
+                if (++gap > kGap || !IsSpaceChar(c)) found = -1;
+                else if (c == '\n' && (gap = 0, ++found == 3)) return 1;
+            }
+            return ws || found >= 0 ? -1 : 0;
+        }
+    };
+
+    ULONGLONG start  = 0;
+    ULONGLONG lastNl = 0;
+    ULONGLONG probed = 0;       // до сюда триггер досмотрен
+    Probe     probe;
+    int       breaks = 0;
+    bool      sure   = false;   // триггер подтверждён
+    bool      crlf   = false;   // последний перевод строки — "\r\n"
+    bool      cr     = false;   // окно кончилось на '\r' серии
+
+    // Бит i — через 1..kGap позиций бит x, а между ними только пробельные.
+    // Удвоением: r — такой бит x не дальше k, run — все k следующих пробельные.
+    template<typename W>
+    static __forceinline W NextWithin(W x, W ws) {
+        W r = x >> 1, run = ws >> 1;
+        for (int k = 1; k < kGap; k *= 2) {
+            r   |= run & (r >> k);
+            run &= run >> k;
+        }
+        return r;
+    }
+    // "\r\n" — с '\r', чтобы серия не оставляла его висеть перед заменой
+    template<typename W>
+    static __forceinline W Mask(W nl, W cr, W ws) {
+        W wide = ws & (ws >> 1);
+        wide &= wide >> 2;
+        wide &= wide >> 4;
+        wide &= wide >> 8;
+        const W lines = nl & NextWithin(nl & NextWithin(nl, ws), ws);
+        return lines | (cr & (lines >> 1)) | wide;
+    }
+#if defined(__AVX2__)
+    static __forceinline unsigned Trigger32(const char* p) {
+        return (unsigned)Mask(ByteBits64(p, '\n'), ByteBits64(p, '\r'), SpaceBits64(p));
+    }
+#endif
+    static __forceinline unsigned Trigger16(const char* p) {
+        return Mask(ByteBits32(p, '\n'), ByteBits32(p, '\r'), SpaceBits32(p)) & 0xFFFF;
+    }
+    static bool Trigger(const char* p, const char* end) {
+        Probe t;
+        t.init(*p);
+        if (!t.ws) return false;
+        for (const char* q = p + 1; q < end; ++q) {
+            const int r = t.next(*q);
+            if (r >= 0) return r != 0;
+        }
+        return true;
+    }
+
+    // Триггер у конца окна принимается авансом; step досматривает его в следующем,
+    // так что серия не зависит от нарезки на окна
+    bool begin(const char* p, const char* end, ULONGLONG pos, bool, bool) {
+        probe.init(*p);
+        if (!probe.ws) return false;
+        sure = false;
+        for (const char* q = p + 1; q < end && !sure; ++q) {
+            const int r = probe.next(*q);
+            if (!r) return false;
+            sure = r > 0;
+        }
+        start  = pos;
+        lastNl = pos;
+        probed = pos + (ULONGLONG)(end - p);
+        breaks = *p == '\n';
+        crlf   = false;
+        cr     = *p == '\r';
+        return true;
+    }
+
+    FilterVerdict done(ULONGLONG at, FilterMatch& m) {
+        if (breaks >= kMinBreaks)
+            return crlf ? FilterReplace(m, start, lastNl - 1, "\r\n", 2) : FilterReplace(m, start, lastNl, "\n", 1);
+        if (!breaks && at - start >= kMinRun) return FilterReplace(m, start, at, " ", 1);
+        // Последний '\n' серии разбирается заново: с него начинается следующая строка
+        return FilterReject(m, lastNl > start ? lastNl : at);
+    }
+
+    FilterVerdict step(const char* p, ULONGLONG base, const char*& cur, const char* end, FilterMatch& m) {
+        // Не подтверждённый триггер: провал — как у begin, разбор со следующего байта
+        // (все байты между ними пробельные, триггера там тоже нет)
+        for (const char* q = p + (size_t)(probed - base); !sure && q < end; ++q) {
+            const int r = probe.next(*q);
+            if (!r) return FilterReject(m, start + 1);
+            sure = r > 0;
+        }
+        probed = base + (ULONGLONG)(end - p);
+
+        const char* nl = nullptr;
+        cur = SkipSpaceRun(cur, end, breaks, nl);
+        if (nl) { lastNl = base + (ULONGLONG)(nl - p); crlf = nl > p ? nl[-1] == '\r' : cr; }
+        if (cur == end) { cr = end[-1] == '\r'; return kXfMore; }
+        return done(base + (ULONGLONG)(cur - p), m);
+    }
+
+    // Триггер, не досмотренный до конца входа, принимается — как Trigger у end
+    FilterVerdict finish(ULONGLONG end, FilterMatch& m) { return done(end, m); }
+};
+
+// Строка от kMinLine байт (минифицированный JS/CSS, JSON или SVG в одну строку)
+// заменяется заглушкой с её длиной. Триггер — '\n', за которым kLookahead байт нет
+// другого '\n' (строки короче — почти все строки кода — отсекаются масками), и начало
+// входа; остальные короткие begin отсекает поиском следующего '\n'. Кандидат
+// заводится, только если конца строки в окне не видно: строка длинная или (редко)
+// пересекает границу окна. Короткая строка отказывает к своему триггеру, и разбор
+// повторяется с него, как если бы begin сразу вернул false.
+struct MinifiedLineFilter {
+    static constexpr int    kLookahead = 64;
+    static constexpr size_t kMinLine   = 4096;
+
+    ULONGLONG trig  = 0;       // триггер: '\n' перед строкой или начало входа
+    ULONGLONG start = 0;       // первый байт строки
+    bool      cr    = false;   // окно кончилось на '\r' строки
+    char      note[64];
+
+#if defined(__AVX2__)
+    static __forceinline unsigned Trigger32(const char* p) {
+        const ULONGLONG nl = ByteBits64(p, '\n');
+        if (!(unsigned)nl) return 0;
+        const unsigned ahead = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(p + 64)), _mm256_set1_epi8('\n')));
+        unsigned      r = 0;
+        unsigned long i;
+        for (unsigned m = (unsigned)nl; m; m &= m - 1) {
+            _BitScanForward(&i, m);
+            // p[i+1 .. i+64] без '\n'
+            if (!(nl >> (i + 1)) && !(ahead & ((2u << i) - 1))) r |= 1u << i;
+        }
+        return r;
+    }
+#endif
+    static __forceinline unsigned Trigger16(const char* p) {
+        const unsigned nl = ByteBits32(p, '\n');
+        if (!(nl & 0xFFFF) || ByteBits32(p + 32, '\n')) return 0;
+        const unsigned ahead = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i*)(p + 64)), _mm_set1_epi8('\n')));
+        unsigned      r = 0;
+        unsigned long i;
+        for (unsigned m = nl & 0xFFFF; m; m &= m - 1) {
+            _BitScanForward(&i, m);
+            if (!(nl >> (i + 1)) && !(ahead & ((2u << i) - 1))) r |= 1u << i;
+        }
+        return r;
+    }
+    static __forceinline bool Trigger(const char* p, const char*) { return *p == '\n'; }
+
+    bool begin(const char* p, const char* end, ULONGLONG pos, bool first, bool last) {
+        const char* line = p;
+        if (*p == '\n') { ++line; ++pos; }
+        else if (!first) return false;
+        const size_t avail = (size_t)(end - line);
+        const size_t probe = min(avail, kMinLine);
+        if (memchr(line, '\n', probe)) return false;
+        if (avail < kMinLine && last) return false;   // последняя строка входа, короткая
+        trig  = pos - (ULONGLONG)(line - p);
+        start = pos;
+        cr    = line < end && end[-1] == '\r';
+        return true;
+    }
+
+    FilterVerdict fold(ULONGLONG to, FilterMatch& m) {
+        if (to - start < kMinLine) return FilterReject(m, trig);
+        const int n = snprintf(note, sizeof(note), "/* MINIFIED LINE HIDDEN: %llu bytes */", to - start);
+        return FilterReplace(m, start, to, note, (size_t)n);
+    }
+
+    // Короткая строка через границу окна: её начало в прошлом окне, и часть до
+    // текущего окна ContentFilter разбирает заново из своей копии кандидата.
+    // '\r' перед '\n' остаётся за строкой: "\r\n" не рвётся заглушкой.
+    FilterVerdict step(const char* p, ULONGLONG base, const char*& cur, const char* end, FilterMatch& m) {
+        const char* nl = (const char*)memchr(cur, '\n', (size_t)(end - cur));
+        if (!nl) { cur = end; cr = end[-1] == '\r'; return kXfMore; }
+        cur = nl;
+        const bool crlf = nl > p ? nl[-1] == '\r' : cr;
+        return fold(base + (ULONGLONG)(nl - p) - crlf, m);
+    }
+
+    FilterVerdict finish(ULONGLONG end, FilterMatch& m) { return fold(end, m); }
+};
+
+// Сканер из трансформов Ts (порядок — приоритет на общем триггере).
+// Кандидат, переживающий границу окна, копируется в carry (до kCarry байт): решение
+// с продолжением внутри прошлых окон разбирает их байты заново из копии, так что
+// результат не зависит от нарезки на окна. От кандидата длиннее kCarry в carry
+// остаются последние kCarryTail байт прошлых окон: продолжение сразу перед окном
+// ('\r' перед '\n' у длинной строки) разбирается из них; более раннее (килобайты
+// пробельных после '=') — с начала окна.
+template<typename... Ts>
+struct ContentFilter {
+    static constexpr int    kLookahead = (std::max)({ 32, Ts::kLookahead... });
+    static constexpr size_t kCarry     = 8 * 1024;   // не меньше MinifiedLineFilter::kMinLine
+    static constexpr size_t kCarryTail = 64;
+    typedef std::index_sequence_for<Ts...> Seq;
+
+    std::tuple<Ts...> xf;
+    std::string carry;             // [carryPos, конец прошлого окна) текущего кандидата
+    ULONGLONG emitted   = 0;       // всё до этого смещения уже отдано в sink
+    ULONGLONG candPos   = 0;       // начало текущего кандидата
+    ULONGLONG retryPos  = 0;       // в этой позиции begin пробуется с retryFrom
+    int       retryFrom = 0;
+    int       active    = -1;      // индекс трансформа с кандидатом
+    ULONGLONG carryPos  = 0;       // candPos — carry покрывает кандидата целиком
+    bool      first     = true;
+    bool      replaced  = false;
+
+    static const char* findTrigger(const char* p, const char* end) {
+        unsigned long i;
+#if defined(__AVX2__)
+        for (; p + 32 + kLookahead <= end; p += 32) {
+            const unsigned m = (0u | ... | Ts::Trigger32(p));
+            if (m) { _BitScanForward(&i, m); return p + i; }
+        }
+#endif
+        for (; p + 16 + kLookahead <= end; p += 16) {
+            const unsigned m = (0u | ... | Ts::Trigger16(p));
+            if (m) { _BitScanForward(&i, m); return p + i; }
+        }
+        for (; p < end; ++p)
+            if ((false || ... || Ts::Trigger(p, end))) return p;
+        return end;
+    }
+
+    template<size_t... I>
+    int beginAt(const char* t, const char* end, ULONGLONG pos, bool last, int from, std::index_sequence<I...>) {
+        int got = -1;
+        (void)(((int)I >= from && std::get<I>(xf).begin(t, end, pos, first, last) && (got = (int)I, true)) || ...);
+        return got;
+    }
+
+    template<size_t... I>
+    FilterVerdict stepAt(const char* p, ULONGLONG base, const char*& cur, const char* end, FilterMatch& m,
+                         std::index_sequence<I...>) {
+        FilterVerdict v = kXfMore;
+        (void)((active == (int)I && (v = std::get<I>(xf).step(p, base, cur, end, m), true)) || ...);
+        return v;
+    }
+
+    template<size_t... I>
+    FilterVerdict finishAt(ULONGLONG end, FilterMatch& m, std::index_sequence<I...>) {
+        FilterVerdict v = kXfReject;
+        (void)((active == (int)I && (v = std::get<I>(xf).finish(end, m), true)) || ...);
+        return v;
+    }
+
+    template<typename Sink>
+    void replace(const FilterMatch& m, Sink& sink) {
+        sink.source(emitted, m.from - emitted);
+        sink.literal(m.lit, m.len);
+        emitted  = m.to;
+        replaced = true;
+    }
+
+    // Решение по кандидату трансформа xfi, разбор продолжается с m.to. Отказ к самому
+    // триггеру — в нём пробуются следующие трансформы. true — m.to в прошлых окнах,
+    // и его байты до base есть в carry (redo).
+    bool resumeFrom(const FilterMatch& m, FilterVerdict v, int xfi, ULONGLONG base, std::string& redo) {
+        retryFrom = 0;
+        if (v == kXfReject && m.to == candPos) { retryPos = m.to; retryFrom = xfi + 1; }
+        if (m.to >= base || m.to < carryPos || carry.empty()) return false;
+        redo.assign(carry, (size_t)(m.to - carryPos), std::string::npos);
+        carry.clear();
+        return true;
+    }
+
+    // last — окно последнее (его конец — конец входа)
+    template<typename Sink>
+    void feed(const char* p, ULONGLONG base, size_t n, Sink& sink, bool last = true) {
+        const char* cur = p;
+        const char* end = p + n;
+
+        while (cur < end) {
+            if (active < 0) {
+                const bool      retry = retryFrom > 0 && base + (ULONGLONG)(cur - p) == retryPos;
+                const char*     t     = first || retry ? cur : findTrigger(cur, end);
+                if (t == end) { cur = end; break; }
+                const ULONGLONG pos = base + (ULONGLONG)(t - p);
+                active    = beginAt(t, end, pos, last, retry ? retryFrom : 0, Seq());
+                candPos   = pos;
+                carry.clear();
+                carryPos  = pos;
+                retryFrom = 0;
+                first     = false;
+                cur       = t + 1;
+                continue;
+            }
+            FilterMatch m;
+            const int   xfi = active;
+            const FilterVerdict v = stepAt(p, base, cur, end, m, Seq());
+            if (v == kXfMore) break;
+            active = -1;
+            if (v == kXfMatch) replace(m, sink);
+            // Продолжение может быть раньше cur (SpaceRunFilter оставляет '\n') и даже
+            // раньше окна: тогда байты прошлых окон разбираются заново из carry
+            std::string redo;
+            if (resumeFrom(m, v, xfi, base, redo)) feed(redo.data(), m.to, redo.size(), sink, false);
+            cur = m.to > base ? p + (size_t)(m.to - base) : p;
+        }
+
+        // Кандидат уходит в следующее окно — копия его байт для повторного разбора
+        // (кандидат длиннее kCarry — только хвост последних окон)
+        if (active >= 0) {
+            const ULONGLONG from = candPos > base ? candPos : base;
+            const size_t    add  = (size_t)(base + n - from);
+            if (carryPos == candPos && carry.size() + add <= kCarry) {
+                carry.append(p + (size_t)(from - base), add);
+            } else {
+                const size_t take = min(add, kCarryTail);
+                carry.erase(0, carry.size() - min(carry.size(), kCarryTail - take));
+                carry.append(p + n - take, take);
+                carryPos = base + n - carry.size();
+            }
+        }
+
+        // Всё, что уже не может стать частью замены, отдаём сразу
+        const ULONGLONG settled = active >= 0 ? candPos : base + n;
+        if (settled > emitted) { sink.source(emitted, settled - emitted); emitted = settled; }
+    }
+
+    // Конец входа: кандидат решается по тому, что есть; после отказа хвост из carry
+    // разбирается заново, остаток уходит как есть
+    template<typename Sink>
+    void finish(ULONGLONG end, Sink& sink) {
+        if (active >= 0) {
+            FilterMatch m;
+            const int   xfi = active;
+            const FilterVerdict v = finishAt(end, m, Seq());
+            active = -1;
+            if (v == kXfMatch) replace(m, sink);
+            std::string redo;
+            if (resumeFrom(m, v, xfi, end, redo)) {
+                feed(redo.data(), m.to, redo.size(), sink, true);
+                finish(end, sink);
+                return;
+            }
+        }
+        if (end > emitted) sink.source(emitted, end - emitted);
+        emitted = end;
+    }
+};
+
+// --- НАБОР ТРАНСФОРМОВ: МАСКА ВРЕМЕНИ ВЫПОЛНЕНИЯ → ТИП ---
+// "filter=hex,base64,space,min" после пути (none — без трансформов, all — все),
+// маска — EngineOptions::contentFilters. По умолчанию только hex: он прячет лишь
+// тело массива-дампа, а base64, space и min теряют настоящий текст (строки base64
+// в коде, отступы, длинные строки) — их включают явно.
+// Каждой маске — свой ContentFilter, собранный на этапе компиляции; выбор —
+// один раз на файл (WithContentFilter). kXfMinified также заменяет заглушкой
+// тело lock-файлов менеджеров пакетов (по имени, см. IsLockfileName).
+// Биты маски трансформов (EngineOptions::contentFilters)
+enum ContentTransform : unsigned {
+    kXfHex      = 1,
+    kXfBase64   = 2,
+    kXfSpace    = 4,
+    kXfMinified = 8,
+    kXfAll      = 15
+};
+
+template<typename Tuple> struct FilterFromTuple;
+template<typename... Ts> struct FilterFromTuple<std::tuple<Ts...>> { typedef ContentFilter<Ts...> type; };
+
+template<unsigned Mask>
+struct FilterSet {
+    template<unsigned Bit, typename T>
+    using On = typename std::conditional<(Mask & Bit) != 0, std::tuple<T>, std::tuple<>>::type;
+
+    typedef typename FilterFromTuple<decltype(std::tuple_cat(On<kXfMinified, MinifiedLineFilter>(),
+        On<kXfHex, HexArrayFilter>(), On<kXfBase64, Base64Filter>(), On<kXfSpace, SpaceRunFilter>()))>::type type;
+};
+
+// f((Filter*)nullptr) с типом сканера для mask
+template<unsigned M = 0, typename F>
+void WithContentFilter(unsigned mask, F&& f) {
+    if constexpr (M <= kXfAll) {
+        if ((mask & kXfAll) == M) f((typename FilterSet<M>::type*)nullptr);
+        else                      WithContentFilter<M + 1>(mask, f);
+    }
+}
+
+// Файл целиком в памяти: дописывает обработанный текст в out (std::string или
+// ArenaBlock — нужен append(const char*, size_t)). Результат не длиннее входа.
+// Возвращает true если была хотя бы одна замена.
+template<typename Filter, typename Out>
+bool CleanWith(const char* src, size_t len, Out& out) {
+    struct AppendSink {
+        Out&        s;
+        const char* base;
+        void literal(const char* p, size_t n)        { s.append(p, n); }
+        void source(ULONGLONG off, ULONGLONG n)      { s.append(base + off, (size_t)n); }
+    } sink{ out, src };
+
+    Filter f;
+    f.feed(src, 0, len, sink);
+    f.finish(len, sink);
+    return f.replaced;
+}
+
+template<typename Out>
+bool CleanHexArrays(const char* src, size_t len, Out& out) {
+    return CleanWith<ContentFilter<HexArrayFilter>>(src, len, out);
+}
+
+// Включённые трансформы (маска ContentTransform) одним проходом
+template<typename Out>
+bool CleanContent(unsigned filters, const char* src, size_t len, Out& out) {
+    bool replaced = false;
+    WithContentFilter(filters, [&](auto* f) {
+        replaced = CleanWith<typename std::remove_pointer<decltype(f)>::type>(src, len, out);
+    });
+    return replaced;
+}
+
+// Lock-файлы менеджеров пакетов: тысячи строк версий и хэшей без смысла для чтения
+inline bool IsLockfileName(const wchar_t* name) {
+    static const wchar_t* const kLockfiles[] = {
+        L"package-lock.json", L"npm-shrinkwrap.json", L"yarn.lock", L"pnpm-lock.yaml", L"bun.lock",
+        L"Cargo.lock", L"Gemfile.lock", L"poetry.lock", L"Pipfile.lock", L"uv.lock", L"composer.lock",
+        L"packages.lock.json", L"go.sum", L"flake.lock", L"pubspec.lock", L"Podfile.lock", L"mix.lock"
+    };
+    for (const wchar_t* lf : kLockfiles)
+        if (_wcsicmp(name, lf) == 0) return true;
+    return false;
+}
+
+static const char kLockfileStub[] = "/* LOCKFILE BODY HIDDEN */\n";
@@ -0,0 +1,1706 @@
+#include "Engine.h"
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Channel.h"
+#include "Common.h"
+#include "FileIndex.h"
+#include "Hash.h"
+#include "Ignore.h"
+#include "Lz4.h"
+#include "Manifest.h"
+#include "OutBuf.h"
+#include "Text.h"
+#include "Walker.h"
+
+bool IsOwnOutput(const wchar_t* name) {
+    static const wchar_t* const kNames[] = {
+        L"all.txt", L"all.txt.tmp", L"all.manifest", L"all.manifest.tmp", L"file_list.txt",
+        L"all.txt.lz4", L"all.txt.lz4.tmp", L"all.stats.json", L"all.trace.json", L"all.tune.log",
+        L"file_list.idx", L"file_list.idx.tmp", L"file_list.txt.tmp"
+    };
+    for (auto n : kNames)
+        if (_wcsicmp(name, n) == 0) return true;
+    // Шарды дампа: all.<номер>.txt[.lz4][.tmp]
+    if (_wcsnicmp(name, L"all.", 4) == 0 && name[4] >= L'0' && name[4] <= L'9') {
+        const wchar_t* p = name + 4;
+        while (*p >= L'0' && *p <= L'9') ++p;
+        return _wcsicmp(p, L".txt") == 0 || _wcsicmp(p, L".txt.tmp") == 0 ||
+               _wcsicmp(p, L".txt.lz4") == 0 || _wcsicmp(p, L".txt.lz4.tmp") == 0;
+    }
+    return false;
+}
+
+bool GenerateFileList(EngineContext& ctx, const std::wstring& folderPath) {
+    std::wstring baseStr = folderPath;
+    if (!baseStr.empty() && baseStr.back() != L'\\') baseStr += L'\\';
+    const DWORD baseLen = (DWORD)baseStr.length();
+
+    OutBuf out;
+    if (ctx.streaming()) out.attach(ctx.out, 1 * 1024 * 1024);
+    else if (!out.open((baseStr + L"file_list.txt").c_str(), 1 * 1024 * 1024)) return false;
+
+    static char utf8Buf[MAX_PATH * 4 + 2];
+    std::wstring     fullPath;
+    FileIndexBuilder index;
+
+    DirWalker walker(WalkerThreads(IsPathOnSSD(baseStr.c_str())), ctx);
+    walker.run(baseStr, [&](const DirNode& dir, const WalkItem& it) {
+        const wchar_t* name = dir.name(it);
+        if (IsOwnOutput(name)) return;
+        fullPath.assign(dir.path).append(name, it.nameLen);
+        int utf8Len = WideCharToMultiByte(CP_UTF8, 0,
+            fullPath.c_str() + baseLen, (int)(fullPath.size() - baseLen),
+            utf8Buf, (int)sizeof(utf8Buf) - 2, NULL, NULL);
+        if (utf8Len > 0) {
+            if (!ctx.streaming()) index.add(utf8Buf, (size_t)utf8Len, it.size, FileTimeToU64(it.mtime), it.attrs);
+            utf8Buf[utf8Len] = '\n';
+            out.write(utf8Buf, (DWORD)utf8Len + 1);
+            if (out.failed) ctx.cancel = true;   // читатель закрыл pipe
+            ctx.progress.add(EngineProgress::kBytesWritten, (ULONGLONG)utf8Len + 1);
+        }
+        ctx.progress.add(EngineProgress::kFilesDone);
+    });
+
+    out.close();
+    const bool ok = !ctx.cancelled() && !out.failed;
+    if (ctx.streaming()) return ok;
+    if (!ok) DeleteFileW((baseStr + L"file_list.txt").c_str());
+    else     index.replace(baseStr + L"file_list.idx");
+    return ok;
+}
+
+// --- ЯДРО ДАМПА all.txt: ПАРАЛЛЕЛЬНАЯ ОБРАБОТКА ---
+//
+// SSD: [Сканер] → pathChan(256) → [Worker × N]  → outChan → [Output thread]   бюджет до 256 МБ
+// HDD: [Сканер] → pathChan(16)  → [Worker × 2]  → outChan → [Output thread]   бюджет до 64 МБ
+//          └──────── не изменились по манифесту ─────→ outChan (блок старого all.txt)
+// Это стартовые точки: число активных воркеров и окно бюджета дальше ведёт DumpTuner.
+//
+// Шарды (shard=<МБ>): вместо all.txt — all.001.txt, all.002.txt, ... Шард файлу
+// назначает сканер в порядке DFS по верхней оценке вывода (заголовок + размер:
+// очистка только укорачивает), так что файл целиком в одном шарде, а соседние
+// файлы директории — в одном или двух соседних. У каждого output-потока свой
+// outChan; поток w пишет шарды s % numWriters == w, каждый в свой OutBuf.
+//
+// Файлы до kBatchReadMax воркер читает пачкой в свой слэб (BatchReader),
+// до kMapWholeLimit отображает целиком; крупнее — output-поток сам
+// пропускает через ContentFilter скользящими окнами (память не зависит от размера).
+//
+// Контент не собирается в строку: воркер отдаёт список сегментов — кусок data
+// (заголовок, строка замены) или диапазон своего mapped view. Output-поток пишет
+// крупные диапазоны прямо из view и только после этого его освобождает.
+//
+// На HDD больше 2 воркеров вызывают head-thrashing и замедляют работу.
+// На SSD/NVMe параллельные запросы утилизируют очередь контроллера (NCQ/NVMe queue).
+//
+// Backpressure — по байтам, не по числу элементов: сканер резервирует
+// min(size, kMapWholeLimit) на файл до отправки в pathChan, бюджет освобождает тот,
+// кто отпустил память файла (воркер — после arena-блока или ошибки, output-поток —
+// после записи view/потока). Arena-пул ограничен отдельно своим размером.
+//
+// Хэш контента считает воркер по mapped view; повторный контент (DedupTable)
+// пишется блоком-ссылкой на первую копию.
+//
+// Запись идёт в all.txt.tmp: старый all.txt — источник неизменившихся блоков.
+// По завершении tmp заменяет all.txt, рядом пишется новый all.manifest.
+// При отмене старые all.txt и all.manifest остаются нетронутыми.
+
+// "filter=hex,base64,space,min" → маска трансформов; "all" и "none" — все и ни одного.
+// Имена без учёта регистра; неизвестное имя — false, маска не меняется
+static bool ParseContentFilters(const wchar_t* s, unsigned& out) {
+    static const struct { const wchar_t* name; unsigned bit; } kNames[] = {
+        { L"hex", kXfHex }, { L"base64", kXfBase64 }, { L"space", kXfSpace }, { L"min", kXfMinified },
+        { L"all", kXfAll }, { L"none", 0 }
+    };
+    unsigned mask = 0;
+    while (*s) {
+        const wchar_t* e = wcschr(s, L',');
+        const size_t   n = e ? (size_t)(e - s) : wcslen(s);
+        bool known = false;
+        for (auto& k : kNames)
+            if (wcslen(k.name) == n && _wcsnicmp(s, k.name, n) == 0) { mask |= k.bit; known = true; }
+        if (!known) return false;
+        s += e ? n + 1 : n;
+    }
+    out = mask;
+    return true;
+}
+
+bool ParseDumpArgs(LPWSTR* argv, int argc, EngineOptions& opt) {
+    bool ok = true;
+    for (int i = 0; i < argc; ++i) {
+        if      (wcsncmp(argv[i], L"budget=", 7) == 0) opt.budgetMB  = wcstoull(argv[i] + 7, nullptr, 10);
+        else if (wcsncmp(argv[i], L"shard=", 6) == 0)  opt.shardMB   = wcstoull(argv[i] + 6, nullptr, 10);
+        else if (wcsncmp(argv[i], L"tune=", 5) == 0)   opt.tune      = wcstoul(argv[i] + 5, nullptr, 10) != 0;
+        else if (wcscmp(argv[i], L"read=mmap") == 0)   opt.batchRead = false;
+        else if (wcsncmp(argv[i], L"elevator=", 9) == 0) opt.elevator = (int)wcstoul(argv[i] + 9, nullptr, 10);
+        else if (wcscmp(argv[i], L"read=batch") == 0)  opt.batchRead = true;
+        else if (wcsncmp(argv[i], L"order=", 6) == 0)  opt.ordered   = wcstoul(argv[i] + 6, nullptr, 10) != 0;
+        else if (wcsncmp(argv[i], L"workers=", 8) == 0) opt.workers  = (int)wcstoul(argv[i] + 8, nullptr, 10);
+        else if (wcsncmp(argv[i], L"filter=", 7) == 0) ok &= ParseContentFilters(argv[i] + 7, opt.contentFilters);
+        else if (wcscmp(argv[i], L"lz4") == 0)         opt.lz4       = true;
+        else if (wcscmp(argv[i], L"stats") == 0)       opt.traceMode = max(opt.traceMode, 1);
+        else if (wcscmp(argv[i], L"trace") == 0)       opt.traceMode = 2;
+    }
+    return ok;
+}
+
+// Итог трассировки в папку дампа: all.stats.json — квантили по (роль потока, стадия)
+// и глубина очередей; в режиме trace ещё all.trace.json в формате Chrome trace events.
+// Вызывать после join всех потоков конвейера.
+static void TraceWriteReport(const TraceLog& log, const std::wstring& dir) {
+    char line[512];
+    auto us = [](ULONGLONG ns) { return (double)ns / 1000.0; };
+
+    // Гистограммы потоков одной роли складываются
+    std::vector<std::pair<const char*, std::unique_ptr<TraceHist[]>>> roles;
+    for (auto& t : log.threads) {
+        auto it = roles.begin();
+        while (it != roles.end() && strcmp(it->first, t->role) != 0) ++it;
+        if (it == roles.end()) {
+            roles.emplace_back(t->role, std::unique_ptr<TraceHist[]>(new TraceHist[kStCount]));
+            it = roles.end() - 1;
+        }
+        for (int st = 0; st < kStCount; ++st) it->second[st].merge(t->hist[st]);
+    }
+
+    OutBuf sf;
+    if (sf.open((dir + L"all.stats.json").c_str(), 64 * 1024)) {
+        std::string json = "{\n  \"stages\": [";
+        bool first = true;
+        for (auto& r : roles)
+            for (int st = 0; st < kStCount; ++st) {
+                const TraceHist& h = r.second[st];
+                if (!h.count) continue;
+                snprintf(line, sizeof(line),
+                    "%s\n    { \"role\": \"%s\", \"stage\": \"%s\", \"count\": %llu, \"total_ms\": %.3f,"
+                    " \"mean_us\": %.2f, \"p50_us\": %.2f, \"p90_us\": %.2f, \"p99_us\": %.2f, \"max_us\": %.2f }",
+                    first ? "" : ",", r.first, kTraceStageNames[st], h.count, (double)h.sumNs / 1e6,
+                    us(h.sumNs) / (double)h.count, us(h.percentile(0.5)), us(h.percentile(0.9)),
+                    us(h.percentile(0.99)), us(h.maxNs));
+                json += line;
+                first = false;
+            }
+
+        // Очереди: среднее и максимум по сэмплам
+        double    sum[3] = {};
+        ULONGLONG top[3] = {};
+        for (const TraceSample& sm : log.samples) {
+            const ULONGLONG v[3] = { sm.pathDepth, sm.outDepth, sm.inFlight };
+            for (int k = 0; k < 3; ++k) { sum[k] += (double)v[k]; top[k] = max(top[k], v[k]); }
+        }
+        const double n = (double)max(log.samples.size(), (size_t)1);
+        const double mb = 1024.0 * 1024.0;
+        snprintf(line, sizeof(line),
+            "\n  ],\n  \"queues\": { \"samples\": %zu,"
+            " \"path_chan_mean\": %.1f, \"path_chan_max\": %llu,"
+            " \"out_chan_mean\": %.1f, \"out_chan_max\": %llu,"
+            " \"inflight_mb_mean\": %.1f, \"inflight_mb_max\": %.1f }\n}\n",
+            log.samples.size(), sum[0] / n, top[0], sum[1] / n, top[1], sum[2] / n / mb, (double)top[2] / mb);
+        json += line;
+        sf.write(json.data(), (DWORD)json.size());
+        sf.close();
+    }
+
+    if (log.mode < 2) return;
+    OutBuf tf;
+    if (!tf.open((dir + L"all.trace.json").c_str(), 1024 * 1024)) return;
+    auto put = [&](int len) { tf.write(line, (DWORD)min(len, (int)sizeof(line) - 1)); };
+    auto ts  = [&](LONGLONG t) { return QpcToMs(t - log.start) * 1000.0; };
+
+    put(snprintf(line, sizeof(line),
+        "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Helpers -dump\"}}"));
+    for (auto& t : log.threads) {
+        put(snprintf(line, sizeof(line),
+            ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+            (unsigned long)t->tid, t->role));
+        for (const TraceEvent& e : t->events)
+            put(snprintf(line, sizeof(line),
+                ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+                kTraceStageNames[e.stage], (unsigned long)t->tid, ts(e.t0), QpcToMs(e.t1 - e.t0) * 1000.0));
+    }
+    for (const TraceSample& sm : log.samples)
+        put(snprintf(line, sizeof(line),
+            ",\n{\"name\":\"queues\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"path_chan\":%llu,\"out_chan\":%llu}}"
+            ",\n{\"name\":\"inflight_mb\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"mb\":%.2f}}",
+            ts(sm.t), sm.pathDepth, sm.outDepth, ts(sm.t), (double)sm.inFlight / (1024.0 * 1024.0)));
+    put(snprintf(line, sizeof(line), "\n]}\n"));
+    tf.close();
+}
+
+// Счётчик зарезервированных байт. Ждёт только сканер (C++20 atomic::wait),
+// освобождают воркеры и output-поток. Файл крупнее бюджета проходит, когда
+// в полёте ничего нет — иначе он не прошёл бы никогда.
+// Лимит меняет DumpTuner на ходу: ждущий сканер увидит новый при ближайшем
+// release — пока он ждёт, в полёте что-то есть, так что release будет.
+struct ByteBudget {
+    std::atomic<ULONGLONG> limit;
+    std::atomic<ULONGLONG> used{ 0 };
+    std::atomic<ULONGLONG> peak{ 0 };
+
+    explicit ByteBudget(ULONGLONG l) : limit(l) {}
+
+    bool tryAcquire(ULONGLONG n) {
+        ULONGLONG cur = used.load();
+        while (cur == 0 || cur + n <= limit.load(std::memory_order_relaxed)) {
+            if (used.compare_exchange_weak(cur, cur + n)) {
+                ULONGLONG p = peak.load(std::memory_order_relaxed);
+                while (cur + n > p && !peak.compare_exchange_weak(p, cur + n)) {}
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void acquire(ULONGLONG n) {
+        while (!tryAcquire(n)) {
+            const ULONGLONG cur = used.load();
+            if (cur != 0 && cur + n > limit.load()) used.wait(cur);
+        }
+    }
+
+    void release(ULONGLONG n) {
+        if (!n) return;
+        used.fetch_sub(n);
+        used.notify_all();
+    }
+};
+
+// --- АДАПТИВНАЯ ПОДСТРОЙКА КОНВЕЙЕРА ДАМПА ---
+// Стартовая точка — по типу тома (InitialTuning). Дальше раз в kPeriodMs контроллер
+// смотрит пропускную способность (байт исходников/с), долю времени, которую
+// активные воркеры ждут pathChan, долю времени, которую сканер ждёт бюджет,
+// и среднюю заполненность pathChan — и делает не больше одного шага:
+//   воркеры простаивают (> 30%), а сканер упёрся в бюджет → окно упреждающего
+//       чтения (лимит ByteBudget) ×2, до потолка;
+//   воркеры простаивают, бюджет ни при чём → узкое место не они: минус воркер;
+//   воркеры заняты, pathChan заполнен больше чем наполовину → плюс воркер
+//       (горячий кэш: предел — CPU, рост до числа ядер окупается);
+//   шаг не дал +5% (или снятие воркера стоило > 5%) → откат и kHold периодов покоя.
+// Лишние воркеры не завершаются, а спят на atomic::wait между пачками задач.
+// Каждый шаг и выход на установившийся режим пишутся в журнал all.tune.log —
+// только в режимах stats/trace, в обычном прогоне журнал не ведётся.
+struct DumpTuning {
+    int       startWorkers;
+    int       maxWorkers;
+    ULONGLONG budgetMB;        // потолок окна
+};
+
+static DumpTuning InitialTuning(VolumeKind vol) {
+    const int hw = max(2, (int)std::thread::hardware_concurrency());
+    switch (vol) {
+    case kVolHdd:    return { 2, 4, 64 };
+    case kVolRemote: return { 4, min(32, hw * 2), 512 };
+    case kVolSsd:    return { max(2, min(8, hw - 2)), min(16, hw), 256 };
+    default:         return { max(2, min(4, hw - 2)), min(16, hw), 256 };
+    }
+}
+
+struct DumpTuner {
+    static const int kPeriodMs = 200;
+    static const int kSampleMs = 20;
+    static const int kHold     = 5;
+
+    enum Action { kNone, kGrow, kShrink, kWiden, kRevert };
+
+    std::atomic<int>       active;           // воркеры с номером >= active спят
+    std::atomic<ULONGLONG> bytesDone{ 0 };   // взято в работу воркерами
+    std::atomic<LONGLONG>  idleTicks{ 0 };   // воркеры ждали pathChan
+    std::atomic<LONGLONG>  budgetTicks{ 0 }; // сканер ждал бюджет
+    const int              minWorkers, maxWorkers;
+    const ULONGLONG        maxWindow;
+    const bool             keepLog;          // stats/trace: журнал для all.tune.log
+
+    // Состояние контроллера — только его поток
+    Action    last = kNone;
+    double    lastThr = 0;
+    int       hold = 0;
+    ULONGLONG prevBytes = 0;
+    LONGLONG  prevIdle = 0, prevBudget = 0, prevT, t0;
+    std::vector<std::string> log;
+
+    DumpTuner(int start, int minW, int maxW, ULONGLONG maxWin, bool withLog)
+        : active(start), minWorkers(minW), maxWorkers(maxW), maxWindow(maxWin), keepLog(withLog) {
+        prevT = t0 = QpcNow();
+    }
+
+    void park(int self) {
+        int a;
+        while (self >= (a = active.load())) active.wait(a);
+    }
+
+    // Конец сканирования: все спящие дочитывают pathChan. Контроллер уже остановлен.
+    void releaseAll() { active = maxWorkers; active.notify_all(); }
+
+    void setActive(int n) { active = n; active.notify_all(); }
+
+    void note(const std::string& line) {
+        if (keepLog) log.push_back(line);
+    }
+
+    void tick(ByteBudget& budget, double pathOcc) {
+        const LONGLONG  now  = QpcNow();
+        const double    sec  = max(QpcToMs(now - prevT) / 1000.0, 1e-3);
+        const ULONGLONG b    = bytesDone.load();
+        const LONGLONG  idle = idleTicks.load(), bw = budgetTicks.load();
+        const int       act  = active.load();
+        const double    thr   = (double)(b - prevBytes) / sec;
+        const double    idleF = QpcToMs(idle - prevIdle) / 1000.0 / sec / act;
+        const double    budgF = QpcToMs(bw - prevBudget) / 1000.0 / sec;
+        prevT = now; prevBytes = b; prevIdle = idle; prevBudget = bw;
+
+        const ULONGLONG window = budget.limit.load();
+        Action a = kNone;
+        if (hold > 0) {
+            --hold;
+        } else if (last == kGrow && thr < lastThr * 1.05) {
+            setActive(act - 1); a = kRevert; hold = kHold;
+        } else if (last == kShrink && thr < lastThr * 0.95) {
+            setActive(act + 1); a = kRevert; hold = kHold;
+        } else if (idleF > 0.3 && budgF > 0.3 && window < maxWindow) {
+            budget.limit = min(window * 2, maxWindow); a = kWiden;
+        } else if (idleF > 0.3 && act > minWorkers) {
+            setActive(act - 1); a = kShrink;
+        } else if (idleF < 0.1 && pathOcc > 0.5 && act < maxWorkers) {
+            setActive(act + 1); a = kGrow;
+        }
+
+        static const char* const kNames[] = { "steady", "grow", "shrink", "widen", "revert" };
+        if (a != kNone || last != kNone) {
+            char line[256];
+            snprintf(line, sizeof(line),
+                "t=%.2fs workers=%d window=%lluMB thr=%.1fMB/s idle=%.0f%% budget_wait=%.0f%% path_occ=%.0f%% -> %s\n",
+                QpcToMs(now - t0) / 1000.0, act, window >> 20, thr / (1024.0 * 1024.0),
+                idleF * 100.0, budgF * 100.0, pathOcc * 100.0, kNames[a]);
+            note(line);
+        }
+        // Откат — тоже изменение: следующий период сравниваем с ним, а не с ростом
+        last = a;
+        if (a != kNone) lastThr = thr;
+    }
+};
+
+// --- ПУЛ ARENA-БЛОКОВ: МЕЛКИЕ ФАЙЛЫ ПАЧКОЙ ---
+// Файл до kArenaFile воркер пишет (заголовок + очищенный текст) в свой текущий
+// блок и отдаёт блок в outChan, только когда следующий файл не влезает. Output-поток
+// пишет блок одним WriteFile и возвращает его в пул. Блоки выделены заранее:
+// в установившемся режиме ни одной аллокации под контент, память = размер пула.
+// Порог совпадает с OutBuf::kDirectWrite: мельче файл всё равно копировался бы в буфер.
+
+static const size_t kArenaFile  = OutBuf::kDirectWrite;
+static const size_t kArenaBlock = 1024 * 1024;
+
+struct ArenaBlock {
+    std::unique_ptr<char[]>    mem;
+    size_t                     used = 0;
+    size_t                     cap  = 0;
+    std::vector<ManifestEntry> files;   // по порядку в mem; length = байт в блоке
+    ULONGLONG                  seq = 0; // номер первого файла; у остальных — следующие подряд
+
+    void   append(const char* p, size_t n) { memcpy(mem.get() + used, p, n); used += n; }
+    void   append(size_t n, char c)        { memset(mem.get() + used, c, n); used += n; }
+    size_t room() const                    { return cap - used; }
+};
+
+// Свободные блоки лежат в Ring: acquire ждёт, пока output-поток не вернёт блок
+struct BlockPool {
+    std::vector<ArenaBlock> blocks;
+    Ring<ArenaBlock*>       freeList;
+
+    BlockPool(size_t count, size_t size) : blocks(count), freeList(count) {
+        for (ArenaBlock& b : blocks) {
+            b.mem.reset(new char[size]);
+            b.cap = size;
+            freeList.send(&b);
+        }
+    }
+
+    ArenaBlock* acquire()            { ArenaBlock* b = nullptr; freeList.recv(b); return b; }
+    ArenaBlock* tryAcquire()         { ArenaBlock* b = nullptr; freeList.tryRecv(b); return b; }
+    void        release(ArenaBlock* b) { b->used = 0; b->files.clear(); freeList.send(b); }
+};
+
+// --- ПАКЕТНОЕ ЧТЕНИЕ МЕЛКИХ ФАЙЛОВ: OVERLAPPED + IOCP ---
+// Для исходника в пару КБ CreateFileMappingW + MapViewOfFile + unmap (VAD, таблицы
+// страниц, soft faults) дороже самих байт. Воркер открывает все мелкие файлы своей
+// пачки задач, ставит все ReadFile разом (overlapped, свой IOCP на воркер) в один
+// слэб и собирает завершения через GetQueuedCompletionStatusEx: устройство видит
+// всю пачку сразу, а на файл остаются CreateFileW + ReadFile + CloseHandle.
+// Размер — из сканера (FindNextFileW), GetFileSizeEx не нужен; если файл с тех пор
+// укоротился, ReadFile просто вернёт меньше. Чтения, завершённые синхронно (файл
+// в кэше), пакет в порт не шлют (FILE_SKIP_COMPLETION_PORT_ON_SUCCESS).
+// Схема ложится на IoRing (Windows 11): BuildIoRingReadFile на пачку + SubmitIoRing;
+// открытия IoRing не умеет, так что CreateFileW в любом случае по одному.
+// Крупнее kBatchReadMax — прежний путь: mapping и отдача диапазонов view без копий.
+
+static const size_t kBatchReadMax = kArenaFile;   // такие файлы целиком уходят в arena
+
+#ifdef _WIN32
+
+struct BatchReader {
+    struct Req {
+        OVERLAPPED ov;
+        HANDLE     h;
+        size_t     off;       // в слэбе
+        DWORD      want;
+        DWORD      got;
+        bool       skipPort;  // синхронное завершение не даст пакета в порт
+        bool       done;
+        bool       ok;
+    };
+
+    HANDLE                  iocp = NULL;
+    std::unique_ptr<char[]> slab;
+    size_t                  slabCap = 0;
+    std::vector<Req>        reqs;
+
+    BatchReader() { iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1); }
+    ~BatchReader() { if (iocp) CloseHandle(iocp); }
+
+    bool ready() const { return iocp != NULL; }
+
+    // Номер запроса или -1, если файл не открылся
+    int open(const wchar_t* path, DWORD size) {
+        HANDLE h = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (h == INVALID_HANDLE_VALUE) return -1;
+        if (!CreateIoCompletionPort(h, iocp, 0, 0)) { CloseHandle(h); return -1; }
+        Req r = {};
+        r.h        = h;
+        r.want     = size;
+        r.skipPort = SetFileCompletionNotificationModes(h, FILE_SKIP_COMPLETION_PORT_ON_SUCCESS) != 0;
+        reqs.push_back(r);
+        return (int)reqs.size() - 1;
+    }
+
+    // Ставит все чтения, ждёт все завершения и закрывает файлы
+    void submit() {
+        size_t total = 0;
+        for (Req& r : reqs) { r.off = total; total += r.want; }
+        if (total > slabCap) { slab.reset(new char[total]); slabCap = total; }
+
+        int pending = 0;
+        for (Req& r : reqs) {
+            DWORD got = 0;
+            if (ReadFile(r.h, slab.get() + r.off, r.want, &got, &r.ov)) {
+                if (r.skipPort) { r.got = got; r.ok = r.done = true; }
+                else            ++pending;
+            } else if (GetLastError() == ERROR_IO_PENDING) {
+                ++pending;
+            } else {
+                r.done = true;
+            }
+        }
+
+        OVERLAPPED_ENTRY ents[64];
+        while (pending > 0) {
+            ULONG n = 0;
+            if (!GetQueuedCompletionStatusEx(iocp, ents, 64, &n, INFINITE, FALSE)) break;
+            for (ULONG i = 0; i < n; ++i) {
+                Req& r = *CONTAINING_RECORD(ents[i].lpOverlapped, Req, ov);
+                r.ok   = GetOverlappedResult(r.h, &r.ov, &r.got, FALSE) != 0;
+                r.done = true;
+                --pending;
+            }
+        }
+        // Порт отказал — дожидаемся оставшихся по хэндлам: слэб не должен уйти из-под I/O
+        for (Req& r : reqs)
+            if (!r.done) { r.ok = GetOverlappedResult(r.h, &r.ov, &r.got, TRUE) != 0; r.done = true; }
+        for (Req& r : reqs) CloseHandle(r.h);
+    }
+
+    const char* data(int i) const { return slab.get() + reqs[i].off; }
+    size_t      size(int i) const { return reqs[i].ok ? reqs[i].got : 0; }
+    void        clear()           { reqs.clear(); }
+};
+
+#else
+
+// POSIX: тот же интерфейс, синхронные чтения по одному (overlapped I/O и IOCP нет)
+struct BatchReader {
+    struct Req {
+        HANDLE h;
+        size_t off;       // в слэбе
+        DWORD  want;
+        DWORD  got;
+    };
+
+    std::unique_ptr<char[]> slab;
+    size_t                  slabCap = 0;
+    std::vector<Req>        reqs;
+
+    bool ready() const { return true; }
+
+    // Номер запроса или -1, если файл не открылся
+    int open(const wchar_t* path, DWORD size) {
+        HANDLE h = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (h == INVALID_HANDLE_VALUE) return -1;
+        reqs.push_back({ h, 0, size, 0 });
+        return (int)reqs.size() - 1;
+    }
+
+    // Читает все файлы пачки по очереди и закрывает их
+    void submit() {
+        size_t total = 0;
+        for (Req& r : reqs) { r.off = total; total += r.want; }
+        if (total > slabCap) { slab.reset(new char[total]); slabCap = total; }
+
+        for (Req& r : reqs) {
+            DWORD got = 0;
+            while (r.got < r.want && ReadFile(r.h, slab.get() + r.off + r.got, r.want - r.got, &got, NULL) && got)
+                r.got += got;
+            CloseHandle(r.h);
+        }
+    }
+
+    const char* data(int i) const { return slab.get() + reqs[i].off; }
+    size_t      size(int i) const { return reqs[i].got; }
+    void        clear()           { reqs.clear(); }
+};
+
+#endif
+
+// --- ДЕДУПЛИКАЦИЯ: ОДИНАКОВЫЙ КОНТЕНТ ПИШЕТСЯ ОДИН РАЗ ---
+// Ключ — (хэш, размер). Целиком пишется копия с наименьшим номером (seq — порядок
+// обхода у своего писателя), остальные — блок-ссылкой "[same content as: <путь>]"
+// на неё. Так all.txt не зависит от того, какой воркер успел первым, и ссылка
+// никогда не ведёт вперёд.
+// Воркер решает по DedupTable — она помнит наименьший номер, увиденный к этому
+// моменту. Ссылку воркер пишет, только если меньший номер уже есть: файл с этим
+// номером пишется целиком и у писателя окажется раньше. Но копия с меньшим номером
+// может прийти в таблицу позже — тогда лишнюю полную копию и ссылку не на ту копию
+// исправляет писатель (с порядком): он идёт строго по номерам и знает окончательно
+// первую. Таблица — своя на каждого писателя: номера у писателей свои.
+// Решение не зависит от длины пути первой копии: дубликатом считается только файл
+// крупнее kDupMinSize — ссылка на любой путь короче него.
+// 64 шарда с отдельными мьютексами — воркеры почти не пересекаются. Содержимое
+// не сравнивается: коллизия 64-битного хэша при совпадении размера на реальных
+// деревьях пренебрежимо маловероятна.
+struct DedupTable {
+    struct Entry {
+        ULONGLONG   size;
+        ULONGLONG   seq;        // наименьший номер с этим контентом
+        std::string relUtf8;    // его путь
+    };
+    struct alignas(64) Shard {
+        std::mutex                               mtx;
+        std::unordered_map<ULONGLONG, Entry>     map;
+    };
+
+    Shard shards[64];
+
+    // true — у контента уже есть копия с меньшим номером, её путь в firstRel;
+    // false — файл пишется целиком (и становится первой копией, если номер меньше)
+    bool claim(ULONGLONG hash, ULONGLONG size, ULONGLONG seq, const std::string& rel, std::string& firstRel) {
+        Shard& s = shards[hash >> 58];
+        std::lock_guard<std::mutex> lk(s.mtx);
+        auto   ins = s.map.try_emplace(hash, Entry{ size, seq, rel });
+        Entry& e   = ins.first->second;
+        if (ins.second || e.size != size) return false;
+        if (seq < e.seq) { e.seq = seq; e.relUtf8 = rel; return false; }
+        firstRel = e.relUtf8;
+        return true;
+    }
+};
+
+static const char kDupRef[] = "[same content as: ";
+
+// Ссылка "<заголовок>[same content as: <путь>]\n\n" короче контента любого файла крупнее
+// этого: путь в UTF-8 не длиннее MAX_PATH * 4 байт (буфер воркера)
+static const ULONGLONG kDupMinSize = sizeof(kDupRef) - 1 + MAX_PATH * 4 + 3;
+
+struct DumpTask {
+    std::wstring         path;
+    ULONGLONG            size  = 0;
+    ULONGLONG            mtime = 0;
+    const ManifestEntry* prev  = nullptr;   // запись прошлого прогона по этому пути
+    ULONGLONG            charge = 0;        // зарезервировано в ByteBudget
+    unsigned             shard  = 0;        // режим shard=: номер шарда с нуля
+    ULONGLONG            lcn    = 0;        // elevator: первый кластер файла
+    ULONGLONG            seq    = 0;        // номер в выводе своего писателя (порядок обхода)
+};
+
+// Сегмент вывода: [off, off+len) в DumpChunk::data или в DumpChunk::view
+struct ChunkSeg {
+    size_t off;
+    size_t len;
+    bool   inView;
+};
+
+struct DumpChunk {
+    std::string   data;          // заголовок + строки замены (или весь блок, если segs пуст)
+    std::vector<ChunkSeg> segs;  // порядок вывода; ссылаются на data и view
+    const char*   view = nullptr;   // отображение файла, освобождает output-поток
+    HANDLE        hMap = NULL;
+    ArenaBlock*   block = nullptr;  // пачка мелких файлов, метаданные — в block->files
+    ULONGLONG     frameRaw = 0;     // режим lz4: data — готовый кадр из стольких байт текста
+    std::wstring  streamPath;    // крупный файл: в data только заголовок, контент — потоком
+    ULONGLONG     charge  = 0;   // освобождает output-поток после записи
+    ULONGLONG     copyOff = 0;   // либо диапазон старого all.txt (copyLen > 0)
+    ULONGLONG     copyLen = 0;
+    unsigned      shard   = 0;   // определяет outChan и выходной файл
+    ULONGLONG     seq     = 0;   // номер задачи; блок покрывает block->files.size() номеров
+    ManifestEntry meta;          // пустой relUtf8 → в манифест не попадает
+};
+
+// --- ДЕТЕРМИНИРОВАННЫЙ ПОРЯДОК ВЫВОДА ---
+// Сканер нумерует задачи каждого писателя в порядке обхода (DFS — один и тот же от
+// прогона к прогону), писатель раскладывает пришедшие чанки по окну из kOrderWindow
+// слотов и пишет строго по номерам. Воркер, чей номер в окно не влезает, ждёт —
+// это и есть backpressure: память окна ограничена, а не растёт с отставанием
+// медленного воркера. Окно шире elevator-окна и пачки задач, поэтому задача с
+// номером next всегда у воркера, который сам не ждёт, или в pathChan перед ждущими.
+static const ULONGLONG kOrderWindow = 4096;
+
+struct OrderWindow {
+    alignas(64) std::atomic<ULONGLONG> next{ 0 };   // первый незаписанный номер
+    std::atomic<int>                   sleeping{ 0 };
+
+    bool admits(ULONGLONG seq) const { return seq < next.load(std::memory_order_acquire) + kOrderWindow; }
+
+    // Та же схема, что у Ring: счётчик спящих → fence → повторная проверка
+    void wait(ULONGLONG seq) {
+        for (;;) {
+            const ULONGLONG cur = next.load(std::memory_order_acquire);
+            if (seq < cur + kOrderWindow) return;
+            sleeping.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (seq >= next.load() + kOrderWindow) next.wait(cur);
+            sleeping.fetch_sub(1);
+        }
+    }
+
+    // Писатель — раз на пачку чанков
+    void advance(ULONGLONG n) {
+        next.store(n, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) > 0) next.notify_all();
+    }
+};
+
+// Блок-ссылка файла rel на первую копию того же контента (см. ДЕДУПЛИКАЦИЯ)
+template<typename Out>
+static void AppendDupRef(Out& out, const std::string& rel, const std::string& firstRel) {
+    AppendChunkHeader(out, rel.data(), (int)rel.size());
+    out.append(kDupRef, sizeof(kDupRef) - 1);
+    out.append(firstRel.data(), firstRel.size());
+    out.append("]\n\n", 3);
+}
+
+// Один выходной файл дампа: all.txt или шард all.NNN.txt
+struct DumpSink {
+    OutBuf                     out;
+    std::wstring               tmpPath;
+    ULONGLONG                  outPos  = 0;   // байт текста (до сжатия)
+    ULONGLONG                  compPos = 0;   // режим lz4: байт в файле
+    ULONGLONG                  pendOff = 0;   // подряд идущие блоки старого all.txt
+    ULONGLONG                  pendLen = 0;
+    std::vector<Lz4IndexEntry> index;
+    std::unique_ptr<Lz4Frame>  lzf;
+    ULONGLONG                  files = 0, bytesIn = 0;
+};
+
+// Имя шарда по номеру с единицы: all.001.txt (в режиме lz4 — all.001.txt.lz4)
+static std::wstring ShardName(unsigned n, bool lz4) {
+    wchar_t buf[40];
+    swprintf(buf, 40, L"all.%03u.txt%ls", n, lz4 ? L".lz4" : L"");
+    return buf;
+}
+
+bool GenerateAllTxt(EngineContext& ctx, const std::wstring& folderPath) {
+    const LONGLONG       tStart = QpcNow();
+    const EngineOptions& opt    = ctx.opt;
+    ctx.stats.reset();
+    TraceReset(ctx.trace, opt.traceMode);
+    TraceThreadBegin(ctx.trace, "scanner");
+    std::wstring baseStr = folderPath;
+    if (!baseStr.empty() && baseStr.back() != L'\\') baseStr += L'\\';
+    const DWORD baseLen = (DWORD)baseStr.length();
+
+    const bool      lz4        = opt.lz4;
+    const ULONGLONG shardLimit = ctx.streaming() ? 0 : opt.shardMB * 1024 * 1024;   // поток — один
+    const bool      sharded    = shardLimit != 0;
+    const std::wstring allPath = baseStr + (lz4 ? L"all.txt.lz4" : L"all.txt");
+    const std::wstring tmpPath = allPath + L".tmp";
+    const std::wstring manPath = baseStr + L"all.manifest";
+    const std::wstring manTmp  = baseStr + L"all.manifest.tmp";
+
+    // Прошлый дамп + манифест к нему → инкрементальный режим
+    Manifest prevManifest;
+    HANDLE hPrev = lz4 || sharded ? INVALID_HANDLE_VALUE : CreateFileW(allPath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hPrev != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER psz;
+        if (!GetFileSizeEx(hPrev, &psz) || !LoadManifest(manPath.c_str(), (ULONGLONG)psz.QuadPart, opt.contentFilters, prevManifest))
+            prevManifest.clear();
+        if (prevManifest.empty()) { CloseHandle(hPrev); hPrev = INVALID_HANDLE_VALUE; }
+    }
+
+    // Определяем тип тома и стартовые параметры; дальше числом активных
+    // воркеров и окном бюджета управляет DumpTuner (если не "tune=0")
+    const VolumeKind vol  = ClassifyVolume(baseStr.c_str());
+    const bool       ssd  = vol != kVolHdd;
+    DumpTuning       tun  = InitialTuning(vol);
+    const bool       tune = opt.tune;
+    if (opt.workers > 0) tun.startWorkers = tun.maxWorkers = opt.workers;
+    const int  numWorkers    = tune ? tun.maxWorkers : tun.startWorkers;   // потоков; активных — tuner.active
+    const int  pathChanCap   = ssd ? 256 : 16;   // HDD: маленькая очередь = меньше seek-ов
+    const int  outChanCap    = 256;              // предел задаёт бюджет, а не число слотов
+    const ULONGLONG budgetMB = opt.budgetMB ? opt.budgetMB : tun.budgetMB;   // потолок окна
+    const int  pathBatch     = ssd ? 32  : 4;    // задач за одну операцию с pathChan
+    const int  numWriters    = sharded && ssd ? 4 : 1;   // HDD: параллельная запись = seek-и
+    const bool ordered       = opt.ordered;
+
+    // Шарды держат меньший буфер: открытых файлов может быть много
+    auto openSink = [&](const std::wstring& path) {
+        std::unique_ptr<DumpSink> sk(new DumpSink);
+        sk->tmpPath = path;
+        if (lz4) sk->lzf.reset(new Lz4Frame);
+        if (ctx.streaming()) sk->out.attach(ctx.out, 8 * 1024 * 1024);
+        else if (!sk->out.open(path.c_str(), sharded ? 1 * 1024 * 1024 : 8 * 1024 * 1024)) sk.reset();
+        return sk;
+    };
+    // sinks[w][s / numWriters] — шард s у писателя w = s % numWriters
+    std::vector<std::vector<std::unique_ptr<DumpSink>>> sinks(numWriters);
+    if (!sharded) {
+        sinks[0].push_back(openSink(tmpPath));
+        if (!sinks[0][0]) {
+            if (hPrev != INVALID_HANDLE_VALUE) CloseHandle(hPrev);
+            return false;
+        }
+    }
+
+    // Каналы (lock-free; задачи ходят пачками — меньше пробуждений на файл)
+    Ring<DumpTask> pathChan(pathChanCap);
+    std::vector<std::unique_ptr<Ring<DumpChunk>>> outChans;
+    for (int i = 0; i < numWriters; ++i) outChans.emplace_back(new Ring<DumpChunk>(outChanCap));
+    auto chanFor = [&](unsigned shard) -> Ring<DumpChunk>& { return *outChans[shard % numWriters]; };
+
+    // Каждому воркеру — текущий блок плюс запас на очередь к output-потоку
+    // (с порядком — и на блоки, ждущие в окне писателя)
+    BlockPool pool((size_t)numWorkers * (ordered ? 4 : 2) + 2, kArenaBlock);
+    std::unique_ptr<OrderWindow[]> windows(new OrderWindow[numWriters]);
+    ByteBudget budget(tune ? budgetMB * 1024 * 1024 / 2 : budgetMB * 1024 * 1024);
+    DumpTuner  tuner(tune ? tun.startWorkers : numWorkers, 1, numWorkers, budgetMB * 1024 * 1024, opt.traceMode != 0);
+    {
+        char line[160];
+        snprintf(line, sizeof(line), "start: volume=%s workers=%d/%d window=%lluMB/%lluMB tune=%d\n",
+            kVolumeKindNames[vol], tuner.active.load(), numWorkers, budget.limit.load() >> 20, budgetMB, (int)tune);
+        tuner.note(line);
+    }
+    std::unique_ptr<DedupTable[]> dedup(new DedupTable[numWriters]);
+    std::atomic<ULONGLONG> dupFiles{ 0 }, dupSaved{ 0 };
+    std::atomic<ULONGLONG> binaryFiles{ 0 }, transcoded{ 0 };
+    auto skipBinary = [&]() { ++binaryFiles; ctx.progress.add(EngineProgress::kSkippedBinary); };
+
+    std::atomic<int> activeWorkers(numWorkers);
+
+    // --- ВОРКЕР: mmap + SIMD классификация текста + state-machine hex clean ---
+    auto workerFn = [&](int self) {
+        TraceThreadBegin(ctx.trace, "worker");
+        std::vector<DumpTask> tasks(pathBatch);
+        char utf8Buf[MAX_PATH * 4 + 4];
+        LONGLONG     busyTicks = 0;
+
+        // Режим lz4: каждый блок и каждый крупный файл воркер сам сжимает в кадр
+        std::unique_ptr<Lz4Frame> lzf(lz4 ? new Lz4Frame : nullptr);
+        std::string raw;
+        // Перекодированный в UTF-8 контент (UTF-16 / ANSI)
+        std::string  text;
+        std::wstring wide;
+
+        ArenaBlock* blk      = nullptr;
+        unsigned    blkShard = 0;
+        auto sendBlock = [&]() {
+            DumpChunk bc;
+            bc.block = blk;
+            bc.shard = blkShard;
+            bc.seq   = blk->seq;
+            if (lzf) {
+                TRACE_SCOPE(kStCompress);
+                const LONGLONG tz = QpcNow();
+                lzf->compress(blk->mem.get(), blk->used, bc.data);
+                bc.frameRaw = blk->used;
+                busyTicks += QpcNow() - tz;
+            }
+            blk = nullptr;
+            TRACE_SCOPE(kStWaitSend);
+            chanFor(bc.shard).send(std::move(bc));
+        };
+        // Текущий блок, если в нём есть need байт, он того же шарда и (с порядком) номер seq
+        // продолжает его номера, иначе отправляем его и берём новый. С порядком пул не ждём:
+        // блоки могут стоять в окне писателя как раз до номера, который у этого воркера, —
+        // nullptr, и файл уйдёт отдельным чанком
+        auto arenaFor = [&](size_t need, unsigned shard, ULONGLONG seq) -> ArenaBlock* {
+            if (blk && (blk->room() < need || blkShard != shard || (ordered && blk->seq + blk->files.size() != seq)))
+                sendBlock();
+            if (!blk) {
+                TRACE_SCOPE(kStWaitArena);
+                blk = ordered ? pool.tryAcquire() : pool.acquire();
+                if (!blk) return nullptr;
+                blkShard = shard;
+                blk->seq = seq;
+            }
+            return blk;
+        };
+        std::string firstRel;
+
+        // Мелкие файлы пачки читаются заранее одним заходом; slot[i] — запрос задачи i
+        BatchReader      reader;
+        const bool       batchReads = opt.batchRead && reader.ready();
+        std::vector<int> slot(pathBatch, -1);
+        auto prefetch = [&](size_t got) {
+            TRACE_SCOPE(kStBatchRead);
+            const LONGLONG tr = QpcNow();
+            reader.clear();
+            for (size_t ti = 0; ti < got; ++ti) {
+                const DumpTask& t = tasks[ti];
+                slot[ti] = t.size && t.size <= kBatchReadMax ? reader.open(t.path.c_str(), (DWORD)t.size) : -1;
+            }
+            reader.submit();
+            busyTicks += QpcNow() - tr;
+        };
+
+        auto nextTasks = [&]() {
+            // Контроллер снял воркер: полублок отдаём сразу, спим между пачками.
+            // С порядком полублок уходит после каждой пачки: в нём может быть номер,
+            // которого ждёт писатель, а воркер сейчас может уснуть на pathChan
+            const bool parked = self >= tuner.active.load(std::memory_order_relaxed);
+            if (blk && (parked || ordered)) sendBlock();
+            if (parked) tuner.park(self);
+            size_t got;
+            {
+                TRACE_SCOPE(kStWaitPath);
+                const LONGLONG tw = QpcNow();
+                got = pathChan.recvBatch(tasks.data(), tasks.size());
+                tuner.idleTicks += QpcNow() - tw;
+            }
+            if (got && batchReads && !ctx.cancelled()) prefetch(got);
+            return got;
+        };
+
+        while (size_t got = nextTasks())
+        for (size_t ti = 0; ti < got; ++ti) {
+            DumpTask& task = tasks[ti];
+            // Номер не влезает в окно писателя — ждём; свой блок отдаём до ожидания
+            if (ordered) {
+                OrderWindow& win = windows[task.shard % numWriters];
+                if (!win.admits(task.seq)) {
+                    if (blk) sendBlock();
+                    ++ctx.stats.orderStalls;
+                    TRACE_SCOPE(kStWaitOrder);
+                    win.wait(task.seq);
+                }
+            }
+            // Резерв файла освобождается в конце итерации, если не ушёл вместе с чанком;
+            // там же файл засчитывается в прогресс как обработанный
+            struct ChargeGuard {
+                ByteBudget& b; ULONGLONG& n; EngineProgress& p;
+                ~ChargeGuard() { b.release(n); n = 0; p.add(EngineProgress::kFilesDone); }
+            } guard{ budget, task.charge, ctx.progress };
+            // С порядком номер обязан дойти до писателя, даже если файл пропущен
+            // (отмена, не открылся, пустой): тогда — пустым чанком без манифеста
+            struct SeqGuard {
+                Ring<DumpChunk>* chan; ULONGLONG seq; unsigned shard;
+                ~SeqGuard() {
+                    if (!chan) return;
+                    DumpChunk s;
+                    s.seq   = seq;
+                    s.shard = shard;
+                    chan->send(std::move(s));
+                }
+            } seqGuard{ ordered ? &chanFor(task.shard) : nullptr, task.seq, task.shard };
+            if (ctx.cancelled()) continue;
+            tuner.bytesDone.fetch_add(task.size, std::memory_order_relaxed);
+            const std::wstring& fullPath = task.path;
+
+            const LONGLONG t0 = QpcNow();
+            auto emitFrom = [&](DumpChunk&& c, LONGLONG since) {
+                c.charge    = task.charge;
+                c.shard     = task.shard;
+                c.seq       = task.seq;
+                task.charge = 0;
+                seqGuard.chan = nullptr;
+                busyTicks += QpcNow() - since;
+                TRACE_SCOPE(kStWaitSend);
+                chanFor(c.shard).send(std::move(c));
+            };
+            auto emit = [&](DumpChunk&& c) { emitFrom(std::move(c), t0); };
+
+            // UTF-8 конвертация относительного пути (single-pass, стековый буфер)
+            int relWLen = (int)(fullPath.size() - (size_t)baseLen);
+            int utf8Len = WideCharToMultiByte(CP_UTF8, 0,
+                fullPath.c_str() + baseLen, relWLen,
+                utf8Buf, (int)sizeof(utf8Buf) - 4, NULL, NULL);
+            if (utf8Len <= 0) continue;
+
+            DumpChunk c;
+            c.meta.relUtf8.assign(utf8Buf, (size_t)utf8Len);
+            c.meta.size  = task.size;
+            c.meta.mtime = task.mtime;
+
+            // Мелкий вывод (put пишет его в ArenaBlock или std::string) — в arena-блок;
+            // если блока нет (с порядком и пустым пулом) — отдельным чанком
+            auto putSmall = [&](size_t need, auto&& put) {
+                busyTicks += QpcNow() - t0;
+                ArenaBlock*    b  = arenaFor(need, task.shard, task.seq);
+                const LONGLONG t1 = QpcNow();
+                if (b) {
+                    const size_t start = b->used;
+                    put(*b);
+                    c.meta.length = b->used - start;
+                    b->files.push_back(std::move(c.meta));
+                    seqGuard.chan = nullptr;
+                    busyTicks += QpcNow() - t1;
+                    return;
+                }
+                raw.clear();
+                put(raw);
+                if (lzf) {
+                    TRACE_SCOPE(kStCompress);
+                    lzf->compress(raw.data(), raw.size(), c.data);
+                    c.frameRaw = raw.size();
+                } else {
+                    c.data.swap(raw);
+                }
+                emitFrom(std::move(c), t1);
+            };
+
+            const char* view = nullptr;
+            HANDLE      hMap = NULL;      // NULL — view в слэбе BatchReader, отображения нет
+            size_t      sz   = 0;
+            const int   rq   = batchReads ? slot[ti] : -1;
+            if (rq >= 0) {
+                sz = reader.size(rq);
+                if (!sz) continue;
+                view = reader.data(rq);
+            } else {
+                // Открываем файл
+                TRACE_SPAN(openSpan, kStOpen);
+                HANDLE hFile = CreateFileW(fullPath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                    NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+                if (hFile == INVALID_HANDLE_VALUE) continue;
+
+                LARGE_INTEGER fsz;
+                if (!GetFileSizeEx(hFile, &fsz) || fsz.QuadPart == 0) { CloseHandle(hFile); continue; }
+                TRACE_DONE(openSpan);
+
+                // Крупный файл: здесь только классификация по первым 4 КБ, контент пойдёт
+                // потоком скользящими окнами прямо в output-потоке (без усечения и без
+                // перекодировки — UTF-16 такого размера пропускается как бинарный)
+                if ((ULONGLONG)fsz.QuadPart > kMapWholeLimit) {
+                    char  head[4096];
+                    DWORD got = 0;
+                    BOOL  ok  = ReadFile(hFile, head, sizeof(head), &got, NULL);
+                    CloseHandle(hFile);
+                    if (!ok) continue;
+                    TRACE_SPAN(headSpan, kStHeadCheck);
+                    size_t     bom    = 0;
+                    const bool isText = DetectTextKind(head, got, bom) == kTextUtf8 && !IsBinaryText(ScanText(head, got), got);
+                    TRACE_DONE(headSpan);
+                    if (isText) {
+                        AppendChunkHeader(c.data, utf8Buf, utf8Len);
+                        c.streamPath = fullPath;
+                    } else {
+                        skipBinary();
+                    }
+                    emit(std::move(c));
+                    continue;
+                }
+
+                sz = (size_t)fsz.QuadPart;
+
+                // Memory Mapped File: ОС сама управляет кэшем, ноль лишних копий ядро→юзер
+                TRACE_SPAN(mapSpan, kStMap);
+                hMap = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+                CloseHandle(hFile);
+                if (!hMap) continue;
+
+                view = (const char*)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, sz);
+                if (!view) { CloseHandle(hMap); continue; }
+                TRACE_DONE(mapSpan);
+            }
+            auto unmap = [&]() { if (hMap) { UnmapViewOfFile(view); CloseHandle(hMap); } };
+            ctx.progress.add(EngineProgress::kBytesRead, sz);
+
+            // Кодировка по BOM; у бинарного файла почти всегда ноль в первом килобайте —
+            // такой отсекаем без полного прохода. Бинарный файл всё равно уходит
+            // в манифест — с пустым блоком.
+            TRACE_SPAN(headSpan, kStHeadCheck);
+            size_t         bom  = 0;
+            const TextKind kind = DetectTextKind(view, sz, bom);
+            const bool     headBinary = kind == kTextUtf8 && HasNullByte(view, min(sz, (size_t)1024));
+            TRACE_DONE(headSpan);
+            if (headBinary) {
+                skipBinary();
+                unmap();
+                emit(std::move(c));
+                continue;
+            }
+
+            // Хэш сырых байт; для UTF-8 тот же проход проверяет кодировку и считает
+            // управляющие байты по всему файлу — бинарные данные после первого КБ тоже
+            TRACE_SPAN(hashSpan, kStHash);
+            TextScanner scan;
+            c.meta.hash = kind == kTextUtf8 ? HashScan(view, sz, scan) : HashBytes(view, sz);
+            TRACE_DONE(hashSpan);
+            if (kind == kTextUtf8 && IsBinaryText(scan.res, sz)) {
+                skipBinary();
+                unmap();
+                c.meta.hash = 0;
+                emit(std::move(c));
+                continue;
+            }
+
+            // Дубликат или первая копия своего контента (см. ДЕДУПЛИКАЦИЯ)
+            auto claimDup = [&]() {
+                return task.size > kDupMinSize &&
+                    dedup[task.shard % numWriters].claim(c.meta.hash, task.size, task.seq, c.meta.relUtf8, firstRel);
+            };
+
+            // mtime сменился, а контент тот же (checkout, touch) → берём старый блок
+            // (целиком: если он дубликат, ссылкой его сделает писатель)
+            const ManifestEntry* prev = task.prev;
+            if (prev && prev->length && !(prev->flags & kEntryDup) &&
+                prev->size == task.size && prev->hash == c.meta.hash) {
+                claimDup();
+                unmap();
+                c.copyOff = prev->offset;
+                c.copyLen = prev->length;
+                emit(std::move(c));
+                continue;
+            }
+
+            // body — то, что пойдёт в дамп: view без BOM либо перекодированный text
+            const char* body    = view + bom;
+            size_t      bodyLen = sz - bom;
+            bool        recoded = false;
+            if ((opt.contentFilters & kXfMinified) && IsLockfileName(fullPath.c_str() + fullPath.rfind(L'\\') + 1)) {
+                // Lock-файл: вместо тела — заглушка (перекодировать нечего)
+                body    = kLockfileStub;
+                bodyLen = sizeof(kLockfileStub) - 1;
+            } else if (kind != kTextUtf8 || (!scan.res.utf8 && LooksLikeAnsi(body, bodyLen))) {
+                TRACE_SPAN(transSpan, kStTranscode);
+                const bool ok = RecodeText(kind, body, bodyLen, text, wide);
+                TRACE_DONE(transSpan);
+                if (!ok) {
+                    skipBinary();
+                    unmap();
+                    c.meta.hash = 0;
+                    emit(std::move(c));
+                    continue;
+                }
+                body    = text.data();
+                bodyLen = text.size();
+                recoded = true;
+                ++transcoded;
+            }
+
+            // Такой же контент у файла с меньшим номером → блок-ссылка вместо повтора
+            if (claimDup()) {
+                unmap();
+                c.meta.flags |= kEntryDup;
+                putSmall((size_t)utf8Len * 2 + 4 + sizeof(kDupRef) - 1 + firstRel.size() + 3, [&](auto& out) {
+                    AppendDupRef(out, c.meta.relUtf8, firstRel);
+                });
+                continue;
+            }
+
+            // Мелкий файл — в arena-блок. Очистка только укорачивает текст,
+            // поэтому места под заголовок + исходник + "\n\n" достаточно.
+            if (bodyLen <= kArenaFile) {
+                putSmall((size_t)utf8Len * 2 + 4 + bodyLen + 2, [&](auto& out) {
+                    AppendChunkHeader(out, utf8Buf, utf8Len);
+                    {
+                        TRACE_SCOPE(kStClean);
+                        CleanContent(opt.contentFilters, body, bodyLen, out);
+                    }
+                    out.append("\n\n", 2);
+                });
+                unmap();
+                continue;
+            }
+
+            if (lzf) {
+                raw.clear();
+                AppendChunkHeader(raw, utf8Buf, utf8Len);
+                {
+                    TRACE_SCOPE(kStClean);
+                    CleanContent(opt.contentFilters, body, bodyLen, raw);
+                }
+                raw += "\n\n";
+                unmap();
+                {
+                    TRACE_SCOPE(kStCompress);
+                    lzf->compress(raw.data(), raw.size(), c.data);
+                }
+                c.frameRaw = raw.size();
+                emit(std::move(c));
+                continue;
+            }
+
+            // Перекодированный контент живёт в буфере воркера — копируется в data
+            if (recoded) {
+                AppendChunkHeader(c.data, utf8Buf, utf8Len);
+                {
+                    TRACE_SCOPE(kStClean);
+                    CleanContent(opt.contentFilters, body, bodyLen, c.data);
+                }
+                c.data += "\n\n";
+                unmap();
+                emit(std::move(c));
+                continue;
+            }
+
+            // Контент: трансформы чистит ContentFilter (без regex!), остальное
+            // уходит диапазонами view — байты файла в data не копируются
+            struct SegSink {
+                DumpChunk& c;
+                void add(size_t off, size_t n, bool inView) {
+                    if (!n) return;
+                    if (!c.segs.empty()) {
+                        ChunkSeg& last = c.segs.back();
+                        if (last.inView == inView && last.off + last.len == off) { last.len += n; return; }
+                    }
+                    c.segs.push_back({ off, n, inView });
+                }
+                void literal(const char* p, size_t n) { add(c.data.size(), n, false); c.data.append(p, n); }
+                void source(ULONGLONG off, ULONGLONG n) { add((size_t)off, (size_t)n, true); }
+            } sink{ c };
+
+            AppendChunkHeader(c.data, utf8Buf, utf8Len);
+            sink.add(0, c.data.size(), false);
+
+            TRACE_SPAN(cleanSpan, kStClean);
+            WithContentFilter(opt.contentFilters, [&](auto* type) {
+                typename std::remove_pointer<decltype(type)>::type cf;
+                cf.emitted = bom;
+                cf.feed(body, bom, bodyLen, sink);
+                cf.finish(sz, sink);
+            });
+            sink.literal("\n\n", 2);
+            TRACE_DONE(cleanSpan);
+
+            c.view = view;
+            c.hMap = hMap;
+            emit(std::move(c));
+        }
+
+        if (blk) sendBlock();
+        ctx.stats.workerTicks += busyTicks;
+
+        // Последний воркер закрывает outChans → output-потоки завершаются
+        if (--activeWorkers == 0)
+            for (auto& ch : outChans) ch->close();
+    };
+
+    // --- OUTPUT ПОТОКИ: последовательная запись каждого файла + новый манифест ---
+    std::vector<ManifestEntry> newManifest;   // только без шардов: там писатель один
+    std::atomic<bool>          dumpOk{ true };
+
+    auto writerFn = [&](int w) {
+        TraceThreadBegin(ctx.trace, "writer");
+        const size_t kOutBatch = 8;
+        DumpChunk    chunks[kOutBatch];
+        auto&        mine = sinks[w];
+        LONGLONG     busyTicks = 0;
+
+        auto flushCopy = [&](DumpSink& sk) {
+            if (sk.pendLen && !sk.out.copyFrom(hPrev, sk.pendOff, sk.pendLen)) dumpOk = false;
+            sk.pendLen = 0;
+        };
+        // Режим lz4: кадры воркеров только дописываются, сжимаем здесь лишь потоковые файлы
+        auto writeFrame = [&](DumpSink& sk, const std::string& frame) {
+            sk.index.push_back({ sk.compPos, sk.outPos });
+            sk.out.write(frame.data(), (DWORD)frame.size());
+            sk.compPos += frame.size();
+        };
+        // Файл шарда создаётся по первому чанку
+        auto sinkFor = [&](unsigned shard) -> DumpSink* {
+            const size_t i = shard / numWriters;
+            if (i >= mine.size()) mine.resize(i + 1);
+            if (!mine[i] && !(mine[i] = openSink(baseStr + ShardName(shard + 1, lz4) + L".tmp")))
+                dumpOk = false;
+            return mine[i].get();
+        };
+
+        auto nextChunks = [&]() {
+            TRACE_SCOPE(kStWaitOut);
+            return chanFor(w).recvBatch(chunks, kOutBatch);
+        };
+
+        // С порядком первая копия контента — первая полная, пришедшая сюда: номера идут
+        // подряд. true — файл должен стать ссылкой на неё, текст ссылки в ref
+        // (воркер мог записать контент или ссылку на другую копию, см. ДЕДУПЛИКАЦИЯ)
+        std::unordered_map<ULONGLONG, DedupTable::Entry> firsts;
+        std::string ref, frame;
+        auto dupRef = [&](ManifestEntry& e) {
+            if (!ordered || !e.hash || e.size <= kDupMinSize) return false;
+            auto ins = firsts.try_emplace(e.hash, DedupTable::Entry{ e.size, 0, e.relUtf8 });
+            if (ins.second || ins.first->second.size != e.size) return false;
+            ref.clear();
+            AppendDupRef(ref, e.relUtf8, ins.first->second.relUtf8);
+            e.flags |= kEntryDup;
+            return true;
+        };
+        auto countDup = [&](const ManifestEntry& e) {
+            if (!(e.flags & kEntryDup)) return;
+            ++dupFiles;
+            if (e.size > e.length) dupSaved += e.size - e.length;
+        };
+        // Исправленные писателем файлы блока: [off, off + len) в mem → fix[fixOff, + fixLen)
+        struct DupPatch { size_t off, len, fixOff, fixLen; };
+        std::vector<DupPatch> patches;
+        std::string           fix, spliced;
+
+        auto writeChunk = [&](DumpChunk& c) {
+            const LONGLONG t0 = QpcNow();
+            TRACE_SCOPE(kStWrite);
+            DumpSink* skp = dumpOk.load() ? sinkFor(c.shard) : nullptr;
+            if (!skp) {
+                // Дамп уже не удастся: только освобождаем ресурсы чанка
+                if (c.block) { pool.release(c.block); c.block = nullptr; }
+                if (c.view)  { UnmapViewOfFile(c.view); CloseHandle(c.hMap); c.view = nullptr; c.hMap = NULL; }
+                budget.release(c.charge);
+                c = DumpChunk();
+                return;
+            }
+            DumpSink& sk = *skp;
+
+            if (c.block) {
+                flushCopy(sk);
+                ArenaBlock* b = c.block;
+                // Ссылка воркера, совпавшая с нужной, остаётся в блоке как есть
+                patches.clear();
+                fix.clear();
+                size_t off = 0, used = b->used;
+                for (ManifestEntry& e : b->files) {
+                    const size_t len = (size_t)e.length;
+                    if (dupRef(e) && (len != ref.size() || memcmp(b->mem.get() + off, ref.data(), len) != 0)) {
+                        patches.push_back({ off, len, fix.size(), ref.size() });
+                        fix += ref;
+                        e.length = ref.size();
+                        used     = used - len + ref.size();
+                    }
+                    off += len;
+                }
+                if (patches.empty()) {
+                    if (c.frameRaw) writeFrame(sk, c.data);
+                    else            sk.out.writeView(b->mem.get(), b->used);
+                } else {
+                    // Редкий случай (копия с меньшим номером пришла к воркерам позже):
+                    // блок сшивается заново, в режиме lz4 — и сжимается здесь
+                    spliced.clear();
+                    size_t pos = 0;
+                    for (const DupPatch& pt : patches) {
+                        spliced.append(b->mem.get() + pos, pt.off - pos);
+                        spliced.append(fix, pt.fixOff, pt.fixLen);
+                        pos = pt.off + pt.len;
+                    }
+                    spliced.append(b->mem.get() + pos, b->used - pos);
+                    if (sk.lzf) {
+                        TRACE_SCOPE(kStCompress);
+                        frame.clear();
+                        sk.lzf->compress(spliced.data(), spliced.size(), frame);
+                        writeFrame(sk, frame);
+                    } else {
+                        sk.out.write(spliced.data(), (DWORD)spliced.size());
+                    }
+                }
+                for (ManifestEntry& e : b->files) {
+                    e.offset   = sk.outPos;
+                    sk.outPos += e.length;
+                    ++sk.files; sk.bytesIn += e.size;
+                    countDup(e);
+                    if (!sharded) newManifest.push_back(std::move(e));
+                }
+                ctx.progress.add(EngineProgress::kBytesWritten, used);
+                pool.release(b);
+                c.block = nullptr;
+                busyTicks += QpcNow() - t0;
+                return;
+            }
+
+            ULONGLONG written = 0;
+            if (dupRef(c.meta)) {
+                // Ссылку пишет писатель: контент (или ссылка воркера) не нужен
+                flushCopy(sk);
+                if (sk.lzf) {
+                    TRACE_SCOPE(kStCompress);
+                    frame.clear();
+                    sk.lzf->compress(ref.data(), ref.size(), frame);
+                    writeFrame(sk, frame);
+                } else {
+                    sk.out.write(ref.data(), (DWORD)ref.size());
+                }
+                written = ref.size();
+                if (c.view) { UnmapViewOfFile(c.view); CloseHandle(c.hMap); c.view = nullptr; c.hMap = NULL; }
+            } else if (c.copyLen) {
+                if (sk.pendLen && sk.pendOff + sk.pendLen == c.copyOff) sk.pendLen += c.copyLen;
+                else { flushCopy(sk); sk.pendOff = c.copyOff; sk.pendLen = c.copyLen; }
+                written = c.copyLen;
+            } else if (c.view) {
+                flushCopy(sk);
+                for (const ChunkSeg& sg : c.segs) {
+                    if (sg.inView) sk.out.writeView(c.view + sg.off, sg.len);
+                    else           sk.out.write(c.data.data() + sg.off, (DWORD)sg.len);
+                    written += sg.len;
+                }
+                // Запись синхронная: страницы уже в файловом кэше, view больше не нужен
+                UnmapViewOfFile(c.view); CloseHandle(c.hMap);
+                c.view = nullptr; c.hMap = NULL;
+            } else if (c.frameRaw) {
+                writeFrame(sk, c.data);
+                written = c.frameRaw;
+            } else if (sk.lzf && !c.streamPath.empty()) {
+                Lz4Out lo{ sk.out, *sk.lzf, sk.index, sk.compPos, sk.outPos };
+                lo.write(c.data.data(), (DWORD)c.data.size());
+                StreamCleanFile(c.streamPath.c_str(), lo, ctx);
+                ctx.progress.add(EngineProgress::kBytesRead, c.meta.size);
+                lo.write("\n\n", 2);
+                lo.flush();
+                written = lo.rawPos - sk.outPos;
+            } else if (!c.data.empty()) {
+                flushCopy(sk);
+                sk.out.write(c.data.data(), (DWORD)c.data.size());
+                written = c.data.size();
+                if (!c.streamPath.empty()) {
+                    written += StreamCleanFile(c.streamPath.c_str(), sk.out, ctx);
+                    ctx.progress.add(EngineProgress::kBytesRead, c.meta.size);
+                    sk.out.write("\n\n", 2);
+                    written += 2;
+                }
+            }
+
+            // Читатель потока закрыл pipe (или диск полон) — дальше писать некуда
+            if (sk.out.failed) { dumpOk = false; ctx.cancel = true; }
+
+            ctx.progress.add(EngineProgress::kBytesWritten, written);
+
+            ManifestEntry& e = c.meta;
+            e.offset   = sk.outPos;
+            e.length   = written;
+            sk.outPos += written;
+            if (written) { ++sk.files; sk.bytesIn += e.size; }
+            countDup(e);
+            if (!sharded && !e.relUtf8.empty()) newManifest.push_back(std::move(e));
+            budget.release(c.charge);
+            c.charge = 0;
+            c.data.clear(); c.data.shrink_to_fit();
+            c.segs.clear(); c.segs.shrink_to_fit();
+            busyTicks += QpcNow() - t0;
+        };
+
+        // С порядком чанк ждёт в окне свой номер; блок закрывает номера всех своих файлов
+        std::vector<DumpChunk> held(ordered ? (size_t)kOrderWindow : 0);
+        std::vector<char>      have(held.size(), 0);
+        OrderWindow&           win  = windows[w];
+        ULONGLONG              next = 0, heldNow = 0, heldPeak = 0;
+
+        while (size_t got = nextChunks()) {
+            for (size_t ci = 0; ci < got; ++ci) {
+                DumpChunk& c = chunks[ci];
+                if (!ordered) { writeChunk(c); continue; }
+                const size_t i = (size_t)(c.seq % kOrderWindow);
+                held[i] = std::move(c);
+                have[i] = 1;
+                heldPeak = max(heldPeak, ++heldNow);
+                while (have[(size_t)(next % kOrderWindow)]) {
+                    const size_t    j    = (size_t)(next % kOrderWindow);
+                    DumpChunk&      h    = held[j];
+                    const ULONGLONG span = h.block ? h.block->files.size() : 1;
+                    writeChunk(h);
+                    h       = DumpChunk();
+                    have[j] = 0;
+                    --heldNow;
+                    next += span;
+                }
+            }
+            if (ordered) win.advance(next);
+        }
+        ULONGLONG peak = ctx.stats.reorderPeak.load(std::memory_order_relaxed);
+        while (heldPeak > peak && !ctx.stats.reorderPeak.compare_exchange_weak(peak, heldPeak)) {}
+        const LONGLONG t0 = QpcNow();
+        for (auto& sk : mine) {
+            if (!sk) continue;
+            flushCopy(*sk);
+            if (lz4) Lz4WriteIndex(sk->out, sk->index, sk->outPos);
+            sk->out.flush();
+        }
+        busyTicks += QpcNow() - t0;
+        ctx.stats.outputTicks += busyTicks;
+    };
+
+    std::vector<std::thread> writers;
+    for (int i = 0; i < numWriters; ++i)
+        writers.emplace_back(writerFn, i);
+
+    // Сэмплер глубины очередей — только при трассировке
+    std::atomic<bool> sampling{ HELPERS_TRACE && opt.traceMode != 0 };
+    std::thread sampler;
+    if (sampling.load()) sampler = std::thread([&]() {
+        while (sampling.load()) {
+            ULONGLONG outDepth = 0;
+            for (auto& ch : outChans) outDepth += ch->depth();
+            ctx.trace.samples.push_back({ QpcNow(), pathChan.depth(), outDepth, budget.used.load() });
+            Sleep(1);
+        }
+    });
+
+    // --- ЗАПУСК ВОРКЕРОВ ---
+    std::vector<std::thread> workers;
+    workers.reserve(numWorkers);
+    for (int i = 0; i < numWorkers; ++i)
+        workers.emplace_back(workerFn, i);
+
+    // Контроллер: заполненность pathChan усредняет по сэмплам за период
+    std::atomic<bool> tuning{ tune };
+    std::thread tunerThread;
+    if (tune) tunerThread = std::thread([&]() {
+        double occ = 0;
+        int    samples = 0;
+        while (tuning.load()) {
+            Sleep(DumpTuner::kSampleMs);
+            occ += (double)pathChan.depth() / (double)pathChanCap;
+            if (++samples * DumpTuner::kSampleMs >= DumpTuner::kPeriodMs) {
+                tuner.tick(budget, occ / samples);
+                occ = 0; samples = 0;
+            }
+        }
+    });
+
+    // --- СКАНЕР (текущий поток + потоки перечисления): обход дерева директорий ---
+    // Размер и mtime приходят из FindNextFileW — неизменившийся файл даже не открываем
+    std::wstring rel;
+    std::string  scanFirst;
+    std::vector<DumpTask> pending;
+    pending.reserve(pathBatch);
+    auto sendPending = [&]() {
+        TRACE_SCOPE(kStWaitSend);
+        pathChan.sendBatch(pending.data(), pending.size());
+        pending.clear();
+    };
+
+    // HDD: окно задач уходит в pathChan не в порядке обхода, а по возрастанию
+    // первого кластера (elevator), направление чередуется между окнами — головка
+    // не возвращается к началу диска. Окно сбрасывается и перед ожиданием бюджета:
+    // резерв задач в нём освобождают только воркеры.
+    const bool   elevate         = opt.elevator == 2 || (opt.elevator == 1 && vol == kVolHdd);
+    const size_t kElevatorWindow = 256;
+    std::vector<DumpTask> elevator;
+    bool      elevUp    = true;
+    ULONGLONG scanHead  = 0, sortHead = 0;   // где была бы головка: в порядке обхода / отправки
+    auto travel = [&](ULONGLONG& head) {
+        ULONGLONG d = 0;
+        for (const DumpTask& t : elevator) {
+            if (!t.lcn) continue;
+            d   += t.lcn > head ? t.lcn - head : head - t.lcn;
+            head = t.lcn;
+        }
+        return d;
+    };
+    auto flushElevator = [&]() {
+        if (elevator.empty()) return;
+        {
+            TRACE_SCOPE(kStExtents);
+            for (DumpTask& t : elevator) t.lcn = FirstExtentLcn(t.path.c_str());
+        }
+        ctx.stats.lcnTravelScan += travel(scanHead);
+        // Неизвестный LCN (0) — резидентные и т.п.: остаются в начале окна в порядке обхода
+        std::stable_sort(elevator.begin(), elevator.end(), [&](const DumpTask& a, const DumpTask& b) {
+            if (!a.lcn || !b.lcn) return !a.lcn && b.lcn;
+            return elevUp ? a.lcn < b.lcn : a.lcn > b.lcn;
+        });
+        ctx.stats.lcnTravelSorted += travel(sortHead);
+        elevUp = !elevUp;
+        for (DumpTask& t : elevator) {
+            pending.push_back(std::move(t));
+            if (pending.size() == (size_t)pathBatch) sendPending();
+        }
+        elevator.clear();
+    };
+
+    unsigned  shard     = 0;
+    ULONGLONG shardFill = 0;
+    std::vector<ULONGLONG> seqNext(numWriters, 0);   // следующий номер у каждого писателя
+    const LONGLONG tScan = QpcNow();
+
+    // Предварительный подсчёт для процента и ETA: второй обход только перечисляет и
+    // не ждёт бюджета, как сканер, поэтому обгоняет его. На HDD не запускаем —
+    // лишние seek-и. Конец основного обхода заменяет оценку точным числом.
+    EngineContext pre;
+    std::thread   preCount;
+    if (ssd) preCount = std::thread([&]() {
+        ULONGLONG bytes = 0;
+        DirWalker w(WalkerThreads(true), pre);
+        w.run(baseStr, [&](const DirNode&, const WalkItem& it) { bytes += it.size; });
+        if (!pre.cancelled()) ctx.progress.setTotals(pre.progress.get(EngineProgress::kFilesFound), bytes);
+    });
+
+    ULONGLONG scanBytes = 0;
+    DirWalker walker(WalkerThreads(ssd), ctx);
+    walker.run(baseStr, [&](const DirNode& dir, const WalkItem& it) {
+        const wchar_t* name = dir.name(it);
+        scanBytes += it.size;
+        if (IsOwnOutput(name) || IsExcludedExtension(name)) {
+            ctx.progress.add(EngineProgress::kSkippedExcluded);
+            return;
+        }
+
+        DumpTask task;
+        task.size  = it.size;
+        task.mtime = FileTimeToU64(it.mtime);
+
+        if (!prevManifest.empty()) {
+            rel.assign(dir.path, baseLen, std::wstring::npos).append(name, it.nameLen);
+            auto found = prevManifest.find(rel);
+            if (found != prevManifest.end()) {
+                ManifestEntry& prev = found->second;
+                if (prev.size == task.size && prev.mtime == task.mtime && !(prev.flags & kEntryDup)) {
+                    // Скопированный блок — полный контент: дубликаты новых файлов сошлются на него
+                    // (без шардов писатель один)
+                    DumpChunk c;
+                    c.copyOff = prev.offset;
+                    c.copyLen = prev.length;
+                    c.seq     = seqNext[0]++;
+                    if (prev.length && prev.size > kDupMinSize)
+                        dedup[0].claim(prev.hash, prev.size, c.seq, prev.relUtf8, scanFirst);
+                    c.meta    = std::move(prev);   // каждый путь встречается один раз
+                    // Номер не влезает в окно: меньшие номера сначала отдаём воркерам
+                    if (ordered && !windows[0].admits(c.seq)) {
+                        flushElevator();
+                        sendPending();
+                        ++ctx.stats.orderStalls;
+                        TRACE_SCOPE(kStWaitOrder);
+                        windows[0].wait(c.seq);
+                    }
+                    chanFor(0).send(std::move(c));
+                    ctx.progress.add(EngineProgress::kFilesDone);
+                    return;
+                }
+                task.prev = &prev;
+            }
+        }
+
+        task.path.reserve(dir.path.size() + it.nameLen);
+        task.path.append(dir.path).append(name, it.nameLen);
+
+        // Шард по верхней оценке вывода: заголовок (путь в UTF-8 дважды + 4) + контент + "\n\n"
+        if (sharded) {
+            const int relBytes = WideCharToMultiByte(CP_UTF8, 0, task.path.c_str() + baseLen,
+                (int)(task.path.size() - baseLen), NULL, 0, NULL, NULL);
+            const ULONGLONG est = (ULONGLONG)relBytes * 2 + 6 + task.size;
+            if (shardFill && shardFill + est > shardLimit) { ++shard; shardFill = 0; }
+            shardFill += est;
+            task.shard = shard;
+        }
+        task.seq = seqNext[task.shard % numWriters]++;
+
+        // Бюджет исчерпан: сначала отдаём накопленную пачку — её резерв
+        // освободится только у воркеров, иначе ждали бы сами себя
+        task.charge = min(task.size, kMapWholeLimit);
+        if (!budget.tryAcquire(task.charge)) {
+            flushElevator();
+            sendPending();
+            TRACE_SCOPE(kStWaitBudget);
+            const LONGLONG tw = QpcNow();
+            budget.acquire(task.charge);
+            tuner.budgetTicks += QpcNow() - tw;
+        }
+        if (elevate) {
+            elevator.push_back(std::move(task));
+            if (elevator.size() == kElevatorWindow) flushElevator();
+            return;
+        }
+        pending.push_back(std::move(task));
+        if (pending.size() == (size_t)pathBatch) sendPending();
+    });
+    flushElevator();
+    sendPending();
+    ctx.stats.scanTicks = QpcNow() - tScan;
+    pre.cancel = true;
+    if (preCount.joinable()) preCount.join();
+    if (!ctx.cancelled()) ctx.progress.setTotals(ctx.progress.get(EngineProgress::kFilesFound), scanBytes);
+
+    // Сигнал воркерам: новых задач не будет. Остаток очереди дочитывают все.
+    pathChan.close();
+    if (tunerThread.joinable()) { tuning = false; tunerThread.join(); }
+    ctx.stats.workers = tuner.active.load();
+    tuner.note("steady state: workers=" + std::to_string(tuner.active.load()) +
+        " window=" + std::to_string(budget.limit.load() >> 20) + "MB\n");
+    tuner.releaseAll();
+
+    // Ждём завершения всех потоков
+    for (auto& w : workers) w.join();
+    for (auto& w : writers) w.join();
+    if (hPrev != INVALID_HANDLE_VALUE) CloseHandle(hPrev);
+    if (sampler.joinable()) { sampling = false; sampler.join(); }
+    // В потоковом режиме (out=) в сканируемую папку ничего не пишется — отчёты тоже
+    if (opt.traceMode && !ctx.cancelled() && !ctx.streaming()) {
+        TraceWriteReport(ctx.trace, baseStr);
+        std::string tuneLog;
+        for (const std::string& l : tuner.log) tuneLog += l;
+        WriteWholeFile(baseStr + L"all.tune.log", tuneLog);
+    }
+
+    // Выходные файлы по номеру шарда
+    std::vector<DumpSink*> outs;
+    size_t shardSlots = 0;
+    for (auto& v : sinks) shardSlots = max(shardSlots, v.size() * numWriters);
+    for (size_t sh = 0; sh < shardSlots; ++sh) {
+        auto& v = sinks[sh % numWriters];
+        if (sh / numWriters < v.size() && v[sh / numWriters]) outs.push_back(v[sh / numWriters].get());
+    }
+    ULONGLONG files = 0, bytesIn = 0, bytesOut = 0;
+    for (DumpSink* sk : outs) {
+        sk->out.close();
+        files    += sk->files;
+        bytesIn  += sk->bytesIn;
+        bytesOut += lz4 ? sk->compPos : sk->outPos;
+    }
+    ctx.stats.files        = files;
+    ctx.stats.bytesIn      = bytesIn;
+    ctx.stats.bytesOut     = bytesOut;
+    ctx.stats.dupFiles     = dupFiles.load();
+    ctx.stats.dupSaved     = dupSaved.load();
+    ctx.stats.binaryFiles  = binaryFiles.load();
+    ctx.stats.transcoded   = transcoded.load();
+    ctx.stats.budget       = budget.limit.load();
+    ctx.stats.peakInFlight = budget.peak.load();
+
+    const bool ok = !ctx.cancelled() && dumpOk.load();
+    if (ctx.streaming()) {
+        // Всё уже в потоке; манифест прошлого all.txt остаётся верным
+    } else if (!ok) {
+        for (DumpSink* sk : outs) DeleteFileW(sk->tmpPath.c_str());
+    } else if (sharded) {
+        // Номера подряд с 1 (пустой шард — одни бинарные файлы — выбрасываем),
+        // шарды прошлого прогона с большими номерами удаляем
+        unsigned n = 0;
+        for (DumpSink* sk : outs) {
+            if (sk->outPos && MoveFileExW(sk->tmpPath.c_str(), (baseStr + ShardName(n + 1, lz4)).c_str(),
+                    MOVEFILE_REPLACE_EXISTING)) ++n;
+            else DeleteFileW(sk->tmpPath.c_str());
+        }
+        while (DeleteFileW((baseStr + ShardName(++n, lz4)).c_str())) {}
+    } else if (lz4) {
+        if (!MoveFileExW(tmpPath.c_str(), allPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+            DeleteFileW(tmpPath.c_str());
+    } else {
+        // Сначала убираем старый манифест: он не должен пережить замену all.txt
+        DeleteFileW(manPath.c_str());
+        if (!MoveFileExW(tmpPath.c_str(), allPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+            DeleteFileW(tmpPath.c_str());
+        else if (!SaveManifest(manTmp.c_str(), outs[0]->outPos, opt.contentFilters, newManifest) ||
+                 !MoveFileExW(manTmp.c_str(), manPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+            DeleteFileW(manTmp.c_str());   // без манифеста следующий -dump пойдёт с нуля
+    }
+    ctx.stats.totalTicks = QpcNow() - tStart;
+    return ok;
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include "Platform.h"
+#include <atomic>
+#include <string>
+#include <type_traits>
+#include "ContentFilters.h"
+#include "Trace.h"
+
+// --- ПРОГРЕСС ПРОГОНА: СЧЁТЧИКИ БЕЗ БЛОКИРОВОК ---
+// Пишут обход, воркеры и писатель, читает фронтенд (окно раз в 100 мс, CLI) —
+// без мьютексов. Каждый счётчик в своей кэш-линии: соседние не делят её между ядрами.
+struct EngineProgress {
+    enum Counter {
+        kDirs, kFilesFound, kFilesDone, kBytesRead, kBytesWritten,
+        kSkippedBinary, kSkippedExcluded, kCounters
+    };
+    struct alignas(64) Slot { std::atomic<ULONGLONG> v{ 0 }; };
+
+    Slot                   slots[kCounters];
+    // Оценка итога: предварительный подсчёт, в конце обхода — точное число. 0 — неизвестен.
+    alignas(64) std::atomic<ULONGLONG> totalFiles{ 0 };
+    std::atomic<ULONGLONG>             totalBytes{ 0 };
+
+    __forceinline void add(Counter c, ULONGLONG n = 1) { slots[c].v.fetch_add(n, std::memory_order_relaxed); }
+    ULONGLONG get(Counter c) const { return slots[c].v.load(std::memory_order_relaxed); }
+
+    void setTotals(ULONGLONG files, ULONGLONG bytes) {
+        totalBytes.store(bytes, std::memory_order_relaxed);
+        totalFiles.store(files, std::memory_order_relaxed);
+    }
+    void reset() {
+        for (Slot& s : slots) s.v.store(0, std::memory_order_relaxed);
+        setTotals(0, 0);
+    }
+};
+
+// --- ПАРАМЕТРЫ ПРОГОНА ---
+// Всё, чем один прогон -list/-dump отличается от другого, — в EngineOptions
+// (аргументы после пути, ParseDumpArgs), счётчики — в DumpStats. Глобалов ядро
+// не читает: два прогона в одном процессе (-bench, окно и CLI) не мешают друг другу.
+
+struct EngineOptions {
+    // "budget=<МБ>": бюджет in-flight байт; 0 — по типу диска
+    ULONGLONG budgetMB   = 0;
+    // "lz4": вместо all.txt — all.txt.lz4 из независимых кадров + индекс.
+    // Без манифеста и инкрементальности: старый all.txt не трогается.
+    bool      lz4        = false;
+    // "shard=<МБ>": all.001.txt, all.002.txt, ... не больше МБ каждый (файл крупнее — один
+    // в своём шарде). Как и lz4 — без манифеста; сочетается с lz4 (all.001.txt.lz4).
+    ULONGLONG shardMB    = 0;
+    // "tune=0": без адаптивной подстройки — стартовые параметры на весь прогон
+    bool      tune       = true;
+    // "read=mmap": мелкие файлы тоже через mapping, без BatchReader ("read=batch" — по умолчанию)
+    bool      batchRead  = true;
+    // "elevator=0": на HDD читать в порядке обхода; "elevator=2" — сортировать по LCN на любом
+    // томе (для -bench). По умолчанию (1) — только на HDD.
+    int       elevator   = 1;
+    // "order=0": чанки в all.txt в порядке готовности воркеров, без окна переупорядочивания
+    // (только для сравнения в -bench: порядок тогда меняется от прогона к прогону)
+    bool      ordered    = true;
+    // "workers=<N>": стартовое и наибольшее число воркеров вместо выбранных по типу тома
+    // (с tune=0 — ровно N на весь прогон)
+    int       workers    = 0;
+    // "filter=...": маска ContentTransform; без аргумента — только hex
+    unsigned  contentFilters = kXfHex;
+    // "stats" — 1, "trace" — 2 (см. ТРАССИРОВКА КОНВЕЙЕРА); с out= отчёты не пишутся
+    int       traceMode  = 0;
+};
+
+// Счётчики прогона (EngineContext::stats, читает -bench). Воркеры копят время локально
+// и сбрасывают один раз на выходе — в горячем цикле только QpcNow().
+struct DumpStats {
+    std::atomic<ULONGLONG> files{ 0 };         // блоков в all.txt (включая скопированные)
+    std::atomic<ULONGLONG> bytesIn{ 0 };       // суммарный размер исходных файлов
+    std::atomic<ULONGLONG> bytesOut{ 0 };
+    std::atomic<LONGLONG>  scanTicks{ 0 };     // обход дерева (wall)
+    std::atomic<LONGLONG>  workerTicks{ 0 };   // сумма по воркерам, без ожидания каналов
+    std::atomic<LONGLONG>  outputTicks{ 0 };   // сумма по output-потокам, без ожидания outChan
+    std::atomic<LONGLONG>  totalTicks{ 0 };
+    std::atomic<ULONGLONG> budget{ 0 };         // действовавший бюджет in-flight байт
+    std::atomic<ULONGLONG> peakInFlight{ 0 };   // максимум зарезервированного
+    std::atomic<ULONGLONG> dupFiles{ 0 };       // записано ссылкой на первую копию
+    std::atomic<ULONGLONG> dupSaved{ 0 };       // на сколько байт меньше all.txt
+    std::atomic<ULONGLONG> binaryFiles{ 0 };    // отсеяно классификатором (пустой блок)
+    std::atomic<ULONGLONG> transcoded{ 0 };     // UTF-16 / ANSI → UTF-8
+    std::atomic<int>       workers{ 0 };        // активных воркеров к концу сканирования
+    // Elevator: суммарный путь головки в кластерах между началами файлов —
+    // в порядке обхода и в отправленном (отсортированном) порядке
+    std::atomic<ULONGLONG> lcnTravelScan{ 0 };
+    std::atomic<ULONGLONG> lcnTravelSorted{ 0 };
+    // Окно переупорядочивания: максимум чанков, ждавших своего номера у писателя,
+    // и сколько раз воркер или сканер ждал места в окне
+    std::atomic<ULONGLONG> reorderPeak{ 0 };
+    std::atomic<ULONGLONG> orderStalls{ 0 };
+
+    void reset() {
+        files = 0; bytesIn = 0; bytesOut = 0; budget = 0; peakInFlight = 0; dupFiles = 0; dupSaved = 0; workers = 0;
+        binaryFiles = 0; transcoded = 0; lcnTravelScan = 0; lcnTravelSorted = 0;
+        reorderPeak = 0; orderStalls = 0;
+        scanTicks = 0; workerTicks = 0; outputTicks = 0; totalTicks = 0;
+    }
+};
+
+// --- КОНТЕКСТ ДВИЖКА ---
+// Один прогон -list/-dump. Ядро не знает ни об окне, ни о консоли: отмену,
+// счётчики прогресса и приёмник вывода ему передаёт фронтенд (окно или CLI),
+// параметры — opt; итоги прогона ядро оставляет в stats и trace.
+struct EngineContext {
+    std::atomic<bool> cancel{ false };
+    EngineProgress    progress;
+    HANDLE            out = INVALID_HANDLE_VALUE;   // stdout/pipe; иначе — файл в папке
+    EngineOptions     opt;
+    DumpStats         stats;
+    TraceLog          trace;
+
+    // Поток вместо файла: без .tmp, манифеста, индекса и шардов
+    bool streaming() const { return out != INVALID_HANDLE_VALUE; }
+    bool cancelled() const { return cancel.load(std::memory_order_relaxed); }
+};
+
+// Собственные выходные файлы утилиты — не попадают ни в список, ни в дамп
+bool IsOwnOutput(const wchar_t* name);
+
+// --- ПОТОКОВАЯ ОЧИСТКА БОЛЬШИХ ФАЙЛОВ: СКОЛЬЗЯЩИЕ ОКНА MapViewOfFile ---
+// Файл любого размера (в т.ч. > 4 ГБ) идёт через ContentFilter окнами по kStreamWindow:
+// в памяти одновременно одно окно. Диапазон провалившегося кандидата, начатого
+// в прошлых окнах, перечитывается отдельным view (редкий случай).
+
+static const DWORD     kStreamWindow  = 16 * 1024 * 1024;   // кратно 64 КБ granularity
+static const ULONGLONG kMapWholeLimit = 32 * 1024 * 1024;   // крупнее — только потоком
+
+static inline const char* MapWindow(HANDLE hMap, ULONGLONG off, size_t len) {
+    return (const char*)MapViewOfFile(hMap, FILE_MAP_READ, (DWORD)(off >> 32), (DWORD)off, len);
+}
+
+// Пишет очищенное содержимое файла в out (OutBuf или Lz4Out: write + writeView).
+// Возвращает число записанных байт.
+template<typename Out>
+ULONGLONG StreamCleanFile(const wchar_t* path, Out& out, const EngineContext& ctx) {
+    HANDLE hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return 0;
+
+    LARGE_INTEGER fsz;
+    if (!GetFileSizeEx(hFile, &fsz) || fsz.QuadPart == 0) { CloseHandle(hFile); return 0; }
+    const ULONGLONG size = (ULONGLONG)fsz.QuadPart;
+
+    HANDLE hMap = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (!hMap) return 0;
+
+    struct ViewSink {
+        Out&        out;
+        HANDLE      hMap;
+        const char* win     = nullptr;
+        ULONGLONG   winOff  = 0;
+        ULONGLONG   written = 0;
+
+        void literal(const char* p, size_t n) { out.write(p, (DWORD)n); written += n; }
+
+        void source(ULONGLONG off, ULONGLONG n) {
+            // Часть до текущего окна — перечитываем выровненными view
+            while (n && off < winOff) {
+                const ULONGLONG aligned = off - off % kStreamWindow;
+                const size_t    delta   = (size_t)(off - aligned);
+                const size_t    take    = (size_t)min(n, min(winOff - off, (ULONGLONG)(kStreamWindow - delta)));
+                const char* v = MapWindow(hMap, aligned, delta + take);
+                if (!v) return;
+                out.writeView(v + delta, take);
+                UnmapViewOfFile(v);
+                off += take; n -= take; written += take;
+            }
+            if (n) { out.writeView(win + (off - winOff), (size_t)n); written += n; }
+        }
+    } sink{ out, hMap };
+
+    WithContentFilter(ctx.opt.contentFilters, [&](auto* type) {
+        typename std::remove_pointer<decltype(type)>::type cf;
+        ULONGLONG done = 0;
+        while (done < size && !ctx.cancelled()) {
+            const size_t len = (size_t)min((ULONGLONG)kStreamWindow, size - done);
+            const char*  v   = MapWindow(hMap, done, len);
+            if (!v) break;
+            sink.win    = v;
+            sink.winOff = done;
+            cf.feed(v, done, len, sink, done + len == size);
+            UnmapViewOfFile(v);
+            done += len;
+        }
+
+        // Текущего окна больше нет — хвост кандидата пойдёт через перечитывание
+        sink.win    = nullptr;
+        sink.winOff = done;
+        cf.finish(done, sink);
+    });
+
+    CloseHandle(hMap);
+    return sink.written;
+}
+
+// --- ЯДРО СКАНИРОВАНИЯ file_list.txt (I/O bound: параллелится только перечисление) ---
+// false — отмена или ошибка записи
+bool GenerateFileList(EngineContext& ctx, const std::wstring& folderPath);
+
+// --- ЯДРО ДАМПА all.txt (подробно — в Engine.cpp) ---
+
+// Аргументы -dump после пути → opt
+// false — аргумент задан неверно (сейчас только неизвестный трансформ в filter=)
+bool ParseDumpArgs(LPWSTR* argv, int argc, EngineOptions& opt);
+
+// Заголовок блока:
+//   "rel/path:\n"
+//   "----------\n"
+//   <content>\n\n
+template<typename Out>
+void AppendChunkHeader(Out& chunk, const char* relUtf8, int len) {
+    chunk.append(relUtf8, (size_t)len);
+    chunk.append(":\n", 2);
+    chunk.append((size_t)len, '-');
+    chunk.append("\n", 1);
+}
+
+// false — отмена или ошибка записи (в режиме файла all.txt тогда не меняется)
+bool GenerateAllTxt(EngineContext& ctx, const std::wstring& folderPath);
@@ -0,0 +1,94 @@
+#include "FileIndex.h"
+#include <cstring>
+#include "OutBuf.h"
+
+static const char kIndexMagic[8] = { 'H','L','P','I','D','X','1','\0' };
+
+static void PutVarint(std::string& s, ULONGLONG v) {
+    for (; v >= 0x80; v >>= 7) s += (char)(v | 0x80);
+    s += (char)v;
+}
+
+void FileIndexBuilder::add(const char* rel, size_t len, ULONGLONG fileSize, ULONGLONG fileMtime, DWORD fileAttrs) {
+    size_t shared = 0;
+    if (size.size() % kIndexRestart == 0) {
+        restarts.push_back(paths.size());
+    } else {
+        const size_t lim = min(len, prev.size());
+        while (shared < lim && prev[shared] == rel[shared]) ++shared;
+    }
+    PutVarint(paths, shared);
+    PutVarint(paths, len - shared);
+    paths.append(rel + shared, len - shared);
+    prev.assign(rel, len);
+    size.push_back(fileSize);
+    mtime.push_back(fileMtime);
+    attrs.push_back(fileAttrs);
+}
+
+bool FileIndexBuilder::save(const wchar_t* path) const {
+    FileIndexHeader h = {};
+    memcpy(h.magic, kIndexMagic, 8);
+    h.layout(size.size(), restarts.size(), paths.size());
+
+    OutBuf out;
+    if (!out.open(path, 1 * 1024 * 1024)) return false;
+    out.write((const char*)&h, (DWORD)sizeof(h));
+    out.writeView((const char*)size.data(),     size.size() * 8);
+    out.writeView((const char*)mtime.data(),    mtime.size() * 8);
+    out.writeView((const char*)restarts.data(), restarts.size() * 8);
+    out.writeView((const char*)attrs.data(),    attrs.size() * 4);
+    out.writeView(paths.data(),                 paths.size());
+    out.close();
+    if (out.failed) { DeleteFileW(path); return false; }
+    return true;
+}
+
+void FileIndexBuilder::replace(const std::wstring& path) const {
+    const std::wstring tmp = path + L".tmp";
+    if (save(tmp.c_str()) && MoveFileExW(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) return;
+    DeleteFileW(tmp.c_str());
+    DeleteFileW(path.c_str());
+}
+
+bool FileIndexView::open(const wchar_t* path) {
+    HANDLE hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fsz;
+    if (!GetFileSizeEx(hFile, &fsz) || (ULONGLONG)fsz.QuadPart < sizeof(FileIndexHeader)) {
+        CloseHandle(hFile);
+        return false;
+    }
+    hMap = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (!hMap) return false;
+    base = (const char*)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+    if (!base) { close(); return false; }
+
+    h = (const FileIndexHeader*)base;
+    const ULONGLONG total = (ULONGLONG)fsz.QuadPart;
+    blocks = h->count ? (h->count + kIndexRestart - 1) / kIndexRestart : 0;
+    FileIndexHeader expect = {};
+    if (h->count <= total / 20 && h->pathBytes <= total)
+        expect.layout(h->count, blocks, h->pathBytes);
+    if (memcmp(h->magic, kIndexMagic, 8) != 0 || h->restartEvery != kIndexRestart ||
+        expect.fileBytes != total || h->offPaths != expect.offPaths ||
+        h->offSize != expect.offSize || h->offMtime != expect.offMtime ||
+        h->offRestarts != expect.offRestarts || h->offAttrs != expect.offAttrs) {
+        close();
+        return false;
+    }
+    size     = (const ULONGLONG*)(base + h->offSize);
+    mtime    = (const ULONGLONG*)(base + h->offMtime);
+    restarts = (const ULONGLONG*)(base + h->offRestarts);
+    attrs    = (const DWORD*)(base + h->offAttrs);
+    paths    = base + h->offPaths;
+    return true;
+}
+
+void FileIndexView::close() {
+    if (base) UnmapViewOfFile(base);
+    if (hMap) CloseHandle(hMap);
+    base = nullptr; hMap = NULL; h = nullptr;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+
+// --- ИНДЕКС СПИСКА ФАЙЛОВ (file_list.idx) ---
+//
+// -list кроме file_list.txt пишет колоночный индекс всего, что обход и так узнаёт
+// из WIN32_FIND_DATAW. Индекс рассчитан на MapViewOfFile: читатель ничего не
+// разбирает, колонки — массивы прямо в отображении.
+//
+// Формат: FileIndexHeader | size u64[N] | mtime u64[N] | restarts u64[B] | attrs u32[N] | пути
+//
+// Пути — относительные, UTF-8, в порядке DFS, front coding: varint длины общего
+// префикса с предыдущим путём, varint длины остатка, остаток. Каждый
+// kIndexRestart-й путь записан целиком, restarts[] — смещения таких путей:
+// декодировать можно с начала любого блока. Соседи в DFS делят директорию,
+// поэтому таблица путей в разы меньше file_list.txt.
+
+static const unsigned kIndexRestart = 64;
+
+struct FileIndexHeader {
+    char      magic[8];
+    ULONGLONG count;
+    ULONGLONG restartEvery;
+    ULONGLONG offSize, offMtime, offRestarts, offAttrs, offPaths;
+    ULONGLONG pathBytes;
+    ULONGLONG fileBytes;      // полный размер: усечённый индекс не принимается
+
+    // Раскладка однозначно следует из count и размера таблиц
+    void layout(ULONGLONG n, ULONGLONG blocks, ULONGLONG paths) {
+        count        = n;
+        restartEvery = kIndexRestart;
+        offSize      = sizeof(FileIndexHeader);
+        offMtime     = offSize + n * 8;
+        offRestarts  = offMtime + n * 8;
+        offAttrs     = offRestarts + blocks * 8;
+        offPaths     = offAttrs + n * 4;
+        pathBytes    = paths;
+        fileBytes    = offPaths + paths;
+    }
+};
+
+// nullptr — varint не помещается до end (битый индекс)
+__forceinline const char* GetVarint(const char* p, const char* end, ULONGLONG& v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        const unsigned char b = (unsigned char)*p++;
+        v |= (ULONGLONG)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return p;
+    }
+    return nullptr;
+}
+
+// Колонки копятся во время обхода, файл пишется целиком в конце
+struct FileIndexBuilder {
+    std::vector<ULONGLONG> size, mtime, restarts;
+    std::vector<DWORD>     attrs;
+    std::string            paths;
+    std::string            prev;
+
+    // rel — путь от корня в UTF-8; mtime — FILETIME как u64
+    void add(const char* rel, size_t len, ULONGLONG fileSize, ULONGLONG fileMtime, DWORD fileAttrs);
+
+    // false — файл не открылся или не дописан; недописанный удаляется
+    bool save(const wchar_t* path) const;
+
+    // Запись в path.tmp и замена path. Не вышло — старый индекс тоже удаляется:
+    // он описывает прошлый список, и -query не должен по нему отвечать
+    void replace(const std::wstring& path) const;
+};
+
+// Индекс, отображённый в память только для чтения
+struct FileIndexView {
+    HANDLE                 hMap     = NULL;
+    const char*            base     = nullptr;
+    const FileIndexHeader* h        = nullptr;
+    const ULONGLONG*       size     = nullptr;
+    const ULONGLONG*       mtime    = nullptr;
+    const ULONGLONG*       restarts = nullptr;
+    const DWORD*           attrs    = nullptr;
+    const char*            paths    = nullptr;
+    ULONGLONG              blocks   = 0;
+
+    ~FileIndexView() { close(); }
+
+    // false — файла нет, он усечён или раскладка не сходится с заголовком
+    bool open(const wchar_t* path);
+    void close();
+
+    // Пути блока b по порядку: fn(номер записи, путь). false — индекс битый
+    template<typename F>
+    bool forBlock(ULONGLONG b, std::string& cur, F&& fn) const {
+        const ULONGLONG from = restarts[b], to = b + 1 < blocks ? restarts[b + 1] : h->pathBytes;
+        if (from > to || to > h->pathBytes) return false;
+        const char* p   = paths + from;
+        const char* end = paths + to;
+        const ULONGLONG last = min(h->count, (b + 1) * kIndexRestart);
+        for (ULONGLONG i = b * kIndexRestart; i < last; ++i) {
+            ULONGLONG shared, len;
+            if (!(p = GetVarint(p, end, shared)) || !(p = GetVarint(p, end, len))) return false;
+            if (shared > cur.size() || len > (ULONGLONG)(end - p)) return false;
+            cur.resize((size_t)shared);
+            cur.append(p, (size_t)len);
+            p += len;
+            fn(i, cur);
+        }
+        return true;
+    }
+};
@@ -0,0 +1,106 @@
+#pragma once
+#include "Platform.h"
+#include <cstring>
+#include <immintrin.h>   // AVX2
+
+// --- БЫСТРЫЙ 64-БИТНЫЙ ХЭШ КОНТЕНТА (некриптографический) ---
+// Схема xxh3: 8 lane-ов по 64 бита, на полосу в 64 байта — d ^ key, произведение
+// младшей и старшей половин (32×32→64, mul_epu32) и d в соседний lane; раз в 1 КБ
+// lane-ы перемешиваются. AVX2 — полоса за 2 вектора, SSE2 — за 4; результат
+// одинаковый, 128-битного умножения нет — работает и в Win32 сборке.
+// Хвост меньше полосы и финальное смешивание — раунды xxh64.
+__forceinline ULONGLONG HashRound(ULONGLONG acc, ULONGLONG v) {
+    acc += v * 0xC2B2AE3D27D4EB4Full;
+    acc  = (acc << 31) | (acc >> 33);
+    return acc * 0x9E3779B185EBCA87ull;
+}
+
+alignas(32) static const ULONGLONG kHashKey[8] = {
+    0xBE4BA423396CFEB8ull, 0x1CAD21F72C81017Cull, 0xDB979083E96DD4DEull, 0x1F67B3B7A4A44072ull,
+    0x78E5C0CC4EE679CBull, 0x2172FFCC7DD05A82ull, 0x8E2443F7744608B8ull, 0x4C263A81E69035E0ull
+};
+alignas(32) static const ULONGLONG kHashScramble[8] = {
+    0xCB00C391BB52283Cull, 0xA32E531B8B65D088ull, 0x4EF90DA297486471ull, 0xD8ACDEA946EF1938ull,
+    0x3F349CE33F76FAA8ull, 0x1D4F0BC7C7BBDCF9ull, 0x3159B4CD4BE0518Aull, 0x647378D9C97E9FC8ull
+};
+static const unsigned kHashPrime32 = 0x9E3779B1u;
+
+// Без классификации — HashBytes
+struct NoTextScan {
+    __forceinline void feed64(const char*) {}
+    __forceinline void finish(const char*, size_t) {}
+};
+
+// Scan — попутный разбор тех же полос (TextScanner), NoTextScan — только хэш.
+template<typename Scan>
+ULONGLONG HashScan(const char* data, size_t len, Scan& scan) {
+    const char* p   = data;
+    const char* end = data + len;
+    alignas(32) ULONGLONG acc[8] = {
+        0x00000000C2B2AE3Dull, 0x9E3779B185EBCA87ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull,
+        0x85EBCA77C2B2AE63ull, 0x0000000085EBCA77ull, 0x27D4EB2F165667C5ull, 0x000000009E3779B1ull
+    };
+
+#if defined(__AVX2__)
+    __m256i a0 = _mm256_load_si256((const __m256i*)acc), a1 = _mm256_load_si256((const __m256i*)acc + 1);
+    const __m256i k0 = _mm256_load_si256((const __m256i*)kHashKey), k1 = _mm256_load_si256((const __m256i*)kHashKey + 1);
+    auto stripe = [](__m256i a, __m256i d, __m256i k) {
+        const __m256i dk = _mm256_xor_si256(d, k);
+        const __m256i m  = _mm256_mul_epu32(dk, _mm256_srli_epi64(dk, 32));
+        return _mm256_add_epi64(_mm256_add_epi64(a, m), _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+    };
+    auto scramble = [](__m256i a, __m256i s) {
+        a = _mm256_xor_si256(_mm256_xor_si256(a, _mm256_srli_epi64(a, 47)), s);
+        const __m256i pr = _mm256_set1_epi32((int)kHashPrime32);
+        return _mm256_add_epi64(_mm256_mul_epu32(a, pr), _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), pr), 32));
+    };
+    for (int n = 1; p + 64 <= end; p += 64, ++n) {
+        scan.feed64(p);
+        a0 = stripe(a0, _mm256_loadu_si256((const __m256i*)p),        k0);
+        a1 = stripe(a1, _mm256_loadu_si256((const __m256i*)(p + 32)), k1);
+        if ((n & 15) == 0) {
+            a0 = scramble(a0, _mm256_load_si256((const __m256i*)kHashScramble));
+            a1 = scramble(a1, _mm256_load_si256((const __m256i*)kHashScramble + 1));
+        }
+    }
+    _mm256_store_si256((__m256i*)acc, a0);
+    _mm256_store_si256((__m256i*)acc + 1, a1);
+#else
+    __m128i a[4];
+    for (int i = 0; i < 4; ++i) a[i] = _mm_load_si128((const __m128i*)acc + i);
+    const __m128i pr = _mm_set1_epi32((int)kHashPrime32);
+    for (int n = 1; p + 64 <= end; p += 64, ++n) {
+        scan.feed64(p);
+        for (int i = 0; i < 4; ++i) {
+            const __m128i d  = _mm_loadu_si128((const __m128i*)p + i);
+            const __m128i dk = _mm_xor_si128(d, _mm_load_si128((const __m128i*)kHashKey + i));
+            const __m128i m  = _mm_mul_epu32(dk, _mm_srli_epi64(dk, 32));
+            a[i] = _mm_add_epi64(_mm_add_epi64(a[i], m), _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+        }
+        if ((n & 15) == 0) {
+            for (int i = 0; i < 4; ++i) {
+                __m128i x = _mm_xor_si128(_mm_xor_si128(a[i], _mm_srli_epi64(a[i], 47)),
+                                          _mm_load_si128((const __m128i*)kHashScramble + i));
+                a[i] = _mm_add_epi64(_mm_mul_epu32(x, pr), _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32), pr), 32));
+            }
+        }
+    }
+    for (int i = 0; i < 4; ++i) _mm_store_si128((__m128i*)acc + i, a[i]);
+#endif
+    scan.finish(p, (size_t)(end - p));
+
+    ULONGLONG h = (ULONGLONG)len * 0x9E3779B185EBCA87ull;
+    for (int i = 0; i < 8; ++i) h = HashRound(h, acc[i]);
+    for (; p + 8 <= end; p += 8) { ULONGLONG v; memcpy(&v, p, 8); h = HashRound(h, v); }
+    for (; p < end; ++p) h = HashRound(h, (unsigned char)*p);
+
+    h ^= h >> 33; h *= 0xC2B2AE3D27D4EB4Full;
+    h ^= h >> 29; h *= 0x165667B19E3779F9ull;
+    h ^= h >> 32;
+    return h;
+}
+
+inline ULONGLONG HashBytes(const char* data, size_t len) {
+    NoTextScan none;
+    return HashScan(data, len, none);
+}
@@ -10,522 +10,1502 @@
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <memory>
+#include <unordered_map>
+#include <map>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <tuple>
 #include <intrin.h>      // SSE2
 #include <immintrin.h>   // AVX2
-#include <winioctl.h>    // IOCTL_STORAGE_QUERY_PROPERTY
+#include <psapi.h>       // GetProcessMemoryInfo (-bench)
+#include "Common.h"
+#include "ContentFilters.h"
+#include "Trace.h"
+#include "Engine.h"
+#include "Hash.h"
+#include "OutBuf.h"
+#include "Lz4.h"
+#include "Png.h"
+#include "Channel.h"
+#include "FileIndex.h"
+#include "Manifest.h"
+#include "Ignore.h"
+#include "Text.h"
+#include "Walker.h"
+#include "SelfTest.h"
 #pragma comment(lib, "comctl32.lib")
 #pragma comment(lib, "gdi32.lib")
+#pragma comment(lib, "psapi.lib")
 #pragma comment(linker,"\"/manifestdependency:type='win32' name='Microsoft.Windows.Common-Controls' version='6.0.0.0' processorArchitecture='*' publicKeyToken='6595b64144ccf1df' language='*'\"")
 #pragma comment(linker, "/SUBSYSTEM:windows /ENTRY:mainCRTStartup")
 
 // --- ГЛОБАЛЬНЫЕ ПЕРЕМЕННЫЕ ---
-std::atomic<bool> g_cancel(false);
 HWND g_hProgressWnd = NULL;
 HWND g_hProgressBar = NULL;
-std::mutex g_statusMutex;
-std::wstring g_currentStatus = L"Инициализация...";
 
 // --- ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ ---
-static bool FileExists(const std::wstring& path) {
-    DWORD a = GetFileAttributesW(path.c_str());
-    return a != INVALID_FILE_ATTRIBUTES && !(a & FILE_ATTRIBUTE_DIRECTORY);
-}
-
-static bool IsExcludedExtension(const wchar_t* filename) {
-    const wchar_t* dot = wcsrchr(filename, L'.');
-    if (!dot) return false;
-    static const wchar_t* const kExts[] = {
-        L".bin",  L".bmp",   L".db",    L".dll",  L".exe",
-        L".filters", L".gif",L".ipch",  L".iso",  L".jpg",
-        L".jpeg", L".lib",   L".ncb",   L".obj",  L".opensdf",
-        L".pdb",  L".png",   L".sdf",   L".sqlite",L".sln",
-        L".suo",  L".tlog",  L".user",  L".vcxproj"
+// Консоль для консольных режимов. Exe собран с /SUBSYSTEM:windows, своей консоли
+// у процесса нет: подключаемся к консоли родителя (cmd, PowerShell), а без неё при
+// allocate заводим свою. Унаследованные перенаправлением std-хэндлы (pipe, файл)
+// остаются как есть, пустые переоткрываются на консоль вместе с потоками CRT.
+// cmd не ждёт GUI-процесс и сам читает клавиатуру — для ввода: start /wait.
+static bool AttachConsoleIo(bool allocate) {
+    if (!AttachConsole(ATTACH_PARENT_PROCESS) && !(allocate && AllocConsole())) return false;
+    struct StdStream { DWORD id; const char* dev; const char* mode; FILE* crt; };
+    const StdStream streams[] = {
+        { STD_INPUT_HANDLE,  "CONIN$",  "r", stdin  },
+        { STD_OUTPUT_HANDLE, "CONOUT$", "w", stdout },
+        { STD_ERROR_HANDLE,  "CONOUT$", "w", stderr },
     };
-    for (auto e : kExts)
-        if (_wcsicmp(dot, e) == 0) return true;
-    return false;
+    for (const StdStream& st : streams) {
+        HANDLE h = GetStdHandle(st.id);
+        if (h && h != INVALID_HANDLE_VALUE && GetFileType(h) != FILE_TYPE_UNKNOWN) continue;
+        h = CreateFileA(st.dev, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+        if (h == INVALID_HANDLE_VALUE) continue;
+        SetStdHandle(st.id, h);
+        FILE* f = nullptr;
+        freopen_s(&f, st.dev, st.mode, st.crt);
+    }
+    return true;
 }
 
-// --- SIMD ПОИСК НУЛЕВОГО БАЙТА ---
-// SSE2 (гарантирован на x64) + AVX2 при наличии /arch:AVX2
-static bool HasNullByte(const char* data, size_t len) {
-    const char* p   = data;
-    const char* end = data + len;
+EngineContext* g_guiEngine = nullptr;   // прогон, которым управляет окно прогресса
 
-#if defined(__AVX2__)
-    const __m256i z256 = _mm256_setzero_si256();
-    for (; p + 32 <= end; p += 32) {
-        __m256i v = _mm256_loadu_si256((const __m256i*)p);
-        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, z256))) return true;
-    }
-#endif
-    const __m128i z128 = _mm_setzero_si128();
-    for (; p + 16 <= end; p += 16) {
-        __m128i v = _mm_loadu_si128((const __m128i*)p);
-        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, z128))) return true;
-    }
-    for (; p < end; ++p)
-        if (!*p) return true;
-    return false;
-}
-
-// --- ЗАМЕНА std::regex: РУЧНОЙ КОНЕЧНЫЙ АВТОМАТ ---
-// Ищет паттерн:  =\s*\{[allowed_chars]{50,}\};
-// allowed_chars: пробел, таб, \r, \n, 0-9, a-f, A-F, x, X, запятая
-// В 10-50 раз быстрее std::regex; работает прямо по const char* без копий.
-// Возвращает true если была замена; result содержит очищенный текст.
-static bool CleanHexArrays(const char* src, size_t len, std::string& result) {
-    if (len > 500000) return false;
-
-    // Быстрый pre-check: есть ли вообще "= {" в файле?
-    bool found = false;
-    for (size_t i = 0; i + 2 < len; ++i) {
-        if (src[i] == '=' && src[i+1] == ' ' && src[i+2] == '{') { found = true; break; }
-        if (src[i] == '=' && src[i+1] == '{') { found = true; break; }
-    }
-    if (!found) return false;
-
-    result.clear();
-    result.reserve(len);
-
-    const char* cur = src;
-    const char* end = src + len;
-
-    while (cur < end) {
-        // Ищем '=' через memchr — vectorized в CRT
-        const char* eq = (const char*)memchr(cur, '=', (size_t)(end - cur));
-        if (!eq) { result.append(cur, end); break; }
-
-        result.append(cur, (size_t)(eq - cur));
-        cur = eq;
-
-        // Пропускаем пробелы после '='
-        const char* s = eq + 1;
-        while (s < end && (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')) ++s;
-
-        if (s >= end || *s != '{') { result += *cur++; continue; }
-        ++s; // пропускаем '{'
-
-        // Сканируем тело: только разрешённые символы
-        const char* bodyStart = s;
-        int  count = 0;
-        bool valid = true;
-        while (s < end) {
-            unsigned char c = (unsigned char)*s;
-            if (c == '}') break;
-            if ((c >= '0' && c <= '9') ||
-                (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F') ||
-                c == 'x' || c == 'X'  || c == ',' ||
-                c == ' ' || c == '\t' || c == '\r' || c == '\n') {
-                ++count; ++s;
-            } else { valid = false; break; }
-        }
-
-        if (!valid || s >= end || *s != '}') { result += *cur++; continue; }
-        ++s; // '}'
-        if (s >= end || *s != ';')           { result += *cur++; continue; }
-        ++s; // ';'
-
-        if (count >= 50) {
-            result += "= { /* HEX DATA HIDDEN */ };";
-            cur = s;
-        } else {
-            result += *cur++;
-        }
-    }
+// --- ЗАПРОСЫ К ИНДЕКСУ: "-query" ---
+// "-query <папка> [фильтры]": size/mtime/attrs проверяются по колонкам, пути
+// декодируются только в блоках, где после них остались кандидаты.
 
-    return true; // была хотя бы одна попытка замены
-}
+enum { kQuerySortNone, kQuerySortSize, kQuerySortMtime };
+
+struct IndexQuery {
+    ULONGLONG    minSize  = 0, maxSize = ~0ull;
+    ULONGLONG    since    = 0, before  = ~0ull;   // mtime, FILETIME UTC
+    DWORD        attrsAll = 0;                    // все эти атрибуты должны быть
+    std::string  under;                           // префикс пути (UTF-8, '\\')
+    std::wstring name;                            // glob по имени файла, в нижнем регистре
+    std::string  nameSuffix;                      // name "*.ext" без других спецсимволов
+    int          sort = kQuerySortNone;           // по убыванию
+    size_t       top  = 0;                        // 0 — без ограничения
+};
 
-// --- БУФЕРИЗОВАННЫЙ ВЫВОД ЧЕРЕЗ WriteFile (без виртуальных вызовов ofstream) ---
-struct OutBuf {
-    HANDLE h   = INVALID_HANDLE_VALUE;
-    char*  buf = nullptr;
-    DWORD  cap = 0;
-    DWORD  pos = 0;
+// Число с необязательным K/M/G
+static bool ParseQuerySize(const wchar_t* s, ULONGLONG& v) {
+    wchar_t* e = nullptr;
+    v = wcstoull(s, &e, 10);
+    if (e == s) return false;
+    switch (*e) {
+    case L'k': case L'K': v <<= 10; ++e; break;
+    case L'm': case L'M': v <<= 20; ++e; break;
+    case L'g': case L'G': v <<= 30; ++e; break;
+    }
+    return *e == 0;
+}
 
-    bool open(const wchar_t* path, DWORD bufSz) {
-        buf = new char[bufSz];
-        cap = bufSz;
-        h = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
-            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
-        if (h == INVALID_HANDLE_VALUE) { delete[] buf; buf = nullptr; return false; }
+// "YYYY-MM-DD[THH:MM]" — местное время; "<N>d" / "<N>h" — столько назад от текущего
+static bool ParseQueryTime(const wchar_t* s, ULONGLONG& ft) {
+    wchar_t* e = nullptr;
+    const ULONGLONG n = wcstoull(s, &e, 10);
+    if (e != s && (e[0] == L'd' || e[0] == L'h') && !e[1]) {
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+        const ULONGLONG unit = (e[0] == L'd' ? 24ull : 1ull) * 3600ull * 10000000ull;
+        const ULONGLONG back = n * unit;
+        ft = FileTimeToU64(now) > back ? FileTimeToU64(now) - back : 0;
         return true;
     }
+    SYSTEMTIME st = {};
+    int y = 0, mo = 0, d = 0, hh = 0, mm = 0;
+    const int got = swscanf(s, L"%d-%d-%dT%d:%d", &y, &mo, &d, &hh, &mm);
+    if (got != 3 && got != 5) return false;
+    st.wYear = (WORD)y; st.wMonth = (WORD)mo; st.wDay = (WORD)d; st.wHour = (WORD)hh; st.wMinute = (WORD)mm;
+    FILETIME local, utc;
+    if (!SystemTimeToFileTime(&st, &local) || !LocalFileTimeToFileTime(&local, &utc)) return false;
+    ft = FileTimeToU64(utc);
+    return true;
+}
 
-    // Большие блоки (контент файлов) идут напрямую, минуя внутренний буфер
-    __forceinline void write(const char* data, DWORD len) {
-        if (len >= cap) { flush(); DWORD w; WriteFile(h, data, len, &w, NULL); return; }
-        while (len > 0) {
-            DWORD n = min(len, cap - pos);
-            memcpy(buf + pos, data, n);
-            pos += n; data += n; len -= n;
-            if (pos == cap) flush();
+// Нераспознанный фильтр → false и его текст в bad
+static bool ParseQueryArgs(LPWSTR* argv, int argc, IndexQuery& q, std::wstring& bad) {
+    for (int i = 0; i < argc; ++i) {
+        const wchar_t* eq = wcschr(argv[i], L'=');
+        bad = argv[i];
+        if (!eq) return false;
+        const std::wstring key(argv[i], (size_t)(eq - argv[i]));
+        const wchar_t*     v = eq + 1;
+        bool ok = true;
+        if      (key == L"minsize") ok = ParseQuerySize(v, q.minSize);
+        else if (key == L"maxsize") ok = ParseQuerySize(v, q.maxSize);
+        else if (key == L"since")   ok = ParseQueryTime(v, q.since);
+        else if (key == L"before")  ok = ParseQueryTime(v, q.before);
+        else if (key == L"top")     q.top = (size_t)wcstoull(v, nullptr, 10);
+        else if (key == L"sort") {
+            if      (!wcscmp(v, L"size"))  q.sort = kQuerySortSize;
+            else if (!wcscmp(v, L"mtime")) q.sort = kQuerySortMtime;
+            else ok = false;
+        } else if (key == L"attr") {
+            for (const wchar_t* a = v; *a && ok; ++a) {
+                switch (FoldChar(*a)) {
+                case L'r': q.attrsAll |= FILE_ATTRIBUTE_READONLY; break;
+                case L'h': q.attrsAll |= FILE_ATTRIBUTE_HIDDEN;   break;
+                case L's': q.attrsAll |= FILE_ATTRIBUTE_SYSTEM;   break;
+                case L'a': q.attrsAll |= FILE_ATTRIBUTE_ARCHIVE;  break;
+                default:   ok = false;
+                }
+            }
+        } else if (key == L"under") {
+            std::wstring w(v);
+            for (auto& c : w) if (c == L'/') c = L'\\';
+            if (!w.empty() && w.back() != L'\\') w += L'\\';
+            const int n = WideCharToMultiByte(CP_UTF8, 0, w.c_str(), (int)w.size(), NULL, 0, NULL, NULL);
+            q.under.resize((size_t)max(n, 0));
+            if (n > 0) WideCharToMultiByte(CP_UTF8, 0, w.c_str(), (int)w.size(), &q.under[0], n, NULL, NULL);
+        } else if (key == L"name") {
+            q.name.clear();
+            for (const wchar_t* c = v; *c; ++c) q.name += FoldChar(*c);
+            // "*.cpp" — сравнение хвоста UTF-8 без перекодировки каждого имени
+            if (q.name.size() > 1 && q.name[0] == L'*' &&
+                q.name.find_first_of(L"*?[\\", 1) == std::wstring::npos) {
+                for (size_t k = 1; k < q.name.size(); ++k) {
+                    if (q.name[k] >= 128) { q.nameSuffix.clear(); break; }
+                    q.nameSuffix += (char)q.name[k];
+                }
+            }
+        } else {
+            ok = false;
         }
+        if (!ok) return false;
     }
+    bad.clear();
+    return true;
+}
 
-    void flush() { if (pos) { DWORD w; WriteFile(h, buf, pos, &w, NULL); pos = 0; } }
-
-    void close() {
-        flush();
-        if (h != INVALID_HANDLE_VALUE) { CloseHandle(h); h = INVALID_HANDLE_VALUE; }
-        delete[] buf; buf = nullptr;
+static bool QueryMatchPath(const IndexQuery& q, const std::string& p, std::wstring& wname) {
+    if (!q.under.empty() &&
+        (p.size() <= q.under.size() || _strnicmp(p.data(), q.under.data(), q.under.size()) != 0))
+        return false;
+    if (q.name.empty()) return true;
+
+    const size_t slash = p.rfind('\\');
+    const size_t off   = slash == std::string::npos ? 0 : slash + 1;
+    if (!q.nameSuffix.empty()) {
+        const size_t n = q.nameSuffix.size();
+        return p.size() - off >= n && _strnicmp(p.data() + p.size() - n, q.nameSuffix.data(), n) == 0;
     }
-};
-
-// --- СТЕК ДИРЕКТОРИЙ (один pathBuf, без std::wstring) ---
-struct DirLevel {
-    HANDLE hFind   = INVALID_HANDLE_VALUE;
-    DWORD  pathEnd = 0;
-    bool   first   = true;
-};
+    const int wl = MultiByteToWideChar(CP_UTF8, 0, p.data() + off, (int)(p.size() - off), NULL, 0);
+    if (wl <= 0) return false;
+    wname.resize((size_t)wl);
+    MultiByteToWideChar(CP_UTF8, 0, p.data() + off, (int)(p.size() - off), &wname[0], wl);
+    for (auto& c : wname) c = FoldChar(c);
+    return GlobMatch(q.name.data(), q.name.data() + q.name.size(), wname.data(), wname.data() + wname.size());
+}
 
-// --- КАНАЛ: PRODUCER-CONSUMER С BOUNDED QUEUE ---
-template<typename T>
-struct Chan {
-    std::deque<T>           q;
-    std::mutex              mtx;
-    std::condition_variable cv_pop, cv_push;
-    size_t                  cap;
-    bool                    closed = false;
-
-    explicit Chan(size_t c) : cap(c) {}
-
-    // Возвращает false если канал закрыт
-    bool send(T item) {
-        std::unique_lock<std::mutex> lk(mtx);
-        cv_push.wait(lk, [&]{ return q.size() < cap || closed; });
-        if (closed) return false;
-        q.push_back(std::move(item));
-        cv_pop.notify_one();
-        return true;
+// Номера подходящих записей: в порядке DFS либо по убыванию q.sort, не больше q.top
+static bool RunIndexQuery(const FileIndexView& v, const IndexQuery& q, std::vector<ULONGLONG>& hits) {
+    hits.clear();
+    const ULONGLONG n      = v.h->count;
+    const bool      byPath = !q.under.empty() || !q.name.empty();
+    std::string     cur;
+    std::wstring    wname;
+    ULONGLONG       cand[kIndexRestart];
+
+    for (ULONGLONG b = 0; b < v.blocks; ++b) {
+        const ULONGLONG first = b * kIndexRestart, last = min(n, first + kIndexRestart);
+        size_t nc = 0;
+        for (ULONGLONG i = first; i < last; ++i) {
+            const bool pass = v.size[i] >= q.minSize && v.size[i] <= q.maxSize &&
+                              v.mtime[i] >= q.since && v.mtime[i] < q.before &&
+                              (v.attrs[i] & q.attrsAll) == q.attrsAll;
+            cand[nc] = i;
+            nc += pass;
+        }
+        if (!nc) continue;
+        if (!byPath) {
+            hits.insert(hits.end(), cand, cand + nc);
+        } else {
+            size_t k = 0;
+            const bool ok = v.forBlock(b, cur, [&](ULONGLONG i, const std::string& p) {
+                if (k < nc && cand[k] == i) {
+                    ++k;
+                    if (QueryMatchPath(q, p, wname)) hits.push_back(i);
+                }
+            });
+            if (!ok) return false;
+        }
+        if (q.top && q.sort == kQuerySortNone && hits.size() >= q.top) break;
     }
 
-    // Возвращает false когда закрыт И пуст
-    bool recv(T& item) {
-        std::unique_lock<std::mutex> lk(mtx);
-        cv_pop.wait(lk, [&]{ return !q.empty() || closed; });
-        if (q.empty()) return false;
-        item = std::move(q.front());
-        q.pop_front();
-        cv_push.notify_one();
-        return true;
+    if (q.sort != kQuerySortNone) {
+        const ULONGLONG* key = q.sort == kQuerySortSize ? v.size : v.mtime;
+        auto desc = [key](ULONGLONG a, ULONGLONG b) { return key[a] != key[b] ? key[a] > key[b] : a < b; };
+        if (q.top && q.top < hits.size()) std::partial_sort(hits.begin(), hits.begin() + q.top, hits.end(), desc);
+        else                              std::sort(hits.begin(), hits.end(), desc);
     }
+    if (q.top && hits.size() > q.top) hits.resize(q.top);
+    return true;
+}
 
-    void close() {
-        std::lock_guard<std::mutex> lk(mtx);
-        closed = true;
-        cv_pop.notify_all();
-        cv_push.notify_all();
+// Пути найденных записей: блоки декодируются по порядку один раз
+static bool IndexPaths(const FileIndexView& v, const std::vector<ULONGLONG>& hits, std::vector<std::string>& out) {
+    std::vector<size_t> order(hits.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return hits[a] < hits[b]; });
+
+    out.assign(hits.size(), std::string());
+    std::string cur;
+    for (size_t k = 0; k < order.size();) {
+        const ULONGLONG b = hits[order[k]] / kIndexRestart;
+        const bool ok = v.forBlock(b, cur, [&](ULONGLONG i, const std::string& p) {
+            while (k < order.size() && hits[order[k]] == i) out[order[k++]] = p;
+        });
+        if (!ok) return false;
     }
-};
+    return true;
+}
 
-// --- ЯДРО СКАНИРОВАНИЯ file_list.txt (не нуждается в параллелизме — I/O bound) ---
-void GenerateFileList(const std::wstring& folderPath) {
+// "-query <папка> [фильтры]" → строки "размер<TAB>mtime<TAB>путь" в stdout (UTF-8)
+//   name=*.cpp  under=src\core  minsize=1M  maxsize=64K  since=2024-05-01  since=7d
+//   before=2024-06-01T12:00  attr=HR  sort=size|mtime  top=20
+// Код возврата: 0 — успех, 1 — неизвестный фильтр, 2 — индекса нет или он повреждён
+int QueryFileIndex(const std::wstring& folderPath, LPWSTR* argv, int argc) {
     std::wstring baseStr = folderPath;
     if (!baseStr.empty() && baseStr.back() != L'\\') baseStr += L'\\';
-    const DWORD baseLen = (DWORD)baseStr.length();
+    SetConsoleOutputCP(CP_UTF8);
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE), hErr = GetStdHandle(STD_ERROR_HANDLE);
+    auto say = [&](HANDLE hh, const std::string& s) { DWORD w; WriteFile(hh, s.data(), (DWORD)s.size(), &w, NULL); };
+
+    IndexQuery   q;
+    std::wstring bad;
+    if (!ParseQueryArgs(argv, argc, q, bad)) {
+        const int n = WideCharToMultiByte(CP_UTF8, 0, bad.c_str(), (int)bad.size(), NULL, 0, NULL, NULL);
+        std::string b((size_t)max(n, 0), '\0');
+        if (n > 0) WideCharToMultiByte(CP_UTF8, 0, bad.c_str(), (int)bad.size(), &b[0], n, NULL, NULL);
+        say(hErr, "Неизвестный фильтр: " + b + "\n");
+        return 1;
+    }
 
-    OutBuf out;
-    if (!out.open((baseStr + L"file_list.txt").c_str(), 1 * 1024 * 1024)) {
-        PostMessage(g_hProgressWnd, WM_CLOSE, 0, 0);
-        return;
+    const LONGLONG t0 = QpcNow();
+    FileIndexView  v;
+    if (!v.open((baseStr + L"file_list.idx").c_str())) {
+        say(hErr, "Нет file_list.idx (или он повреждён) — сначала -list\n");
+        return 2;
     }
+    std::vector<ULONGLONG>   hits;
+    std::vector<std::string> paths;
+    if (!RunIndexQuery(v, q, hits) || !IndexPaths(v, hits, paths)) {
+        say(hErr, "file_list.idx повреждён — пересоздайте через -list\n");
+        return 2;
+    }
+    const double ms = QpcToMs(QpcNow() - t0);
+
+    std::string out;
+    char line[64];
+    for (size_t k = 0; k < hits.size(); ++k) {
+        const ULONGLONG i = hits[k];
+        FILETIME ft = { (DWORD)v.mtime[i], (DWORD)(v.mtime[i] >> 32) }, local;
+        SYSTEMTIME st = {};
+        FileTimeToLocalFileTime(&ft, &local);
+        FileTimeToSystemTime(&local, &st);
+        snprintf(line, sizeof(line), "%llu\t%04u-%02u-%02u %02u:%02u:%02u\t", (unsigned long long)v.size[i],
+            st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+        out += line;
+        out += paths[k];
+        out += '\n';
+        if (out.size() >= 1024 * 1024) { say(hOut, out); out.clear(); }
+    }
+    say(hOut, out);
 
-    static wchar_t pathBuf[32768];
-    wmemcpy(pathBuf, baseStr.c_str(), baseLen + 1);
-    DWORD pathLen = baseLen;
+    snprintf(line, sizeof(line), "%llu / %llu, %.2f ms\n",
+        (unsigned long long)hits.size(), (unsigned long long)v.h->count, ms);
+    say(hErr, line);
+    return 0;
+}
 
-    static char utf8Buf[MAX_PATH * 4 + 2];
-    WIN32_FIND_DATAW fd = {};
+// --- РЕЖИМ НАБЛЮДЕНИЯ: "-watch <папка>" ---
+//
+// Один полный проход, дальше all.txt и file_list.txt (+ file_list.idx) держатся
+// актуальными по уведомлениям ReadDirectoryChangesW. В памяти — дерево файлов
+// с метаданными и готовыми очищенными блоками дампа; событие перечитывает только
+// затронутые файлы. Пачка событий копится до паузы kWatchQuietMs, но не дольше
+// kWatchMaxDelayMs. Запись выходных файлов — сериализация дерева без обхода
+// и чтения (кроме файлов крупнее kMapWholeLimit: они идут потоком, как в -dump).
+// Переполнение буфера уведомлений или правка .gitignore/.ignore → повторный
+// обход всего дерева, но перечитываются только файлы со сменившимися size/mtime.
+// Консоль (своя, если родитель без консоли): Enter — переписать выходные файлы сейчас,
+// "q" или Ctrl+C — выход. Без консоли: "-watch <папка> stop" из другого процесса —
+// именованное событие на папку (WatchStopEventName); оно же не даёт запустить второе
+// наблюдение за той же папкой.
+
+static const DWORD kWatchQuietMs    = 200;
+static const DWORD kWatchMaxDelayMs = 2000;
+static const DWORD kWatchBuffer     = 64 * 1024;   // больше по сети не отдаётся
+static const int   kWatchRetries    = 3;           // файл занят — повтор в следующих пачках
+
+enum { kWatchModified = 1, kWatchStructural = 2 };
+
+struct WatchEntry {
+    std::string rel;              // UTF-8, как в file_list.txt
+    ULONGLONG   size   = 0;
+    ULONGLONG   mtime  = 0;
+    DWORD       attrs  = 0;
+    bool        dump   = false;   // не исключён по расширению
+    bool        fresh  = false;   // block соответствует size/mtime
+    bool        stream = false;   // крупный текст: в block только заголовок
+    int         tries  = 0;
+    unsigned    seen   = 0;       // поколение обхода (удаление пропавших)
+    std::string block;            // заголовок + очищенный контент + "\n\n"; пусто — в дамп не идёт
+};
 
-    std::vector<DirLevel> stk;
-    stk.reserve(64);
-    stk.push_back({ INVALID_HANDLE_VALUE, baseLen, true });
+// Без учёта регистра, '\\' меньше любого символа: содержимое директории
+// идёт подряд сразу за её путём
+struct WatchPathLess {
+    bool operator()(const std::wstring& a, const std::wstring& b) const {
+        const size_t n = min(a.size(), b.size());
+        for (size_t i = 0; i < n; ++i) {
+            const wchar_t x = a[i] == L'\\' ? 0 : FoldChar(a[i]);
+            const wchar_t y = b[i] == L'\\' ? 0 : FoldChar(b[i]);
+            if (x != y) return x < y;
+        }
+        return a.size() < b.size();
+    }
+};
 
-    int counter = 0;
+typedef std::map<std::wstring, WatchEntry, WatchPathLess> WatchTree;
+typedef std::map<std::wstring, int, WatchPathLess>        WatchPending;
 
-    while (!stk.empty() && !g_cancel.load(std::memory_order_relaxed)) {
-        DirLevel& cur = stk.back();
+static bool WatchHasPrefix(const std::wstring& s, const std::wstring& pre) {
+    if (s.size() < pre.size()) return false;
+    for (size_t i = 0; i < pre.size(); ++i)
+        if (FoldChar(s[i]) != FoldChar(pre[i])) return false;
+    return true;
+}
 
-        if (cur.first) {
-            cur.first = false;
-            pathBuf[pathLen] = L'*'; pathBuf[pathLen + 1] = L'\0';
-            cur.hFind = FindFirstFileExW(pathBuf, FindExInfoBasic, &fd,
-                FindExSearchNameMatch, NULL,
-                FIND_FIRST_EX_LARGE_FETCH | FIND_FIRST_EX_CASE_SENSITIVE);
-            pathBuf[pathLen] = L'\0';
-            if (cur.hFind == INVALID_HANDLE_VALUE) { pathLen = cur.pathEnd; stk.pop_back(); continue; }
-        } else {
-            if (!FindNextFileW(cur.hFind, &fd)) {
-                FindClose(cur.hFind);
-                pathLen = cur.pathEnd;
-                stk.pop_back();
-                continue;
-            }
+// Читает файл и собирает его блок той же классификацией, что и воркер -dump.
+// false — файл не открылся (занят или удалён между событием и чтением)
+static bool BuildWatchBlock(const std::wstring& fullPath, unsigned filters, WatchEntry& e, std::string& text,
+                            std::wstring& wide) {
+    HANDLE hFile = CreateFileW(fullPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fsz;
+    if (!GetFileSizeEx(hFile, &fsz)) { CloseHandle(hFile); return false; }
+
+    std::string block;
+    bool        stream = false;
+    const int   relLen = (int)e.rel.size();
+    if (fsz.QuadPart == 0) {
+        CloseHandle(hFile);
+    } else if ((ULONGLONG)fsz.QuadPart > kMapWholeLimit) {
+        char  head[4096];
+        DWORD got = 0;
+        const BOOL ok = ReadFile(hFile, head, sizeof(head), &got, NULL);
+        CloseHandle(hFile);
+        if (!ok) return false;
+        size_t bom = 0;
+        if (DetectTextKind(head, got, bom) == kTextUtf8 && !IsBinaryText(ScanText(head, got), got)) {
+            AppendChunkHeader(block, e.rel.data(), relLen);
+            stream = true;
         }
-
-        if (++counter >= 500) {
-            counter = 0;
-            std::lock_guard<std::mutex> lk(g_statusMutex);
-            g_currentStatus = fd.cFileName;
+    } else {
+        const size_t sz   = (size_t)fsz.QuadPart;
+        HANDLE       hMap = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(hFile);
+        if (!hMap) return false;
+        const char* view = (const char*)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, sz);
+        if (!view) { CloseHandle(hMap); return false; }
+
+        size_t         bom     = 0;
+        const TextKind kind    = DetectTextKind(view, sz, bom);
+        const char*    body    = view + bom;
+        size_t         bodyLen = sz - bom;
+        bool           text8   = kind == kTextUtf8 && !HasNullByte(view, min(sz, (size_t)1024));
+        bool           recode  = kind != kTextUtf8;
+        if (text8) {
+            const TextScan ts = ScanText(view, sz);
+            text8  = !IsBinaryText(ts, sz);
+            recode = text8 && !ts.utf8 && LooksLikeAnsi(body, bodyLen);
         }
-
-        const wchar_t* name = fd.cFileName;
-
-        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-            if (name[0] == L'.' && (name[1] == L'\0' || (name[1] == L'.' && name[2] == L'\0'))) continue;
-            DWORD nl = (DWORD)wcslen(name);
-            wmemcpy(pathBuf + pathLen, name, nl);
-            pathBuf[pathLen + nl] = L'\\';
-            DirLevel sub{ INVALID_HANDLE_VALUE, pathLen, true };
-            pathLen += nl + 1;
-            pathBuf[pathLen] = L'\0';
-            stk.push_back(sub);
-        } else {
-            if (_wcsicmp(name, L"file_list.txt") == 0 || _wcsicmp(name, L"all.txt") == 0) continue;
-            DWORD nl = (DWORD)wcslen(name);
-            wmemcpy(pathBuf + pathLen, name, nl + 1);
-            int utf8Len = WideCharToMultiByte(CP_UTF8, 0,
-                pathBuf + baseLen, (int)(pathLen + nl - baseLen),
-                utf8Buf, (int)sizeof(utf8Buf) - 2, NULL, NULL);
-            if (utf8Len > 0) { utf8Buf[utf8Len] = '\n'; out.write(utf8Buf, (DWORD)utf8Len + 1); }
-            pathBuf[pathLen] = L'\0';
+        bool ok = text8 || recode;
+        if (ok && (filters & kXfMinified) && IsLockfileName(fullPath.c_str() + fullPath.rfind(L'\\') + 1)) {
+            body    = kLockfileStub;
+            bodyLen = sizeof(kLockfileStub) - 1;
+        } else if (recode) {
+            ok      = RecodeText(kind, body, bodyLen, text, wide);
+            body    = text.data();
+            bodyLen = text.size();
         }
+        if (ok) {
+            AppendChunkHeader(block, e.rel.data(), relLen);
+            CleanContent(filters, body, bodyLen, block);
+            block += "\n\n";
+        }
+        UnmapViewOfFile(view);
+        CloseHandle(hMap);
     }
-
-    for (auto& lv : stk) if (lv.hFind != INVALID_HANDLE_VALUE) FindClose(lv.hFind);
-    out.close();
-    if (g_cancel.load()) DeleteFileW((baseStr + L"file_list.txt").c_str());
-    PostMessage(g_hProgressWnd, WM_CLOSE, 0, 0);
+    e.block.swap(block);
+    e.stream = stream;
+    return true;
 }
 
-// --- ОПРЕДЕЛЕНИЕ ТИПА ДИСКА (SSD / HDD) ---
-// Использует IOCTL_STORAGE_QUERY_PROPERTY → IncursSeekPenalty.
-// SSD = нет штрафа за seek → можно много параллельных потоков.
-// HDD = есть штраф      → параллельность вредит (head thrashing).
-static bool IsPathOnSSD(const wchar_t* path) {
-    wchar_t volumePath[MAX_PATH] = {};
-    if (!GetVolumePathNameW(path, volumePath, MAX_PATH)) return true;
+struct Watcher {
+    EngineContext ctx;
+    std::wstring baseStr;   // с завершающим '\\'
+    bool         ssd     = true;
+    WatchTree    tree;
+    unsigned     gen     = 0;
+    size_t       touched = 0;   // записей добавлено/изменено/удалено с последней записи файлов
+    std::unordered_map<std::wstring, std::shared_ptr<const IgnoreScope>> scopes;   // nullptr — исключена
+
+    // rel от корня в виде, который видят игнор-правила: '/' и FoldChar-регистр
+    static std::wstring FoldRel(const std::wstring& rel) {
+        std::wstring f(rel.size(), L'\0');
+        for (size_t i = 0; i < rel.size(); ++i) f[i] = rel[i] == L'\\' ? L'/' : FoldChar(rel[i]);
+        return f;
+    }
 
-    // Из "C:\" делаем "\\.\C:" для DeviceIoControl
-    if (wcslen(volumePath) < 2 || volumePath[1] != L':') return true;
-    wchar_t devPath[] = { L'\\',L'\\',L'.',L'\\', volumePath[0], L':', L'\0' };
+    static std::wstring ParentOf(const std::wstring& rel) {
+        const size_t cut = rel.rfind(L'\\');
+        return cut == std::wstring::npos ? std::wstring() : rel.substr(0, cut);
+    }
 
-    HANDLE hDev = CreateFileW(devPath, 0, FILE_SHARE_READ | FILE_SHARE_WRITE,
-        NULL, OPEN_EXISTING, 0, NULL);
-    if (hDev == INVALID_HANDLE_VALUE) return true; // не определили → считаем SSD
+    bool ignored(const std::wstring& rel, bool isDir) {
+        std::shared_ptr<const IgnoreScope> sc = scopeFor(ParentOf(rel));
+        if (!sc) return true;
+        const std::wstring folded  = FoldRel(rel);
+        const size_t       nameOff = folded.rfind(L'/') + 1;   // npos + 1 == 0
+        return IsIgnored(sc.get(), folded.c_str() + nameOff, folded.size() - nameOff, folded, isDir);
+    }
 
-    STORAGE_PROPERTY_QUERY query = {};
-    query.PropertyId = StorageDeviceSeekPenaltyProperty;
-    query.QueryType  = PropertyStandardQuery;
+    // Правила внутри директории relDir ("" — корень), как их собрал бы DirWalker
+    std::shared_ptr<const IgnoreScope> scopeFor(const std::wstring& relDir) {
+        auto f = scopes.find(relDir);
+        if (f != scopes.end()) return f->second;
+        std::shared_ptr<const IgnoreScope> sc;
+        if (relDir.empty()) {
+            sc = DirIgnoreScope(baseStr, 0, LoadBaseIgnore(),
+                FileExists(baseStr + L".gitignore"), FileExists(baseStr + L".ignore"));
+        } else if (!ignored(relDir, true)) {
+            const std::wstring dirPath = baseStr + relDir + L'\\';
+            sc = DirIgnoreScope(dirPath, relDir.size() + 1, scopeFor(ParentOf(relDir)),
+                FileExists(dirPath + L".gitignore"), FileExists(dirPath + L".ignore"));
+        }
+        scopes[relDir] = sc;
+        return sc;
+    }
 
-    DEVICE_SEEK_PENALTY_DESCRIPTOR desc = {};
-    DWORD bytesReturned = 0;
-    bool isSSD = true;
+    // Запись из обхода или события; true — блок нужно (пере)собрать
+    bool put(const std::wstring& rel, const wchar_t* name, ULONGLONG size, ULONGLONG mtime, DWORD attrs) {
+        auto ins = tree.try_emplace(rel);
+        WatchEntry& e = ins.first->second;
+        e.seen = gen;
+        if (ins.second) {
+            const int n = WideCharToMultiByte(CP_UTF8, 0, rel.c_str(), (int)rel.size(), NULL, 0, NULL, NULL);
+            if (n <= 0) { tree.erase(ins.first); return false; }
+            e.rel.resize((size_t)n);
+            WideCharToMultiByte(CP_UTF8, 0, rel.c_str(), (int)rel.size(), &e.rel[0], n, NULL, NULL);
+            e.dump = !IsExcludedExtension(name);
+        } else if (e.size == size && e.mtime == mtime) {
+            if (e.attrs != attrs) { e.attrs = attrs; ++touched; }
+            return !e.fresh;
+        }
+        e.size  = size;
+        e.mtime = mtime;
+        e.attrs = attrs;
+        e.fresh = !e.dump;
+        ++touched;
+        return !e.fresh;
+    }
 
-    if (DeviceIoControl(hDev, IOCTL_STORAGE_QUERY_PROPERTY,
-            &query, sizeof(query), &desc, sizeof(desc), &bytesReturned, NULL))
-        isSSD = !desc.IncursSeekPenalty;
+    // Удаляет путь и всё под ним (для файла — только его)
+    void erase(const std::wstring& rel) {
+        touched += tree.erase(rel);
+        const std::wstring pre = rel + L'\\';
+        auto first = tree.lower_bound(pre), last = first;
+        while (last != tree.end() && WatchHasPrefix(last->first, pre)) { ++last; ++touched; }
+        tree.erase(first, last);
+    }
 
-    CloseHandle(hDev);
-    return isSSD;
-}
+    // Обход поддерева relDir ("" — всё дерево) с удалением пропавших записей;
+    // rel файлов, которым нужен новый блок, — в jobs
+    void scan(const std::wstring& relDir, std::vector<std::wstring>& jobs) {
+        ++gen;
+        std::wstring rel;
+        auto onFile = [&](const DirNode& dir, const WalkItem& it) {
+            const wchar_t* name = dir.name(it);
+            if (IsOwnOutput(name)) return;
+            rel.assign(dir.path, baseStr.size(), std::wstring::npos).append(name, it.nameLen);
+            if (put(rel, name, it.size, FileTimeToU64(it.mtime), it.attrs)) jobs.push_back(rel);
+        };
+        DirWalker walker(WalkerThreads(ssd), ctx);
+        if (relDir.empty()) {
+            walker.run(baseStr, onFile);
+        } else if (std::shared_ptr<const IgnoreScope> sc = scopeFor(ParentOf(relDir))) {
+            if (!ignored(relDir, true)) walker.run(baseStr + relDir + L'\\', onFile, sc, baseStr.size());
+        }
 
-// --- ЯДРО ДАМПА all.txt: ПАРАЛЛЕЛЬНАЯ ОБРАБОТКА ---
-//
-// SSD: [Сканер] → pathChan(256) → [Worker × N]  → outChan(64) → [Output thread]
-// HDD: [Сканер] → pathChan(16)  → [Worker × 2]  → outChan(32) → [Output thread]
-//
-// На HDD больше 2 воркеров вызывают head-thrashing и замедляют работу.
-// На SSD/NVMe параллельные запросы утилизируют очередь контроллера (NCQ/NVMe queue).
+        auto first = tree.begin(), last = tree.end();
+        if (!relDir.empty()) {
+            const std::wstring pre = relDir + L'\\';
+            first = last = tree.lower_bound(pre);
+            while (last != tree.end() && WatchHasPrefix(last->first, pre)) ++last;
+        }
+        while (first != last) {
+            if (first->second.seen != gen) { first = tree.erase(first); ++touched; }
+            else ++first;
+        }
+    }
 
-void GenerateAllTxt(const std::wstring& folderPath) {
-    std::wstring baseStr = folderPath;
-    if (!baseStr.empty() && baseStr.back() != L'\\') baseStr += L'\\';
-    const DWORD baseLen = (DWORD)baseStr.length();
+    // Пачка событий → дерево. false — задет .gitignore/.ignore, нужен полный проход
+    bool apply(const WatchPending& pending, std::vector<std::wstring>& jobs) {
+        scopes.clear();
+        for (const auto& kv : pending) {
+            const std::wstring& rel  = kv.first;
+            const wchar_t*      name = rel.c_str() + (rel.rfind(L'\\') + 1);
+            if (_wcsicmp(name, L".gitignore") == 0 || _wcsicmp(name, L".ignore") == 0) return false;
+            if (IsOwnOutput(name)) continue;
+
+            WIN32_FILE_ATTRIBUTE_DATA fa;
+            if (!GetFileAttributesExW((baseStr + rel).c_str(), GetFileExInfoStandard, &fa)) { erase(rel); continue; }
+            if (fa.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                // Создана или переименована — перечитываем поддерево; MODIFIED у директории
+                // означает лишь смену её списка, сами записи придут своими событиями
+                if (kv.second & kWatchStructural) scan(rel, jobs);
+                continue;
+            }
+            if (ignored(rel, false)) { erase(rel); continue; }
+            const ULONGLONG size = ((ULONGLONG)fa.nFileSizeHigh << 32) | fa.nFileSizeLow;
+            if (put(rel, name, size, FileTimeToU64(fa.ftLastWriteTime), fa.dwFileAttributes)) jobs.push_back(rel);
+        }
+        return true;
+    }
 
-    OutBuf out;
-    if (!out.open((baseStr + L"all.txt").c_str(), 8 * 1024 * 1024)) {
-        PostMessage(g_hProgressWnd, WM_CLOSE, 0, 0);
-        return;
+    void rescan(std::vector<std::wstring>& jobs) {
+        scopes.clear();
+        jobs.clear();
+        scan(std::wstring(), jobs);
     }
 
-    // Определяем тип диска и подбираем параметры
-    const bool ssd = IsPathOnSSD(baseStr.c_str());
-    const int  numWorkers    = ssd ? max(2, min(8, (int)std::thread::hardware_concurrency() - 2)) : 2;
-    const int  pathChanCap   = ssd ? 256 : 16;   // HDD: маленькая очередь = меньше seek-ов
-    const int  outChanCap    = ssd ? 64  : 32;
+    // Параллельное чтение файлов из jobs; занятые другим процессом → retry
+    void build(const std::vector<std::wstring>& jobs, std::vector<std::wstring>& retry) {
+        std::vector<WatchTree::value_type*> items;
+        items.reserve(jobs.size());
+        for (const std::wstring& rel : jobs) {
+            auto it = tree.find(rel);
+            if (it != tree.end() && !it->second.fresh) items.push_back(&*it);
+        }
+        std::vector<char>   failed(items.size(), 0);
+        std::atomic<size_t> next{ 0 };
+        auto worker = [&]() {
+            std::string  text;
+            std::wstring wide;
+            for (size_t i; (i = next.fetch_add(1)) < items.size();)
+                failed[i] = !BuildWatchBlock(baseStr + items[i]->first, ctx.opt.contentFilters, items[i]->second, text, wide);
+        };
+        const size_t numThreads = min(items.size(), (size_t)(ssd ? max(1u, std::thread::hardware_concurrency()) : 2));
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < numThreads; ++i) threads.emplace_back(worker);
+        if (numThreads) worker();
+        for (auto& t : threads) t.join();
+
+        for (size_t i = 0; i < items.size(); ++i) {
+            WatchEntry& e = items[i]->second;
+            if (!failed[i]) { e.fresh = true; e.tries = 0; continue; }
+            if (++e.tries < kWatchRetries) retry.push_back(items[i]->first);
+        }
+    }
 
-    // Каналы
-    Chan<std::wstring> pathChan(pathChanCap);
-    Chan<std::string>  outChan(outChanCap);
+    // all.txt, file_list.txt и file_list.idx из дерева — через .tmp и замену
+    bool write(ULONGLONG& dumpBytes) {
+        const std::wstring allPath  = baseStr + L"all.txt";
+        const std::wstring listPath = baseStr + L"file_list.txt";
+        const std::wstring idxPath  = baseStr + L"file_list.idx";
+        OutBuf all, list;
+        if (!all.open((allPath + L".tmp").c_str(), 8 * 1024 * 1024)) return false;
+        if (!list.open((listPath + L".tmp").c_str(), 1 * 1024 * 1024)) {
+            all.close();
+            DeleteFileW((allPath + L".tmp").c_str());
+            return false;
+        }
 
-    std::atomic<int> activeWorkers(numWorkers);
+        FileIndexBuilder index;
+        dumpBytes = 0;
+        for (const auto& kv : tree) {
+            const WatchEntry& e = kv.second;
+            index.add(e.rel.data(), e.rel.size(), e.size, e.mtime, e.attrs);
+            list.write(e.rel.data(), (DWORD)e.rel.size());
+            list.write("\n", 1);
+
+            if (e.block.empty()) continue;
+            all.write(e.block.data(), (DWORD)e.block.size());
+            dumpBytes += e.block.size();
+            if (e.stream) {
+                dumpBytes += StreamCleanFile((baseStr + kv.first).c_str(), all, ctx) + 2;
+                all.write("\n\n", 2);
+            }
+        }
+        all.close();
+        list.close();
+        // Запись не прошла (диск полон) — старые файлы остаются, недописанные tmp убираем
+        if (all.failed || list.failed) {
+            DeleteFileW((allPath + L".tmp").c_str());
+            DeleteFileW((listPath + L".tmp").c_str());
+            return false;
+        }
 
-    // --- ВОРКЕР: mmap + SIMD binary check + state-machine hex clean ---
-    auto workerFn = [&]() {
-        std::wstring fullPath;
-        char utf8Buf[MAX_PATH * 4 + 4];
-        std::string  cleaned;
+        // Манифест описывал прошлый all.txt: следующий -dump пойдёт с нуля
+        DeleteFileW((baseStr + L"all.manifest").c_str());
+        bool ok = true;
+        if (!MoveFileExW((allPath + L".tmp").c_str(), allPath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+            DeleteFileW((allPath + L".tmp").c_str());
+            ok = false;
+        }
+        if (!MoveFileExW((listPath + L".tmp").c_str(), listPath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+            DeleteFileW((listPath + L".tmp").c_str());
+            ok = false;
+        }
+        index.replace(idxPath);
+        touched = 0;
+        return ok;
+    }
+};
 
-        while (pathChan.recv(fullPath)) {
-            if (g_cancel.load(std::memory_order_relaxed)) continue;
+static HANDLE g_watchStop  = NULL;   // Ctrl+C, "q" или "-watch <папка> stop"
+static HANDLE g_watchFlush = NULL;   // Enter: записать выходные файлы сейчас
 
-            // Открываем файл
-            HANDLE hFile = CreateFileW(fullPath.c_str(), GENERIC_READ, FILE_SHARE_READ,
-                NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
-            if (hFile == INVALID_HANDLE_VALUE) continue;
+static BOOL WINAPI WatchCtrlHandler(DWORD) {
+    SetEvent(g_watchStop);
+    return TRUE;
+}
 
-            LARGE_INTEGER fsz;
-            if (!GetFileSizeEx(hFile, &fsz) || fsz.QuadPart == 0) { CloseHandle(hFile); continue; }
+// Имя события остановки: одно на папку при любом написании пути
+static std::wstring WatchStopEventName(const std::wstring& folderPath) {
+    wchar_t full[MAX_PATH * 4];
+    DWORD   n = GetFullPathNameW(folderPath.c_str(), MAX_PATH * 4, full, NULL);
+    if (!n || n >= MAX_PATH * 4) { n = (DWORD)min(folderPath.size(), (size_t)MAX_PATH * 4 - 1); wmemcpy(full, folderPath.c_str(), n); }
+    while (n > 3 && full[n - 1] == L'\\') --n;
+    CharUpperBuffW(full, n);
+    wchar_t name[64];
+    swprintf(name, 64, L"Local\\HelpersWatchStop_%016llx", HashBytes((const char*)full, n * sizeof(wchar_t)));
+    return name;
+}
 
-            DWORD sz = (DWORD)min(fsz.QuadPart, (LONGLONG)50 * 1024 * 1024);
+// "-watch <папка> stop": останавливает наблюдение за папкой, запущенное раньше
+static int StopWatch(const std::wstring& folderPath) {
+    HANDLE h = OpenEventW(EVENT_MODIFY_STATE, FALSE, WatchStopEventName(folderPath).c_str());
+    if (!h) return 1;
+    SetEvent(h);
+    CloseHandle(h);
+    return 0;
+}
+
+int RunWatch(const std::wstring& folderPath, LPWSTR* argv, int argc) {
+    if (argc > 0 && _wcsicmp(argv[0], L"stop") == 0) return StopWatch(folderPath);
+
+    Watcher w;
+    w.baseStr = folderPath;
+    if (!w.baseStr.empty() && w.baseStr.back() != L'\\') w.baseStr += L'\\';
+    w.ssd = IsPathOnSSD(w.baseStr.c_str());
+
+    AttachConsoleIo(true);
+    SetConsoleOutputCP(CP_UTF8);
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    char   line[160];
+    auto say = [&]() {
+        SYSTEMTIME st;
+        GetLocalTime(&st);
+        char stamp[16];
+        snprintf(stamp, sizeof(stamp), "[%02u:%02u:%02u] ", st.wHour, st.wMinute, st.wSecond);
+        DWORD wr;
+        WriteFile(hOut, stamp, (DWORD)strlen(stamp), &wr, NULL);
+        WriteFile(hOut, line, (DWORD)strlen(line), &wr, NULL);
+    };
 
-            // Memory Mapped File: ОС сама управляет кэшем, ноль лишних копий ядро→юзер
-            HANDLE hMap = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, sz, NULL);
-            CloseHandle(hFile);
-            if (!hMap) continue;
+    // Подписка до первого обхода: изменения во время него не теряются
+    HANDLE hDir = CreateFileW(w.baseStr.c_str(), FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (hDir == INVALID_HANDLE_VALUE) {
+        snprintf(line, sizeof(line), "Не удалось открыть папку для наблюдения\n");
+        say();
+        return 1;
+    }
+    g_watchStop = CreateEventW(NULL, TRUE, FALSE, WatchStopEventName(folderPath).c_str());
+    if (!g_watchStop || GetLastError() == ERROR_ALREADY_EXISTS) {
+        snprintf(line, sizeof(line), "За этой папкой уже наблюдает другой процесс\n");
+        say();
+        if (g_watchStop) CloseHandle(g_watchStop);
+        CloseHandle(hDir);
+        return 1;
+    }
+    HANDLE hNotify = CreateEventW(NULL, TRUE, FALSE, NULL);
+    g_watchFlush   = CreateEventW(NULL, FALSE, FALSE, NULL);
+    SetConsoleCtrlHandler(WatchCtrlHandler, TRUE);
+
+    std::vector<DWORD> buf(kWatchBuffer / sizeof(DWORD));   // FILE_NOTIFY_INFORMATION выровнены на DWORD
+    OVERLAPPED ov = {};
+    const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE |
+                         FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_ATTRIBUTES;
+    auto arm = [&]() {
+        ResetEvent(hNotify);
+        ov = {};
+        ov.hEvent = hNotify;
+        return ReadDirectoryChangesW(hDir, buf.data(), kWatchBuffer, TRUE, filter, NULL, &ov, NULL) != 0;
+    };
+    if (!arm()) {
+        snprintf(line, sizeof(line), "ReadDirectoryChangesW не поддерживается для этой папки\n");
+        say();
+        CloseHandle(hDir); CloseHandle(hNotify); CloseHandle(g_watchStop); CloseHandle(g_watchFlush);
+        return 1;
+    }
 
-            const char* view = (const char*)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, sz);
-            if (!view) { CloseHandle(hMap); continue; }
+    // Консоль: строка "q" — выход, пустая строка — принудительная запись
+    std::thread([]() {
+        char cmd[64];
+        while (fgets(cmd, sizeof(cmd), stdin)) {
+            if (cmd[0] == 'q' || cmd[0] == 'Q') { SetEvent(g_watchStop); return; }
+            SetEvent(g_watchFlush);
+        }
+    }).detach();
+
+    std::vector<std::wstring> jobs, retry;
+    ULONGLONG dumpBytes = 0;
+    LONGLONG  t0 = QpcNow();
+    w.rescan(jobs);
+    w.build(jobs, retry);
+    w.write(dumpBytes);
+    snprintf(line, sizeof(line), "%llu файлов, all.txt %llu КБ, %.0f мс. Enter — записать заново, q — выход\n",
+        (unsigned long long)w.tree.size(), dumpBytes / 1024, QpcToMs(QpcNow() - t0));
+    say();
+
+    WatchPending pending;
+    for (const std::wstring& rel : retry) pending[rel] |= kWatchModified;
+    bool      full  = false;                 // уведомления потеряны → полный проход
+    ULONGLONG first = GetTickCount64();      // первое событие текущей пачки
+    HANDLE    waits[3] = { g_watchStop, hNotify, g_watchFlush };
+    for (;;) {
+        DWORD timeout = INFINITE;
+        if (full || !pending.empty()) {
+            const ULONGLONG age = GetTickCount64() - first;
+            timeout = age >= kWatchMaxDelayMs ? 0 : min(kWatchQuietMs, (DWORD)(kWatchMaxDelayMs - age));
+        }
+        const DWORD r = WaitForMultipleObjects(3, waits, FALSE, timeout);
+        if (r == WAIT_OBJECT_0) break;
+
+        if (r == WAIT_OBJECT_0 + 1) {
+            if (!full && pending.empty()) first = GetTickCount64();
+            DWORD got = 0;
+            if (!GetOverlappedResult(hDir, &ov, &got, FALSE) || got == 0) {
+                full = true;   // буфер переполнился: что именно менялось — неизвестно
+            } else {
+                const char* p = (const char*)buf.data();
+                for (;;) {
+                    const FILE_NOTIFY_INFORMATION* fni = (const FILE_NOTIFY_INFORMATION*)p;
+                    std::wstring rel(fni->FileName, fni->FileNameLength / sizeof(wchar_t));
+                    pending[rel] |= fni->Action == FILE_ACTION_MODIFIED ? kWatchModified : kWatchStructural;
+                    if (!fni->NextEntryOffset) break;
+                    p += fni->NextEntryOffset;
+                }
+            }
+            if (!arm()) {
+                snprintf(line, sizeof(line), "Наблюдение прервано (папка удалена или недоступна)\n");
+                say();
+                break;
+            }
+            continue;
+        }
 
-            // SIMD проверка на бинарность (первые 1024 байта)
-            bool isBinary = HasNullByte(view, min((size_t)sz, (size_t)1024));
-            if (isBinary) { UnmapViewOfFile(view); CloseHandle(hMap); continue; }
+        if (r == WAIT_OBJECT_0 + 2) {
+            t0 = QpcNow();
+            const bool ok = w.write(dumpBytes);
+            snprintf(line, sizeof(line), ok ? "записано: all.txt %llu КБ, %.1f мс\n" : "ошибка записи (файл занят?)\n",
+                dumpBytes / 1024, QpcToMs(QpcNow() - t0));
+            say();
+            continue;
+        }
 
-            // UTF-8 конвертация относительного пути (single-pass, стековый буфер)
-            int relWLen = (int)(fullPath.size() - (size_t)baseLen);
-            int utf8Len = WideCharToMultiByte(CP_UTF8, 0,
-                fullPath.c_str() + baseLen, relWLen,
-                utf8Buf, (int)sizeof(utf8Buf) - 4, NULL, NULL);
-            if (utf8Len <= 0) { UnmapViewOfFile(view); CloseHandle(hMap); continue; }
+        // Тишина kWatchQuietMs (или пачка копится слишком долго) → обрабатываем
+        t0 = QpcNow();
+        jobs.clear();
+        retry.clear();
+        if (full || !w.apply(pending, jobs)) {
+            full = true;
+            w.rescan(jobs);
+        }
+        pending.clear();
+        w.build(jobs, retry);
+        for (const std::wstring& rel : retry) pending[rel] |= kWatchModified;
+        first = GetTickCount64();
+        if (!w.touched) { full = false; continue; }   // только наши же выходные файлы
+
+        const size_t touched = w.touched;
+        const bool   ok      = w.write(dumpBytes);
+        snprintf(line, sizeof(line), "%s%llu изменений, перечитано %llu, all.txt %llu КБ, %.1f мс%s\n",
+            full ? "полный проход: " : "", (unsigned long long)touched, (unsigned long long)jobs.size(),
+            dumpBytes / 1024, QpcToMs(QpcNow() - t0), ok ? "" : " (ошибка записи)");
+        say();
+        full = false;
+    }
 
-            // Собираем выходной блок:
-            //   "rel/path:\n"
-            //   "----------\n"
-            //   <content>\n\n
-            std::string chunk;
-            chunk.reserve((size_t)utf8Len * 2 + 4 + sz);
+    CancelIo(hDir);
+    CloseHandle(hDir);
+    CloseHandle(hNotify);
+    // g_watchStop и g_watchFlush не закрываются: stdin-поток ещё может их дёрнуть,
+    // а имя события освобождается вместе с процессом
+    SetConsoleCtrlHandler(WatchCtrlHandler, FALSE);
+    return 0;
+}
 
-            // Заголовок
-            chunk.append(utf8Buf, (size_t)utf8Len);
-            chunk += ":\n";
-            chunk.append((size_t)utf8Len, '-');
-            chunk += '\n';
+// --- БЕНЧМАРК: -bench "<папка>" [ключ=значение ...] ---
+//
+// Детерминированно генерирует синтетическое дерево в <папка>\tree_<параметры>,
+// гоняет микробенчмарки ядер и полный дамп (холодный прогон + инкрементальный
+// повтор без изменений, затем холодные: с чтением мелких файлов через mapping,
+// в режиме lz4, с шардами, с трассировкой stats, с elevator-порядком чтений и пара
+// на 8 воркерах — без окна переупорядочивания и с ним).
+// Итог — <папка>\bench.json.
+//
+// Ключи: depth, fanout, files (в каждой директории), minsize/maxsize (байт,
+//        размер лог-равномерно), binary/hex (% бинарных и с hex-таблицами),
+//        dup (% текстовых файлов — копия предыдущего в той же директории), seed,
+//        budget (МБ in-flight для дампа, как у -dump).
+
+struct BenchConfig {
+    int       depth     = 3;
+    int       fanout    = 4;
+    int       files     = 24;
+    ULONGLONG minSize   = 256;
+    ULONGLONG maxSize   = 64 * 1024;
+    int       binaryPct = 5;
+    int       hexPct    = 10;
+    int       dupPct    = 5;
+    ULONGLONG seed      = 1;
+};
 
-            // Контент: пробуем очистить hex-массивы через state-machine (без regex!)
-            // Если файл > 500KB или нет замен — читаем прямо из mmap (zero-copy)
-            if (sz < 500000 && CleanHexArrays(view, sz, cleaned))
-                chunk += cleaned;
-            else
-                chunk.append(view, sz);
+static void ParseBenchArgs(LPWSTR* argv, int argc, BenchConfig& cfg) {
+    for (int i = 0; i < argc; ++i) {
+        const wchar_t* eq = wcschr(argv[i], L'=');
+        if (!eq) continue;
+        const std::wstring key(argv[i], (size_t)(eq - argv[i]));
+        const ULONGLONG    v = wcstoull(eq + 1, nullptr, 10);
+        if      (key == L"depth")   cfg.depth     = (int)v;
+        else if (key == L"fanout")  cfg.fanout    = (int)v;
+        else if (key == L"files")   cfg.files     = (int)v;
+        else if (key == L"minsize") cfg.minSize   = max(v, 1ull);
+        else if (key == L"maxsize") cfg.maxSize   = max(v, 1ull);
+        else if (key == L"binary")  cfg.binaryPct = (int)v;
+        else if (key == L"hex")     cfg.hexPct    = (int)v;
+        else if (key == L"dup")     cfg.dupPct    = (int)v;
+        else if (key == L"seed")    cfg.seed      = v;
+    }
+    if (cfg.maxSize < cfg.minSize) cfg.maxSize = cfg.minSize;
+}
 
-            chunk += "\n\n";
+// Веб/фронтенд вперемешку: код, hex-таблицы, base64 в строках и data: URI,
+// серии пустых строк и изредка минифицированная строка на 8-20 КБ
+static void BenchMixedContent(std::mt19937_64& rng, std::string& out, size_t size) {
+    static const char kB64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    auto b64 = [&](size_t n) { for (size_t i = 0; i < n; ++i) out += kB64[rng() % 64]; };
+    while (out.size() < size) {
+        switch (rng() % 8) {
+        case 0:  BenchHexArray(rng, out, 2048 + rng() % 4096); break;
+        case 1:  out += "const icon = \""; b64(256 + rng() % 2048); out += "\";\n"; break;
+        case 2:  out += "<img src=\"data:image/png;base64,"; b64(64 + rng() % 4096); out += "==\">\n"; break;
+        case 3:  out.append(3 + rng() % 12, '\n'); break;
+        case 4:
+            if (rng() % 4 == 0) {
+                for (size_t n = 8 * 1024 + rng() % (12 * 1024); n; --n) out += "a=b(c);{}"[rng() % 9];
+                out += '\n';
+            }
+            break;
+        default: BenchText(rng, out, out.size() + 512 + rng() % 2048); break;
+        }
+    }
+    out.resize(size);
+}
 
-            UnmapViewOfFile(view);
-            CloseHandle(hMap);
+static void BenchBinary(std::mt19937_64& rng, std::string& out, size_t size) {
+    out.resize(size);
+    for (auto& c : out) c = (char)(rng() & 0xFF);
+    out[(size_t)(rng() % min(size, (size_t)1024))] = '\0';
+}
 
-            outChan.send(std::move(chunk));
+struct BenchTreeTotals { ULONGLONG files = 0, bytes = 0; };
+
+static void GenerateBenchTree(const std::wstring& dir, int level, const BenchConfig& cfg,
+                              std::mt19937_64& rng, BenchTreeTotals& tot) {
+    static const wchar_t* const kTextExts[] = { L".cpp", L".h", L".txt", L".py" };
+    CreateDirectoryW(dir.c_str(), NULL);
+
+    std::uniform_real_distribution<double> logSize(log((double)cfg.minSize), log((double)cfg.maxSize));
+    std::string content, lastText;
+    for (int i = 0; i < cfg.files; ++i) {
+        const size_t size = max((size_t)exp(logSize(rng)), (size_t)1);
+        const int    kind = (int)(rng() % 100);
+        std::wstring name = dir + L"f" + std::to_wstring(i);
+        content.clear();
+        if (kind < cfg.binaryPct) {
+            BenchBinary(rng, content, size);      name += L".dat";
+        } else if (kind < cfg.binaryPct + cfg.hexPct) {
+            BenchHexArray(rng, content, size);    name += L".c";
+        } else if (kind < cfg.binaryPct + cfg.hexPct + cfg.dupPct && !lastText.empty()) {
+            content = lastText;                   name += L".h";
+        } else {
+            BenchText(rng, content, size);        name += kTextExts[rng() % 4];
+            lastText = content;
         }
+        if (WriteWholeFile(name, content)) { ++tot.files; tot.bytes += content.size(); }
+    }
 
-        // Последний воркер закрывает outChan → output-поток завершается
-        if (--activeWorkers == 0)
-            outChan.close();
-    };
+    if (level < cfg.depth)
+        for (int d = 0; d < cfg.fanout; ++d)
+            GenerateBenchTree(dir + L"d" + std::to_wstring(d) + L"\\", level + 1, cfg, rng, tot);
+}
+
+// Повторяет fn, пока не наберётся minMs; возвращает мс на один вызов
+template<typename F>
+static double BenchLoop(F&& fn, double minMs = 300.0) {
+    int iters = 0;
+    double ms = 0;
+    const LONGLONG t0 = QpcNow();
+    do { fn(); ++iters; ms = QpcToMs(QpcNow() - t0); } while (ms < minMs);
+    return ms / iters;
+}
 
-    // --- OUTPUT ПОТОК: последовательная запись ---
-    std::thread outputThread([&]() {
-        std::string chunk;
-        while (outChan.recv(chunk))
-            out.write(chunk.data(), (DWORD)chunk.size());
+static void AppendMicro(std::string& json, const char* name, double value, const char* unit) {
+    char buf[160];
+    snprintf(buf, sizeof(buf), "%s\n    { \"name\": \"%s\", \"value\": %.3f, \"unit\": \"%s\" }",
+        json.empty() ? "" : ",", name, value, unit);
+    json += buf;
+}
+
+// Конкуренция за канал: P продюсеров → C консюмеров, пачками по batch элементов.
+// У Chan пачек нет — шлёт и принимает поштучно.
+template<typename T> static void ChanSendAll(Chan<T>& q, T* v, size_t n) { for (size_t i = 0; i < n; ++i) q.send(v[i]); }
+template<typename T> static void ChanSendAll(Ring<T>& q, T* v, size_t n) { q.sendBatch(v, n); }
+template<typename T> static size_t ChanRecvSome(Chan<T>& q, T* v, size_t)  { return q.recv(v[0]) ? 1 : 0; }
+template<typename T> static size_t ChanRecvSome(Ring<T>& q, T* v, size_t n) { return q.recvBatch(v, n); }
+
+template<typename Q>
+static double BenchChannel(int producers, int consumers, size_t batch) {
+    const size_t kPerProducer = (1 << 20) / producers;
+    const double ms = BenchLoop([&]() {
+        Q q(256);
+        std::atomic<int> live(producers);
+        std::vector<std::thread> th;
+        for (int p = 0; p < producers; ++p) th.emplace_back([&]() {
+            std::vector<size_t> buf(batch);
+            for (size_t i = 0; i < kPerProducer; i += batch) {
+                const size_t n = min(batch, kPerProducer - i);
+                for (size_t k = 0; k < n; ++k) buf[k] = i + k;
+                ChanSendAll(q, buf.data(), n);
+            }
+            if (--live == 0) q.close();
+        });
+        for (int c = 0; c < consumers; ++c) th.emplace_back([&]() {
+            std::vector<size_t> buf(batch);
+            while (ChanRecvSome(q, buf.data(), batch)) {}
+        });
+        for (auto& t : th) t.join();
     });
+    return (double)(kPerProducer * producers) / ms / 1000.0;
+}
 
-    // --- ЗАПУСК ВОРКЕРОВ ---
-    std::vector<std::thread> workers;
-    workers.reserve(numWorkers);
-    for (int i = 0; i < numWorkers; ++i)
-        workers.emplace_back(workerFn);
-
-    // --- СКАНЕР (текущий поток): обход дерева директорий ---
-    static wchar_t pathBuf[32768];
-    wmemcpy(pathBuf, baseStr.c_str(), baseLen + 1);
-    DWORD pathLen = baseLen;
-
-    WIN32_FIND_DATAW fd = {};
-    std::vector<DirLevel> stk;
-    stk.reserve(64);
-    stk.push_back({ INVALID_HANDLE_VALUE, baseLen, true });
-
-    int counter = 0;
-
-    while (!stk.empty() && !g_cancel.load(std::memory_order_relaxed)) {
-        DirLevel& cur = stk.back();
-
-        if (cur.first) {
-            cur.first = false;
-            pathBuf[pathLen] = L'*'; pathBuf[pathLen + 1] = L'\0';
-            cur.hFind = FindFirstFileExW(pathBuf, FindExInfoBasic, &fd,
-                FindExSearchNameMatch, NULL,
-                FIND_FIRST_EX_LARGE_FETCH | FIND_FIRST_EX_CASE_SENSITIVE);
-            pathBuf[pathLen] = L'\0';
-            if (cur.hFind == INVALID_HANDLE_VALUE) { pathLen = cur.pathEnd; stk.pop_back(); continue; }
-        } else {
-            if (!FindNextFileW(cur.hFind, &fd)) {
-                FindClose(cur.hFind);
-                pathLen = cur.pathEnd;
-                stk.pop_back();
-                continue;
+// Снимок экрана 4K в BGRX: фон, окна с заголовками, строки «текста», фото-вставка с шумом
+static void BenchScreenshot(std::mt19937_64& rng, std::vector<unsigned char>& px, int w, int h) {
+    px.assign((size_t)w * h * 4, 0xF3);
+    auto fill = [&](int x0, int y0, int x1, int y1, unsigned bgr) {
+        for (int y = max(y0, 0); y < min(y1, h); ++y)
+            for (int x = max(x0, 0); x < min(x1, w); ++x) memcpy(&px[((size_t)y * w + x) * 4], &bgr, 4);
+    };
+    for (int win = 0; win < 6; ++win) {
+        const int x0 = (int)(rng() % (w - 1200)), y0 = (int)(rng() % (h - 900));
+        const int x1 = x0 + 600 + (int)(rng() % 600), y1 = y0 + 400 + (int)(rng() % 500);
+        fill(x0, y0, x1, y1, 0xFFFFFF);
+        fill(x0, y0, x1, y0 + 32, (unsigned)rng() & 0x7F7F7F);
+        for (int ty = y0 + 48; ty + 14 < y1; ty += 20)
+            for (int tx = x0 + 12; tx < x1 - 40;) {
+                const int word = 3 + (int)(rng() % 9);
+                for (int c = 0; c < word && tx + 8 < x1; ++c, tx += 8) {
+                    const ULONGLONG glyph = rng();
+                    for (int gy = 0; gy < 12; ++gy)
+                        for (int gx = 0; gx < 5; ++gx)
+                            if (glyph >> (gy * 5 + gx) % 64 & 1) fill(tx + gx, ty + gy, tx + gx + 1, ty + gy + 1, 0x202020);
+                }
+                tx += 8;
             }
+    }
+    const int px0 = w / 2, py0 = h / 3;
+    for (int y = py0; y < min(py0 + 600, h); ++y)
+        for (int x = px0; x < min(px0 + 800, w); ++x) {
+            unsigned char* p = &px[((size_t)y * w + x) * 4];
+            p[0] = (unsigned char)((x - px0) / 4 + rng() % 6);
+            p[1] = (unsigned char)((y - py0) / 3 + rng() % 6);
+            p[2] = (unsigned char)((x + y) / 8 + rng() % 6);
         }
+}
 
-        if (++counter >= 500) {
-            counter = 0;
-            std::lock_guard<std::mutex> lk(g_statusMutex);
-            g_currentStatus = fd.cFileName;
+// Прежний путь "-paste": WIC PNG-кодер (24bppBGR, CompressionQuality 0) в память
+static bool WicEncodePng(IWICImagingFactory* factory, std::vector<unsigned char>& px, UINT w, UINT h,
+                         std::vector<unsigned char>& out, ULONGLONG& outSize) {
+    IWICBitmap*            pBitmap  = nullptr;
+    IWICStream*            pStream  = nullptr;
+    IWICBitmapEncoder*     pEncoder = nullptr;
+    IWICBitmapFrameEncode* pFrame   = nullptr;
+    IPropertyBag2*         pProps   = nullptr;
+
+    bool ok = false;
+    out.resize(px.size() + 1024 * 1024);
+    if (SUCCEEDED(factory->CreateBitmapFromMemory(w, h, GUID_WICPixelFormat32bppBGR, w * 4, (UINT)px.size(), px.data(), &pBitmap)) &&
+        SUCCEEDED(factory->CreateStream(&pStream)) &&
+        SUCCEEDED(pStream->InitializeFromMemory(out.data(), (DWORD)out.size())) &&
+        SUCCEEDED(factory->CreateEncoder(GUID_ContainerFormatPng, nullptr, &pEncoder)) &&
+        SUCCEEDED(pEncoder->Initialize(pStream, WICBitmapEncoderNoCache)) &&
+        SUCCEEDED(pEncoder->CreateNewFrame(&pFrame, &pProps)))
+    {
+        PROPBAG2 opt = {};
+        opt.pstrName = const_cast<LPOLESTR>(L"CompressionQuality");
+        VARIANT val  = {}; val.vt = VT_R4; val.fltVal = 0.0f;
+        pProps->Write(1, &opt, &val);
+        WICPixelFormatGUID fmt = GUID_WICPixelFormat24bppBGR;
+        LARGE_INTEGER  zero = {};
+        ULARGE_INTEGER end  = {};
+        if (SUCCEEDED(pFrame->Initialize(pProps)) &&
+            SUCCEEDED(pFrame->SetSize(w, h)) &&
+            SUCCEEDED(pFrame->SetPixelFormat(&fmt)) &&
+            SUCCEEDED(pFrame->WriteSource(pBitmap, nullptr)) &&
+            SUCCEEDED(pFrame->Commit()) &&
+            SUCCEEDED(pEncoder->Commit()) &&
+            SUCCEEDED(pStream->Seek(zero, STREAM_SEEK_CUR, &end)))
+        {
+            outSize = end.QuadPart;
+            ok = true;
         }
+    }
+    if (pProps)   pProps->Release();
+    if (pFrame)   pFrame->Release();
+    if (pEncoder) pEncoder->Release();
+    if (pStream)  pStream->Release();
+    if (pBitmap)  pBitmap->Release();
+    return ok;
+}
 
-        const wchar_t* name = fd.cFileName;
+// Эталонная проверка: WIC декодирует наш PNG, RGB каждого пикселя совпадает с исходником
+static bool WicDecodeMatches(IWICImagingFactory* factory, const std::string& png,
+                             const std::vector<unsigned char>& px, UINT w, UINT h) {
+    IWICStream*            pStream  = nullptr;
+    IWICBitmapDecoder*     pDecoder = nullptr;
+    IWICBitmapFrameDecode* pFrame   = nullptr;
+    IWICFormatConverter*   pConv    = nullptr;
+
+    bool same = false;
+    std::vector<unsigned char> decoded(px.size());
+    UINT dw = 0, dh = 0;
+    if (SUCCEEDED(factory->CreateStream(&pStream)) &&
+        SUCCEEDED(pStream->InitializeFromMemory((BYTE*)png.data(), (DWORD)png.size())) &&
+        SUCCEEDED(factory->CreateDecoderFromStream(pStream, nullptr, WICDecodeMetadataCacheOnDemand, &pDecoder)) &&
+        SUCCEEDED(pDecoder->GetFrame(0, &pFrame)) &&
+        SUCCEEDED(factory->CreateFormatConverter(&pConv)) &&
+        SUCCEEDED(pConv->Initialize(pFrame, GUID_WICPixelFormat32bppBGR, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom)) &&
+        SUCCEEDED(pConv->GetSize(&dw, &dh)) && dw == w && dh == h &&
+        SUCCEEDED(pConv->CopyPixels(nullptr, w * 4, (UINT)decoded.size(), decoded.data())))
+    {
+        same = true;
+        for (size_t i = 0; i < px.size() && same; i += 4) same = memcmp(&px[i], &decoded[i], 3) == 0;
+    }
+    if (pConv)    pConv->Release();
+    if (pFrame)   pFrame->Release();
+    if (pDecoder) pDecoder->Release();
+    if (pStream)  pStream->Release();
+    return same;
+}
 
-        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-            if (name[0] == L'.' && (name[1] == L'\0' || (name[1] == L'.' && name[2] == L'\0'))) continue;
-            DWORD nl = (DWORD)wcslen(name);
-            wmemcpy(pathBuf + pathLen, name, nl);
-            pathBuf[pathLen + nl] = L'\\';
-            DirLevel sub{ INVALID_HANDLE_VALUE, pathLen, true };
-            pathLen += nl + 1;
-            pathBuf[pathLen] = L'\0';
-            stk.push_back(sub);
-        } else {
-            if (_wcsicmp(name, L"all.txt") == 0 || _wcsicmp(name, L"file_list.txt") == 0) continue;
-            if (IsExcludedExtension(name)) continue;
+static std::string RunMicroBenchmarks(const std::wstring& dir, std::mt19937_64& rng) {
+    const size_t kBuf = 16 * 1024 * 1024;
+    const double mb   = (double)kBuf / (1024.0 * 1024.0);
+    volatile size_t sinkVal = 0;
+    std::string json;
+
+    std::string code;
+    BenchText(rng, code, kBuf);
+    std::string tables;
+    while (tables.size() < kBuf) BenchHexArray(rng, tables, 64 * 1024);
+
+    double ms = BenchLoop([&]() { sinkVal = sinkVal + HasNullByte(code.data(), code.size()); });
+    AppendMicro(json, "has_null_byte", mb / ms * 1000.0, "MB/s");
+
+    // Хэш отдельно и вместе с классификатором; ru — код с русскими комментариями
+    std::string ru;
+    while (ru.size() < kBuf) {
+        BenchText(rng, ru, ru.size() + 512);
+        ru += "// \xD0\xBA\xD0\xBE\xD0\xBC\xD0\xBC\xD0\xB5\xD0\xBD\xD1\x82\xD0\xB0\xD1\x80\xD0\xB8\xD0\xB9\n";
+    }
+    ru.resize(kBuf);
+    ms = BenchLoop([&]() { sinkVal = sinkVal + (size_t)HashBytes(ru.data(), ru.size()); });
+    AppendMicro(json, "hash_bytes", mb / ms * 1000.0, "MB/s");
+    ms = BenchLoop([&]() { TextScanner sc; sinkVal = sinkVal + (size_t)HashScan(ru.data(), ru.size(), sc) + sc.res.utf8; });
+    AppendMicro(json, "hash_scan_utf8", mb / ms * 1000.0, "MB/s");
+
+    std::string wide16(code.size() * 2, '\0');
+    for (size_t i = 0; i < code.size(); ++i) wide16[2 * i] = code[i];
+    std::string utf8;
+    ms = BenchLoop([&]() { sinkVal = sinkVal + (size_t)Utf16ToUtf8(wide16.data(), wide16.size(), false, utf8).ctrl + utf8.size(); });
+    AppendMicro(json, "utf16_to_utf8", (double)wide16.size() / (1024.0 * 1024.0) / ms * 1000.0, "MB/s");
+
+    std::string cleaned;
+    cleaned.reserve(kBuf);
+    ms = BenchLoop([&]() { cleaned.clear(); CleanHexArrays(code.data(), code.size(), cleaned); sinkVal = sinkVal + cleaned.size(); });
+    AppendMicro(json, "clean_hex_arrays_code", mb / ms * 1000.0, "MB/s");
+    ms = BenchLoop([&]() { cleaned.clear(); CleanHexArrays(tables.data(), tables.size(), cleaned); sinkVal = sinkVal + cleaned.size(); });
+    AppendMicro(json, "clean_hex_arrays_tables", (double)tables.size() / (1024.0 * 1024.0) / ms * 1000.0, "MB/s");
+
+    // Все трансформы одним проходом против четырёх проходов по одному трансформу
+    // (каждый читает вывод предыдущего); same_output — итог совпал байт в байт
+    std::string mixed;
+    BenchMixedContent(rng, mixed, kBuf);
+    std::string fused, pass1, pass2, pass3;
+    fused.reserve(kBuf);
+    ms = BenchLoop([&]() { fused.clear(); CleanWith<FilterSet<kXfAll>::type>(mixed.data(), mixed.size(), fused); sinkVal = sinkVal + fused.size(); });
+    AppendMicro(json, "content_filter_fused", mb / ms * 1000.0, "MB/s");
+    ms = BenchLoop([&]() {
+        pass1.clear(); pass2.clear(); pass3.clear(); cleaned.clear();
+        CleanWith<ContentFilter<MinifiedLineFilter>>(mixed.data(), mixed.size(), pass1);
+        CleanWith<ContentFilter<HexArrayFilter>>(pass1.data(), pass1.size(), pass2);
+        CleanWith<ContentFilter<Base64Filter>>(pass2.data(), pass2.size(), pass3);
+        CleanWith<ContentFilter<SpaceRunFilter>>(pass3.data(), pass3.size(), cleaned);
+        sinkVal = sinkVal + cleaned.size();
+    });
+    AppendMicro(json, "content_filter_sequential", mb / ms * 1000.0, "MB/s");
+    AppendMicro(json, "content_filter_same_output", fused == cleaned ? 1.0 : 0.0, "bool");
+    AppendMicro(json, "content_filter_ratio", (double)mixed.size() / (double)max(fused.size(), (size_t)1), "x");
+
+    // Сжатие кадрами по kLz4Block, как в режиме "-dump lz4"; ratio — raw / сжатое
+    Lz4Frame lzf;
+    std::string frames;
+    ms = BenchLoop([&]() {
+        frames.clear();
+        for (size_t off = 0; off < code.size(); off += kLz4Block)
+            lzf.compress(code.data() + off, min(kLz4Block, code.size() - off), frames);
+        sinkVal = sinkVal + frames.size();
+    });
+    AppendMicro(json, "lz4_compress_code", mb / ms * 1000.0, "MB/s");
+    AppendMicro(json, "lz4_ratio_code", (double)code.size() / (double)frames.size(), "x");
+
+    // PNG "-paste": свой кодер на всех ядрах и в один поток против WIC (прежний путь);
+    // roundtrip_ok — WIC декодировал наш файл в те же пиксели
+    const int kShotW = 3840, kShotH = 2160;
+    std::vector<unsigned char> shot;
+    BenchScreenshot(rng, shot, kShotW, kShotH);
+    PngSource shotSrc;
+    shotSrc.pixels = shot.data();
+    shotSrc.width  = kShotW;
+    shotSrc.height = kShotH;
+    shotSrc.stride = kShotW * 4;
+    const double shotMb = (double)shot.size() / (1024.0 * 1024.0);
+    std::string png;
+    ms = BenchLoop([&]() { EncodePng(shotSrc, png); sinkVal = sinkVal + png.size(); });
+    AppendMicro(json, "png_encode_mt", shotMb / ms * 1000.0, "MB/s");
+    ms = BenchLoop([&]() { EncodePng(shotSrc, png, 1); sinkVal = sinkVal + png.size(); });
+    AppendMicro(json, "png_encode_1t", shotMb / ms * 1000.0, "MB/s");
+    AppendMicro(json, "png_ratio", (double)shot.size() / (double)png.size(), "x");
+
+    IWICImagingFactory* factory = nullptr;
+    if (SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory)))) {
+        std::vector<unsigned char> wicPng;
+        ULONGLONG wicSize = 0;
+        ms = BenchLoop([&]() { sinkVal = sinkVal + WicEncodePng(factory, shot, kShotW, kShotH, wicPng, wicSize); });
+        AppendMicro(json, "png_encode_wic", shotMb / ms * 1000.0, "MB/s");
+        AppendMicro(json, "png_ratio_wic", wicSize ? (double)shot.size() / (double)wicSize : 0.0, "x");
+        AppendMicro(json, "png_roundtrip_ok", WicDecodeMatches(factory, png, shot, kShotW, kShotH) ? 1.0 : 0.0, "bool");
+        factory->Release();
+    }
 
-            DWORD nl = (DWORD)wcslen(name);
-            wmemcpy(pathBuf + pathLen, name, nl + 1);
-            pathChan.send(std::wstring(pathBuf, pathLen + nl));
-            pathBuf[pathLen] = L'\0';
+    static const wchar_t* const kNames[] = {
+        L"main.cpp", L"Helpers.vcxproj", L"README", L"image.PNG", L"archive.tar.gz",
+        L"module.obj", L"notes.txt", L"setup.exe", L"data.sqlite", L"x.h"
+    };
+    const int kCalls = 1 << 20;
+    ms = BenchLoop([&]() {
+        size_t hits = 0;
+        for (int i = 0; i < kCalls; ++i) hits += IsExcludedExtension(kNames[i % 10]);
+        sinkVal = sinkVal + hits;
+    });
+    AppendMicro(json, "is_excluded_extension", ms * 1e6 / kCalls, "ns/call");
+
+    // OutBuf::write кусками 16..4096 байт — как заголовки и мелкие файлы в дампе
+    const std::wstring tmp = dir + L"bench_outbuf.tmp";
+    std::vector<DWORD> pieces(4096);
+    for (auto& p : pieces) p = 16 + (DWORD)(rng() % 4080);
+    ms = BenchLoop([&]() {
+        OutBuf ob;
+        if (!ob.open(tmp.c_str(), 8 * 1024 * 1024)) return;
+        size_t off = 0;
+        for (size_t i = 0; off + 4096 <= code.size(); ++i) {
+            DWORD n = pieces[i % pieces.size()];
+            ob.write(code.data() + off, n);
+            off += n;
         }
-    }
+        ob.close();
+    }, 1000.0);
+    DeleteFileW(tmp.c_str());
+    AppendMicro(json, "outbuf_write", mb / ms * 1000.0, "MB/s");
+
+    // Chan (мьютекс) против Ring (lock-free) при 1×1 и 4×4 потоках
+    AppendMicro(json, "chan_mutex_1x1",   BenchChannel<Chan<size_t>>(1, 1, 1),  "Mitems/s");
+    AppendMicro(json, "ring_1x1",         BenchChannel<Ring<size_t>>(1, 1, 1),  "Mitems/s");
+    AppendMicro(json, "ring_batch32_1x1", BenchChannel<Ring<size_t>>(1, 1, 32), "Mitems/s");
+    AppendMicro(json, "chan_mutex_4x4",   BenchChannel<Chan<size_t>>(4, 4, 1),  "Mitems/s");
+    AppendMicro(json, "ring_4x4",         BenchChannel<Ring<size_t>>(4, 4, 1),  "Mitems/s");
+    AppendMicro(json, "ring_batch32_4x4", BenchChannel<Ring<size_t>>(4, 4, 32), "Mitems/s");
+
+    return json;
+}
 
-    // Cleanup сканера
-    for (auto& lv : stk) if (lv.hFind != INVALID_HANDLE_VALUE) FindClose(lv.hFind);
+static std::string RunDumpBenchmark(const char* name, const std::wstring& tree, const EngineOptions& opt) {
+    EngineContext ctx;
+    ctx.opt = opt;
+    GenerateAllTxt(ctx, tree);
+    const DumpStats& st = ctx.stats;
+
+    PROCESS_MEMORY_COUNTERS pmc = { sizeof(pmc) };
+    GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+
+    const double totalMs = QpcToMs(st.totalTicks);
+    const double sec     = max(totalMs, 1e-3) / 1000.0;
+    const double mbIn    = (double)st.bytesIn  / (1024.0 * 1024.0);
+    const double mbOut   = (double)st.bytesOut / (1024.0 * 1024.0);
+    // Экономия записи — по фактической скорости output-потока в этом прогоне
+    const double dupWriteMs = st.bytesOut
+        ? QpcToMs(st.outputTicks) * (double)st.dupSaved / (double)st.bytesOut : 0.0;
+
+    char buf[1536];
+    snprintf(buf, sizeof(buf),
+        "    { \"name\": \"%s\", \"files\": %llu, \"mb_in\": %.2f, \"mb_out\": %.2f,\n"
+        "      \"total_ms\": %.2f, \"files_per_s\": %.1f, \"mb_per_s\": %.1f,\n"
+        "      \"scan_ms\": %.2f, \"worker_busy_ms\": %.2f, \"output_busy_ms\": %.2f,\n"
+        "      \"workers\": %d, \"budget_mb\": %.0f, \"peak_inflight_mb\": %.1f, \"peak_rss_mb\": %.1f,\n"
+        "      \"dup_files\": %llu, \"dup_mb_saved\": %.2f, \"dup_write_ms_saved\": %.2f,\n"
+        "      \"binary_files\": %llu, \"transcoded_files\": %llu,\n"
+        "      \"lcn_travel_scan\": %llu, \"lcn_travel_sorted\": %llu,\n"
+        "      \"ordered\": %d, \"reorder_peak\": %llu, \"order_stalls\": %llu }",
+        name, (unsigned long long)st.files.load(), mbIn, mbOut,
+        totalMs, (double)st.files.load() / sec, mbIn / sec,
+        QpcToMs(st.scanTicks), QpcToMs(st.workerTicks), QpcToMs(st.outputTicks),
+        st.workers.load(),
+        (double)st.budget / (1024.0 * 1024.0), (double)st.peakInFlight / (1024.0 * 1024.0),
+        (double)pmc.PeakWorkingSetSize / (1024.0 * 1024.0),
+        (unsigned long long)st.dupFiles.load(), (double)st.dupSaved / (1024.0 * 1024.0),
+        dupWriteMs,
+        (unsigned long long)st.binaryFiles.load(), (unsigned long long)st.transcoded.load(),
+        (unsigned long long)st.lcnTravelScan.load(), (unsigned long long)st.lcnTravelSorted.load(),
+        (int)opt.ordered, (unsigned long long)st.reorderPeak.load(),
+        (unsigned long long)st.orderStalls.load());
+    return buf;
+}
 
-    // Сигнал воркерам: новых задач не будет
-    pathChan.close();
+// -list (с file_list.idx) и запросы по отображённому индексу
+static std::string RunIndexBenchmark(const std::wstring& tree) {
+    EngineContext  ctx;
+    const LONGLONG t0 = QpcNow();
+    GenerateFileList(ctx, tree);
+    const double listMs = QpcToMs(QpcNow() - t0);
+
+    FileIndexView v;
+    if (!v.open((tree + L"file_list.idx").c_str())) return "  \"index\": null,\n";
+    LARGE_INTEGER txt = {};
+    HANDLE h = CreateFileW((tree + L"file_list.txt").c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if (h != INVALID_HANDLE_VALUE) { GetFileSizeEx(h, &txt); CloseHandle(h); }
+
+    std::vector<ULONGLONG> hits;
+    auto timeQuery = [&](const IndexQuery& q) {
+        return BenchLoop([&]() { RunIndexQuery(v, q, hits); }, 100.0);
+    };
+    IndexQuery byExt;
+    byExt.name = L"*.cpp"; byExt.nameSuffix = ".cpp";
+    IndexQuery largest;
+    largest.sort = kQuerySortSize; largest.top = 100;
+    IndexQuery recentLarge;
+    recentLarge.minSize = 32 * 1024; recentLarge.since = v.h->count ? v.mtime[v.h->count / 2] : 0;
+
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+        "  \"index\": { \"list_ms\": %.2f, \"entries\": %llu, \"idx_kb\": %.1f, \"paths_kb\": %.1f, \"list_txt_kb\": %.1f,\n"
+        "             \"query_ext_ms\": %.3f, \"query_top_size_ms\": %.3f, \"query_recent_large_ms\": %.3f },\n",
+        listMs, (unsigned long long)v.h->count, (double)v.h->fileBytes / 1024.0, (double)v.h->pathBytes / 1024.0,
+        (double)txt.QuadPart / 1024.0, timeQuery(byExt), timeQuery(largest), timeQuery(recentLarge));
+    return buf;
+}
 
-    // Ждём завершения всех потоков
-    for (auto& w : workers) w.join();
-    outputThread.join();
+// 1 — прогоны дампа с порядком разошлись в all.txt (см. dump_identical),
+// 2 — неверные параметры дампа (ParseDumpArgs)
+int RunBenchmarks(const std::wstring& folderPath, LPWSTR* argv, int argc) {
+    std::wstring dir = folderPath;
+    if (!dir.empty() && dir.back() != L'\\') dir += L'\\';
+
+    BenchConfig cfg;
+    ParseBenchArgs(argv, argc, cfg);
+    EngineOptions base;
+    if (!ParseDumpArgs(argv, argc, base)) return 2;   // budget=<МБ> — для прогонов дампа
+    base.lz4       = false;
+    base.shardMB   = 0;
+    base.traceMode = 0;
+    base.batchRead = true;
+    std::mt19937_64 rng(cfg.seed);
+
+    wchar_t treeName[160];
+    swprintf(treeName, 160, L"tree_%d_%d_%d_%llu_%llu_%d_%d_%d_%llu\\", cfg.depth, cfg.fanout, cfg.files,
+        cfg.minSize, cfg.maxSize, cfg.binaryPct, cfg.hexPct, cfg.dupPct, cfg.seed);
+    const std::wstring tree = dir + treeName;
+
+    BenchTreeTotals tot;
+    const LONGLONG tGen = QpcNow();
+    GenerateBenchTree(tree, 0, cfg, rng, tot);
+    const double genMs = QpcToMs(QpcNow() - tGen);
+
+    // С порядком all.txt не зависит ни от гонок воркеров (кто первым нашёл дубликат),
+    // ни от способа чтения и числа воркеров: все такие прогоны в один файл — побайтно
+    ULONGLONG firstDump = 0;
+    int       dumps     = 0;
+    bool      identical = true;
+    auto checkDump = [&]() {
+        std::string data;
+        ReadWholeFile((tree + L"all.txt").c_str(), data);
+        const ULONGLONG h = HashBytes(data.data(), data.size());
+        if (dumps++ == 0)     firstDump = h;
+        else if (h != firstDump) identical = false;
+    };
 
-    out.close();
-    if (g_cancel.load()) DeleteFileW((baseStr + L"all.txt").c_str());
-    PostMessage(g_hProgressWnd, WM_CLOSE, 0, 0);
+    // Дампы первыми: пиковый working set — за весь процесс, микробенчмарки его раздувают
+    DeleteFileW((tree + L"all.txt").c_str());
+    DeleteFileW((tree + L"all.manifest").c_str());
+    const std::string cold = RunDumpBenchmark("dump_cold", tree, base);
+    checkDump();
+    const std::string incr = RunDumpBenchmark("dump_incremental", tree, base);
+    checkDump();
+    // Холодный с прежним чтением мелких файлов через mapping: files_per_s против dump_cold
+    DeleteFileW((tree + L"all.txt").c_str());
+    DeleteFileW((tree + L"all.manifest").c_str());
+    EngineOptions opt = base;
+    opt.batchRead = false;
+    const std::string mmapReads = RunDumpBenchmark("dump_mmap_reads", tree, opt);
+    checkDump();
+    // Тот же холодный дамп, но с кадрами lz4 вместо сырого all.txt
+    opt = base;
+    opt.lz4 = true;
+    const std::string lz4 = RunDumpBenchmark("dump_lz4", tree, opt);
+    // И разбитый на ~4 шарда с параллельными писателями
+    opt = base;
+    opt.shardMB = max(1ULL, tot.bytes / (4 * 1024 * 1024));
+    const std::string shards = RunDumpBenchmark("dump_sharded", tree, opt);
+    // Холодный с гистограммами стадий: total_ms против dump_cold — цена трассировки
+    DeleteFileW((tree + L"all.txt").c_str());
+    DeleteFileW((tree + L"all.manifest").c_str());
+    opt = base;
+    opt.traceMode = 1;
+    const std::string traced = RunDumpBenchmark("dump_stats", tree, opt);
+    checkDump();
+    // Холодный с elevator-порядком чтений на любом томе: lcn_travel_scan против
+    // lcn_travel_sorted — путь головки до и после сортировки, total_ms — цена запросов экстентов
+    DeleteFileW((tree + L"all.txt").c_str());
+    DeleteFileW((tree + L"all.manifest").c_str());
+    opt = base;
+    opt.elevator = 2;
+    const std::string elevator = RunDumpBenchmark("dump_elevator", tree, opt);
+    checkDump();
+    // Цена детерминированного порядка: холодный дамп на 8 воркерах без подстройки —
+    // total_ms с окном переупорядочивания против порядка готовности
+    opt = base;
+    opt.tune    = false;
+    opt.workers = 8;
+    DeleteFileW((tree + L"all.txt").c_str());
+    DeleteFileW((tree + L"all.manifest").c_str());
+    opt.ordered = false;
+    const std::string unordered8 = RunDumpBenchmark("dump_unordered_8w", tree, opt);
+    DeleteFileW((tree + L"all.txt").c_str());
+    DeleteFileW((tree + L"all.manifest").c_str());
+    opt.ordered = true;
+    const std::string ordered8 = RunDumpBenchmark("dump_ordered_8w", tree, opt);
+    checkDump();
+    const std::string index = RunIndexBenchmark(tree);
+    const std::string micro = RunMicroBenchmarks(dir, rng);
+
+    char head[512];
+    snprintf(head, sizeof(head),
+        "{\n  \"config\": { \"depth\": %d, \"fanout\": %d, \"files\": %d, \"minsize\": %llu, \"maxsize\": %llu,"
+        " \"binary\": %d, \"hex\": %d, \"seed\": %llu },\n"
+        "  \"tree\": { \"files\": %llu, \"bytes\": %llu, \"generate_ms\": %.1f },\n",
+        cfg.depth, cfg.fanout, cfg.files, cfg.minSize, cfg.maxSize, cfg.binaryPct, cfg.hexPct, cfg.seed,
+        tot.files, tot.bytes, genMs);
+
+    std::string json = head;
+    json += "  \"dump\": [\n" + cold + ",\n" + incr + ",\n" + mmapReads + ",\n" + lz4 + ",\n" + shards + ",\n" + traced + ",\n" + elevator +
+        ",\n" + unordered8 + ",\n" + ordered8 + "\n  ],\n";
+    // Холодные dump_cold, dump_mmap_reads, dump_stats, dump_elevator, dump_ordered_8w
+    // и dump_incremental дали один и тот же all.txt
+    json += identical ? "  \"dump_identical\": true,\n" : "  \"dump_identical\": false,\n";
+    json += index;
+    json += "  \"micro\": [" + micro + "\n  ]\n}\n";
+    WriteWholeFile(dir + L"bench.json", json);
+    return identical ? 0 : 1;
 }
 
+// --- ИНДИКАЦИЯ ПРОГРЕССА: ДОЛЯ, СКОРОСТЬ, ETA ---
+// Общая для окна и CLI: раз в тик читает счётчики EngineProgress и собирает строку.
+// Доля — по файлам (обработано + отсеяно по имени) от оценки итога; скорость —
+// по прочитанным байтам (у -list их нет — тогда файлов/с), сглаженная.
+struct ProgressMeter {
+    LONGLONG     tStart = 0, tPrev = 0;
+    ULONGLONG    prevUnits = 0;
+    bool         byBytes   = false;
+    double       rate      = 0.0;    // единиц/с
+    double       fraction  = -1.0;   // -1 — итог ещё неизвестен
+    std::wstring text;
+
+    void start() { tStart = tPrev = QpcNow(); prevUnits = 0; byBytes = false; rate = 0.0; fraction = -1.0; }
+
+    void sample(const EngineProgress& p) {
+        typedef EngineProgress P;
+        const LONGLONG  now   = QpcNow();
+        const ULONGLONG done  = p.get(P::kFilesDone) + p.get(P::kSkippedExcluded);
+        const ULONGLONG bytes = p.get(P::kBytesRead);
+        const ULONGLONG total = p.totalFiles.load(std::memory_order_relaxed);
+        if (bytes && !byBytes) { byBytes = true; prevUnits = 0; rate = 0.0; }
+        const ULONGLONG units = byBytes ? bytes : done;
+        const double    dt    = QpcToMs(now - tPrev) / 1000.0;
+        if (dt >= 0.05) {
+            const double inst = (double)(units - prevUnits) / dt;
+            rate      = rate == 0.0 ? inst : rate * 0.8 + inst * 0.2;
+            prevUnits = units;
+            tPrev     = now;
+        }
+        fraction = total ? min(1.0, (double)done / (double)total) : -1.0;
+
+        wchar_t buf[160];
+        const wchar_t* unit = byBytes ? L"МБ/с" : L"файлов/с";
+        const double   shown = byBytes ? rate / (1024.0 * 1024.0) : rate;
+        if (fraction < 0.0) {
+            swprintf(buf, 160, L"%llu файлов, %llu папок · %.1f %ls",
+                done, p.get(P::kDirs), shown, unit);
+        } else {
+            const double elapsed = QpcToMs(now - tStart) / 1000.0;
+            if (fraction > 0.01 && elapsed > 1.0) {
+                const unsigned eta = (unsigned)(elapsed * (1.0 - fraction) / fraction + 0.5);
+                swprintf(buf, 160, L"%llu / %llu файлов · %.1f %ls · осталось ~%u:%02u",
+                    done, total, shown, unit, eta / 60, eta % 60);
+            } else {
+                swprintf(buf, 160, L"%llu / %llu файлов · %.1f %ls", done, total, shown, unit);
+            }
+        }
+        text = buf;
+    }
+};
+
 // --- GUI: ОКНО ПРОГРЕССА ---
 LRESULT CALLBACK ProgressWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
     static HWND hBtnCancel, hStaticText;
     static HFONT hFont;
+    static ProgressMeter meter;
+    static bool determinate;
     switch (message) {
     case WM_CREATE: {
         INITCOMMONCONTROLSEX icex = { sizeof(icex), ICC_PROGRESS_CLASS };
@@ -545,20 +1525,30 @@ LRESULT CALLBACK ProgressWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM
             WS_VISIBLE | WS_CHILD | BS_PUSHBUTTON,
             295, 65, 80, 25, hWnd, (HMENU)1, NULL, NULL);
         SendMessage(hBtnCancel, WM_SETFONT, (WPARAM)hFont, TRUE);
+        meter.start();
+        determinate = false;
         SetTimer(hWnd, 1, 100, NULL);
         return 0;
     }
     case WM_COMMAND:
         if (LOWORD(wParam) == 1) {
-            g_cancel = true;
+            g_guiEngine->cancel = true;
             SetWindowTextW(hStaticText, L"Отмена...");
             EnableWindow(hBtnCancel, FALSE);
         }
         return 0;
     case WM_TIMER: {
-        std::wstring status;
-        { std::lock_guard<std::mutex> lock(g_statusMutex); status = g_currentStatus; }
-        SetWindowTextW(hStaticText, status.c_str());
+        if (g_guiEngine->cancelled()) return 0;
+        meter.sample(g_guiEngine->progress);
+        // Итог стал известен — marquee сменяется обычной полосой в промилле
+        if (meter.fraction >= 0.0 && !determinate) {
+            SendMessage(g_hProgressBar, PBM_SETMARQUEE, FALSE, 0);
+            SetWindowLongPtrW(g_hProgressBar, GWL_STYLE, GetWindowLongPtrW(g_hProgressBar, GWL_STYLE) & ~PBS_MARQUEE);
+            SendMessage(g_hProgressBar, PBM_SETRANGE32, 0, 1000);
+            determinate = true;
+        }
+        if (determinate) SendMessage(g_hProgressBar, PBM_SETPOS, (WPARAM)(meter.fraction * 1000.0), 0);
+        SetWindowTextW(hStaticText, meter.text.c_str());
         return 0;
     }
     case WM_DESTROY:
@@ -569,7 +1559,7 @@ LRESULT CALLBACK ProgressWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM
     return DefWindowProc(hWnd, message, wParam, lParam);
 }
 
-void ShowProgressAndRun(const std::wstring& folderPath, bool dumpMode) {
+void ShowProgressAndRun(const std::wstring& folderPath, bool dumpMode, const EngineOptions& opt) {
     static bool registered = false;
     if (!registered) {
         WNDCLASSW wc = { 0 };
@@ -588,8 +1578,17 @@ void ShowProgressAndRun(const std::wstring& folderPath, bool dumpMode) {
         dumpMode ? L"Генерация дампа (all.txt)" : L"Сканирование списка",
         WS_POPUP | WS_CAPTION | WS_SYSMENU, x, y, w, h, NULL, NULL, GetModuleHandle(NULL), NULL);
     ShowWindow(g_hProgressWnd, SW_SHOW);
-    g_cancel = false;
-    std::thread worker(dumpMode ? GenerateAllTxt : GenerateFileList, folderPath);
+
+    static EngineContext ctx;   // переживает окно: поток ядра отсоединён
+    ctx.cancel = false;
+    ctx.progress.reset();
+    ctx.opt = opt;
+    g_guiEngine = &ctx;
+    std::thread worker([folderPath, dumpMode]() {
+        if (dumpMode) GenerateAllTxt(ctx, folderPath);
+        else          GenerateFileList(ctx, folderPath);
+        PostMessage(g_hProgressWnd, WM_CLOSE, 0, 0);
+    });
     worker.detach();
     MSG msg;
     while (GetMessage(&msg, NULL, 0, 0)) {
@@ -598,55 +1597,199 @@ void ShowProgressAndRun(const std::wstring& folderPath, bool dumpMode) {
     }
 }
 
+// --- CLI БЕЗ ОКНА: "-list|-dump <папка> out=-|out=<путь>" ---
+// Вывод потоком в stdout ("-"), в файл или в именованный pipe (\\.\pipe\имя) —
+// без промежуточного all.txt/file_list.txt в сканируемой папке:
+//   Helpers.exe -dump D:\src out=- | zstd -o dump.zst
+// Процесс подключается к консоли родителя (AttachConsoleIo), своей не заводит:
+// из cmd/PowerShell работают Ctrl+C и прогресс, без консоли — только вывод.
+// Код возврата: 0 — успех, 1 — отмена или ошибка записи, 2 — вывод не открылся
+// или неверные параметры дампа (RunEngine).
+// Ctrl+C и закрытый читателем pipe отменяют прогон. Прогресс — строкой в stderr,
+// если это консоль (в перенаправленный stderr не пишется).
+
+static EngineContext* g_cliEngine = nullptr;
+
+static BOOL WINAPI CliCtrlHandler(DWORD) {
+    if (g_cliEngine) g_cliEngine->cancel = true;
+    return TRUE;
+}
+
+// Значение "out=" среди аргументов; пусто — аргумента нет
+static std::wstring FindOutArg(LPWSTR* argv, int argc) {
+    for (int i = 0; i < argc; ++i)
+        if (wcsncmp(argv[i], L"out=", 4) == 0) return argv[i] + 4;
+    return std::wstring();
+}
+
+static int RunCli(const std::wstring& folderPath, bool dumpMode, const std::wstring& outSpec, const EngineOptions& opt) {
+    AttachConsoleIo(false);
+    EngineContext ctx;
+    ctx.opt = opt;
+    const bool toStdout = outSpec == L"-";
+    const bool toPipe   = _wcsnicmp(outSpec.c_str(), L"\\\\.\\pipe\\", 9) == 0;
+    ctx.out = toStdout ? GetStdHandle(STD_OUTPUT_HANDLE)
+                       : CreateFileW(outSpec.c_str(), GENERIC_WRITE, 0, NULL, toPipe ? OPEN_EXISTING : CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (ctx.out == INVALID_HANDLE_VALUE || ctx.out == NULL) return 2;
+
+    HANDLE            hErr = GetStdHandle(STD_ERROR_HANDLE);
+    DWORD             mode = 0;
+    std::atomic<bool> running{ true };
+    std::thread       reporter;
+    if (hErr && hErr != INVALID_HANDLE_VALUE && GetConsoleMode(hErr, &mode)) reporter = std::thread([&]() {
+        ProgressMeter meter;
+        meter.start();
+        for (int tick = 1; running.load(); ++tick) {
+            Sleep(100);
+            if (tick % 5) continue;
+            meter.sample(ctx.progress);
+            const std::wstring line = L"\r" + meter.text + L"   ";
+            DWORD w;
+            WriteConsoleW(hErr, line.c_str(), (DWORD)line.size(), &w, NULL);
+        }
+        DWORD w;
+        WriteConsoleW(hErr, L"\n", 1, &w, NULL);
+    });
+
+    g_cliEngine = &ctx;
+    SetConsoleCtrlHandler(CliCtrlHandler, TRUE);
+    const bool ok = dumpMode ? GenerateAllTxt(ctx, folderPath) : GenerateFileList(ctx, folderPath);
+    SetConsoleCtrlHandler(CliCtrlHandler, FALSE);
+    g_cliEngine = nullptr;
+    running = false;
+    if (reporter.joinable()) reporter.join();
+    if (!toStdout) CloseHandle(ctx.out);
+    return ok ? 0 : 1;
+}
+
+// С "out=" — без окна, иначе — окно прогресса и файл в папке.
+// Параметры дампа (ParseDumpArgs) — только у -dump; неверные — код 2 без прогона.
+static int RunEngine(const std::wstring& folderPath, bool dumpMode, LPWSTR* argv, int argc) {
+    EngineOptions opt;
+    const std::wstring out = FindOutArg(argv, argc);
+    if (dumpMode && !ParseDumpArgs(argv, argc, opt)) {
+        if (out.empty())
+            MessageBoxW(NULL, L"Неизвестный трансформ в filter=.\nДопустимо: hex, base64, space, min, all, none",
+                L"Ошибка", MB_OK | MB_ICONERROR);
+        return 2;
+    }
+    if (out.empty()) { ShowProgressAndRun(folderPath, dumpMode, opt); return 0; }
+    return RunCli(folderPath, dumpMode, out, opt);
+}
+
 // --- ЛОГИКА ВСТАВКИ ИЗОБРАЖЕНИЯ ---
+// CF_DIB / CF_DIBV5 → PngSource: 24/32 бит, BI_RGB или BI_BITFIELDS с порядком BGRX.
+// Остальное (палитры, 16 бит, JPEG/PNG внутри DIB) — false, сохранит WIC.
+static bool DibToPngSource(const unsigned char* dib, size_t size, PngSource& src) {
+    BITMAPINFOHEADER bi;
+    if (size < sizeof(bi)) return false;
+    memcpy(&bi, dib, sizeof(bi));
+    if (bi.biSize < sizeof(bi) || bi.biSize > size || bi.biWidth <= 0 || bi.biHeight == 0) return false;
+    if (bi.biBitCount != 24 && bi.biBitCount != 32) return false;
+
+    size_t offset = bi.biSize;
+    if (bi.biCompression == BI_BITFIELDS) {
+        // Маски лежат сразу за 40 байтами заголовка: после него у BITMAPINFOHEADER,
+        // внутри заголовка у V4/V5
+        DWORD masks[3];
+        if (size < 40 + sizeof(masks)) return false;
+        memcpy(masks, dib + 40, sizeof(masks));
+        if (bi.biBitCount != 32 || masks[0] != 0xFF0000 || masks[1] != 0xFF00 || masks[2] != 0xFF) return false;
+        if (bi.biSize == sizeof(bi)) offset += sizeof(masks);
+    } else if (bi.biCompression != BI_RGB) {
+        return false;
+    }
+    offset += (size_t)bi.biClrUsed * 4;
+
+    const int    height = bi.biHeight < 0 ? -bi.biHeight : bi.biHeight;
+    const size_t stride = ((size_t)bi.biWidth * bi.biBitCount + 31) / 32 * 4;
+    if (offset > size || (size - offset) / stride < (size_t)height) return false;
+
+    src.width         = bi.biWidth;
+    src.height        = height;
+    src.bytesPerPixel = bi.biBitCount / 8;
+    // DIB хранится снизу вверх, если высота не отрицательная
+    src.pixels        = dib + offset + (bi.biHeight > 0 ? (size_t)(height - 1) * stride : 0);
+    src.stride        = bi.biHeight > 0 ? -(ptrdiff_t)stride : (ptrdiff_t)stride;
+    return true;
+}
+
+// Пиксели DIB напрямую: фильтры и deflate своим кодером на всех ядрах
+static bool SaveClipboardDib(const std::wstring& path) {
+    HANDLE hDib = GetClipboardData(CF_DIB);
+    if (!hDib) hDib = GetClipboardData(CF_DIBV5);
+    if (!hDib) return false;
+    const unsigned char* dib = (const unsigned char*)GlobalLock(hDib);
+    if (!dib) return false;
+
+    PngSource   src;
+    std::string png;
+    const bool  encoded = DibToPngSource(dib, GlobalSize(hDib), src) && EncodePng(src, png);
+    GlobalUnlock(hDib);
+    if (!encoded) return false;
+
+    OutBuf out;
+    if (!out.open(path.c_str(), 64 * 1024)) return false;
+    out.writeView(png.data(), png.size());
+    out.close();
+    if (out.failed) DeleteFileW(path.c_str());
+    return !out.failed;
+}
+
+// Запасной путь: HBITMAP через WIC (CImage, если и WIC не смог)
+static void SaveBitmapWic(HBITMAP hBitmap, const std::wstring& finalPath) {
+    IWICImagingFactory*    pFactory   = nullptr;
+    IWICBitmap*            pWicBitmap = nullptr;
+    IWICStream*            pStream    = nullptr;
+    IWICBitmapEncoder*     pEncoder   = nullptr;
+    IWICBitmapFrameEncode* pFrame     = nullptr;
+    IPropertyBag2*         pProps     = nullptr;
+
+    bool saved = false;
+    if (SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&pFactory))) &&
+        SUCCEEDED(pFactory->CreateBitmapFromHBITMAP(hBitmap, nullptr, WICBitmapIgnoreAlpha, &pWicBitmap)) &&
+        SUCCEEDED(pFactory->CreateStream(&pStream)) &&
+        SUCCEEDED(pStream->InitializeFromFilename(finalPath.c_str(), GENERIC_WRITE)) &&
+        SUCCEEDED(pFactory->CreateEncoder(GUID_ContainerFormatPng, nullptr, &pEncoder)) &&
+        SUCCEEDED(pEncoder->Initialize(pStream, WICBitmapEncoderNoCache)) &&
+        SUCCEEDED(pEncoder->CreateNewFrame(&pFrame, &pProps)))
+    {
+        PROPBAG2 opt = {};
+        opt.pstrName = const_cast<LPOLESTR>(L"CompressionQuality");
+        VARIANT val  = {}; val.vt = VT_R4; val.fltVal = 0.0f;
+        pProps->Write(1, &opt, &val);
+        UINT w = 0, h = 0;
+        pWicBitmap->GetSize(&w, &h);
+        WICPixelFormatGUID fmt = GUID_WICPixelFormat24bppBGR;
+        if (SUCCEEDED(pFrame->Initialize(pProps)) &&
+            SUCCEEDED(pFrame->SetSize(w, h)) &&
+            SUCCEEDED(pFrame->SetPixelFormat(&fmt)) &&
+            SUCCEEDED(pFrame->WriteSource(pWicBitmap, nullptr)) &&
+            SUCCEEDED(pFrame->Commit()) &&
+            SUCCEEDED(pEncoder->Commit()))
+            saved = true;
+    }
+    if (pProps)     pProps->Release();
+    if (pFrame)     pFrame->Release();
+    if (pEncoder)   pEncoder->Release();
+    if (pStream)    pStream->Release();
+    if (pWicBitmap) pWicBitmap->Release();
+    if (pFactory)   pFactory->Release();
+    if (!saved) { CImage img; img.Attach(hBitmap); img.Save(finalPath.c_str(), Gdiplus::ImageFormatPNG); img.Detach(); }
+}
+
 void PasteImage(const std::wstring& folderPath) {
     if (!OpenClipboard(NULL)) return;
-    HBITMAP hBitmap = (HBITMAP)GetClipboardData(CF_BITMAP);
-    if (hBitmap) {
+    if (IsClipboardFormatAvailable(CF_DIB) || IsClipboardFormatAvailable(CF_BITMAP)) {
         std::wstring targetDir = folderPath;
         if (!targetDir.empty() && targetDir.back() != L'\\') targetDir += L'\\';
         std::wstring finalPath = targetDir + L"screenshot.png";
         for (int i = 2; FileExists(finalPath); ++i)
             finalPath = targetDir + L"screenshot (" + std::to_wstring(i) + L").png";
 
-        IWICImagingFactory*    pFactory   = nullptr;
-        IWICBitmap*            pWicBitmap = nullptr;
-        IWICStream*            pStream    = nullptr;
-        IWICBitmapEncoder*     pEncoder   = nullptr;
-        IWICBitmapFrameEncode* pFrame     = nullptr;
-        IPropertyBag2*         pProps     = nullptr;
-
-        bool saved = false;
-        if (SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&pFactory))) &&
-            SUCCEEDED(pFactory->CreateBitmapFromHBITMAP(hBitmap, nullptr, WICBitmapIgnoreAlpha, &pWicBitmap)) &&
-            SUCCEEDED(pFactory->CreateStream(&pStream)) &&
-            SUCCEEDED(pStream->InitializeFromFilename(finalPath.c_str(), GENERIC_WRITE)) &&
-            SUCCEEDED(pFactory->CreateEncoder(GUID_ContainerFormatPng, nullptr, &pEncoder)) &&
-            SUCCEEDED(pEncoder->Initialize(pStream, WICBitmapEncoderNoCache)) &&
-            SUCCEEDED(pEncoder->CreateNewFrame(&pFrame, &pProps)))
-        {
-            PROPBAG2 opt = {};
-            opt.pstrName = const_cast<LPOLESTR>(L"CompressionQuality");
-            VARIANT val  = {}; val.vt = VT_R4; val.fltVal = 0.0f;
-            pProps->Write(1, &opt, &val);
-            UINT w = 0, h = 0;
-            pWicBitmap->GetSize(&w, &h);
-            WICPixelFormatGUID fmt = GUID_WICPixelFormat24bppBGR;
-            if (SUCCEEDED(pFrame->Initialize(pProps)) &&
-                SUCCEEDED(pFrame->SetSize(w, h)) &&
-                SUCCEEDED(pFrame->SetPixelFormat(&fmt)) &&
-                SUCCEEDED(pFrame->WriteSource(pWicBitmap, nullptr)) &&
-                SUCCEEDED(pFrame->Commit()) &&
-                SUCCEEDED(pEncoder->Commit()))
-                saved = true;
-        }
-        if (pProps)     pProps->Release();
-        if (pFrame)     pFrame->Release();
-        if (pEncoder)   pEncoder->Release();
-        if (pStream)    pStream->Release();
-        if (pWicBitmap) pWicBitmap->Release();
-        if (pFactory)   pFactory->Release();
-        if (!saved) { CImage img; img.Attach(hBitmap); img.Save(finalPath.c_str(), Gdiplus::ImageFormatPNG); img.Detach(); }
+        HBITMAP hBitmap = SaveClipboardDib(finalPath) ? nullptr : (HBITMAP)GetClipboardData(CF_BITMAP);
+        if (hBitmap) SaveBitmapWic(hBitmap, finalPath);
     }
     CloseClipboard();
 }
@@ -691,19 +1834,23 @@ int main() {
 #else
 #error AVX2 is NOT enabled! Check project settings.
 #endif
-    int args;
+    int args, rc = 0;
     LPWSTR* argList = CommandLineToArgvW(GetCommandLineW(), &args);
     if (args >= 3) {
         std::wstring flag = argList[1];
         std::wstring path = argList[2];
         CoInitialize(NULL);
         if      (flag == L"-paste") PasteImage(path);
-        else if (flag == L"-list")  ShowProgressAndRun(path, false);
-        else if (flag == L"-dump")  ShowProgressAndRun(path, true);
+        else if (flag == L"-list")  rc = RunEngine(path, false, argList + 3, args - 3);
+        else if (flag == L"-dump")  rc = RunEngine(path, true, argList + 3, args - 3);
+        else if (flag == L"-bench") rc = RunBenchmarks(path, argList + 3, args - 3);
+        else if (flag == L"-selftest") rc = RunSelfTest(path);
+        else if (flag == L"-query") rc = QueryFileIndex(path, argList + 3, args - 3);
+        else if (flag == L"-watch") rc = RunWatch(path, argList + 3, args - 3);
         CoUninitialize();
     } else {
         RegisterMenu();
     }
     if (argList) LocalFree(argList);
-    return 0;
+    return rc;
 }
@@ -0,0 +1,90 @@
+// Точка входа сборки без Windows (CMakeLists.txt): консольные режимы ядра.
+// Окно, -watch, -bench, -query, -paste и реестр — только в Helpers.cpp.
+#include "Platform.h"
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Common.h"
+#include "Engine.h"
+#include "SelfTest.h"
+
+static EngineContext* volatile g_cliEngine = nullptr;   // прогон, который отменяет Ctrl+C
+
+// Только флаг: ядро само доходит до точки отмены, all.txt остаётся прежним
+static void CliSignalHandler(int) {
+    if (EngineContext* ctx = g_cliEngine) ctx->cancel.store(true, std::memory_order_relaxed);
+}
+
+// Аргумент командной строки (UTF-8) → путь ядра: UTF-32 и '\\' вместо '/'
+static std::wstring NativeArg(const char* s, bool path) {
+    std::wstring w((size_t)MultiByteToWideChar(CP_UTF8, 0, s, -1, nullptr, 0), L'\0');
+    if (!w.empty()) w.resize((size_t)MultiByteToWideChar(CP_UTF8, 0, s, -1, &w[0], (int)w.size()) - 1);
+    if (path) for (wchar_t& c : w) if (c == L'/') c = L'\\';
+    return w;
+}
+
+static std::wstring FindOutArg(LPWSTR* argv, int argc) {
+    for (int i = 0; i < argc; ++i)
+        if (wcsncmp(argv[i], L"out=", 4) == 0) return argv[i] + 4;
+    return std::wstring();
+}
+
+// Без "out=" — файл в папке, с "out=-" — stdout, иначе — файл по пути.
+// Коды возврата — как у RunCli: 0 — готово, 1 — отмена или ошибка записи, 2 — аргументы.
+static int RunEngine(const std::wstring& folderPath, bool dumpMode, LPWSTR* argv, int argc) {
+    EngineContext ctx;
+    if (dumpMode && !ParseDumpArgs(argv, argc, ctx.opt)) {
+        fputs("Неизвестный трансформ в filter=. Допустимо: hex, base64, space, min, all, none\n", stderr);
+        return 2;
+    }
+    std::wstring out = FindOutArg(argv, argc);
+    const bool toStdout = out == L"-";
+    if (!out.empty()) {
+        for (wchar_t& c : out) if (c == L'/') c = L'\\';
+        ctx.out = toStdout ? GetStdHandle(STD_OUTPUT_HANDLE)
+                           : CreateFileW(out.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                                 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (ctx.out == INVALID_HANDLE_VALUE || ctx.out == NULL) return 2;
+    }
+
+    g_cliEngine = &ctx;
+    signal(SIGINT, CliSignalHandler);
+    signal(SIGTERM, CliSignalHandler);
+    const bool ok = dumpMode ? GenerateAllTxt(ctx, folderPath) : GenerateFileList(ctx, folderPath);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    g_cliEngine = nullptr;
+    if (!out.empty() && !toStdout) CloseHandle(ctx.out);
+    return ok ? 0 : 1;
+}
+
+// --- ТОЧКА ВХОДА ---
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fputs("usage: helpers -list|-dump <папка> [out=-|out=<путь>] [параметры -dump]\n"
+              "       helpers -selftest <папка>\n", stderr);
+        return 2;
+    }
+    // Закрытый читатель pipe — ошибка записи (прогон вернёт 1), а не смерть процесса
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::wstring> args;
+    for (int i = 3; i < argc; ++i) args.push_back(NativeArg(argv[i], false));
+    std::vector<LPWSTR> argList;
+    for (std::wstring& a : args) argList.push_back(&a[0]);
+
+    const std::string  flag = argv[1];
+    const std::wstring path = NativeArg(argv[2], true);
+    if (flag == "-list") return RunEngine(path, false, argList.data(), (int)argList.size());
+    if (flag == "-dump") return RunEngine(path, true, argList.data(), (int)argList.size());
+    if (flag == "-selftest") {
+        const int rc = RunSelfTest(path);
+        std::string report;
+        ReadWholeFile((path + (path.empty() || path.back() == L'\\' ? L"" : L"\\") + L"selftest.txt").c_str(), report);
+        fputs(report.c_str(), rc ? stderr : stdout);
+        return rc;
+    }
+    fprintf(stderr, "unknown mode: %s\n", argv[1]);
+    return 2;
+}
@@ -0,0 +1,191 @@
+#include "Ignore.h"
+#include <cstring>
+#include "Common.h"
+
+bool GlobMatch(const wchar_t* p, const wchar_t* pe, const wchar_t* s, const wchar_t* se) {
+    while (p < pe) {
+        if (*p == L'*') {
+            if (p + 1 < pe && p[1] == L'*') {
+                p += 2;
+                if (p < pe && *p == L'/') {                 // "**/" — ноль и более директорий
+                    ++p;
+                    for (const wchar_t* t = s;; ++t) {
+                        if (GlobMatch(p, pe, t, se)) return true;
+                        while (t < se && *t != L'/') ++t;
+                        if (t == se) return false;
+                    }
+                }
+                for (const wchar_t* t = s; t <= se; ++t)     // "**" в конце или внутри имени
+                    if (GlobMatch(p, pe, t, se)) return true;
+                return false;
+            }
+            ++p;
+            for (const wchar_t* t = s;; ++t) {
+                if (GlobMatch(p, pe, t, se)) return true;
+                if (t == se || *t == L'/') return false;
+            }
+        }
+        if (s == se) return false;
+        const wchar_t c = *s;
+        if (*p == L'?') {
+            if (c == L'/') return false;
+        } else if (*p == L'[') {
+            const wchar_t* q = p + 1;
+            const bool neg = q < pe && (*q == L'!' || *q == L'^');
+            if (neg) ++q;
+            const wchar_t* first = q;
+            bool hit = false;
+            while (q < pe && (*q != L']' || q == first)) {
+                wchar_t lo = *q;
+                if (lo == L'\\' && q + 1 < pe) lo = *++q;
+                if (q + 2 < pe && q[1] == L'-' && q[2] != L']') { hit |= (c >= lo && c <= q[2]); q += 3; }
+                else                                             { hit |= (c == lo); ++q; }
+            }
+            if (q == pe) {                                   // нет ']' — обычный символ '['
+                if (c != L'[') return false;
+            } else {
+                if (hit == neg || c == L'/') return false;
+                p = q;
+            }
+        } else {
+            wchar_t pc = *p;
+            if (pc == L'\\' && p + 1 < pe) pc = *++p;
+            if (pc != c) return false;
+        }
+        ++p; ++s;
+    }
+    return s == se;
+}
+
+int IgnoreRules::child(int node, wchar_t c) {
+    const ULONGLONG key = ((ULONGLONG)node << 32) | (unsigned)c;
+    auto it = edges.find(key);
+    if (it != edges.end()) return it->second;
+    nodes.emplace_back();
+    edges.emplace(key, (int)nodes.size() - 1);
+    return (int)nodes.size() - 1;
+}
+
+void IgnoreRules::add(std::wstring pat) {
+    while (!pat.empty() && (pat.back() == L' ' || pat.back() == L'\t' || pat.back() == L'\r')) {
+        if (pat.back() == L' ' && pat.size() >= 2 && pat[pat.size() - 2] == L'\\') { pat.erase(pat.size() - 2, 1); break; }
+        pat.pop_back();
+    }
+    if (pat.empty() || pat[0] == L'#') return;
+
+    bool neg = false;
+    if (pat[0] == L'!') { neg = true; pat.erase(0, 1); }
+    else if (pat[0] == L'\\' && pat.size() > 1 && (pat[1] == L'#' || pat[1] == L'!')) pat.erase(0, 1);
+
+    bool dirOnly = false;
+    if (!pat.empty() && pat.back() == L'/') { dirOnly = true; pat.pop_back(); }
+    bool anchored = false;
+    if (!pat.empty() && pat[0] == L'/') { anchored = true; pat.erase(0, 1); }
+    if (pat.empty()) return;
+    if (!anchored && pat.size() > 3 && pat.compare(0, 3, L"**/") == 0 && pat.find(L'/', 3) == std::wstring::npos)
+        pat.erase(0, 3);                                 // "**/x" ≡ "x"
+
+    for (wchar_t& c : pat) c = FoldChar(c);
+    const bool path  = anchored || pat.find(L'/') != std::wstring::npos;
+    const int  index = (int)negate.size();
+    negate.push_back(neg);
+
+    if (!path) {
+        const bool     star = pat[0] == L'*';
+        const wchar_t* lit  = pat.c_str() + (star ? 1 : 0);
+        if (*lit && !wcspbrk(lit, L"*?[\\")) {
+            int node = 0;
+            for (const wchar_t* c = pat.c_str() + pat.size(); c-- != lit;) node = child(node, *c);
+            int* slot = star ? nodes[node].suffix : nodes[node].exact;
+            slot[1] = index;
+            if (!dirOnly) slot[0] = index;
+            return;
+        }
+    }
+    globs.push_back({ pat, index, dirOnly, path });
+}
+
+void IgnoreRules::parse(const char* text, size_t len) {
+    if (len >= 3 && memcmp(text, "\xEF\xBB\xBF", 3) == 0) { text += 3; len -= 3; }
+    std::wstring line;
+    while (len) {
+        const char*  nl = (const char*)memchr(text, '\n', len);
+        const size_t n  = nl ? (size_t)(nl - text) : len;
+        if (n) {
+            line.resize(n);
+            line.resize((size_t)MultiByteToWideChar(CP_UTF8, 0, text, (int)n, &line[0], (int)n));
+            add(line);
+        }
+        const size_t step = nl ? n + 1 : n;
+        text += step; len -= step;
+    }
+}
+
+int IgnoreRules::match(const wchar_t* name, size_t nameLen, const wchar_t* rel, size_t relLen, bool isDir) const {
+    const int k = isDir ? 1 : 0;
+    int best = -1;
+    int node = 0;
+    for (size_t i = nameLen; i-- > 0;) {
+        auto it = edges.find(((ULONGLONG)node << 32) | (unsigned)name[i]);
+        if (it == edges.end()) { node = -1; break; }
+        node = it->second;
+        best = max(best, nodes[node].suffix[k]);
+    }
+    if (node >= 0) best = max(best, nodes[node].exact[k]);
+
+    for (auto g = globs.rbegin(); g != globs.rend() && g->index > best; ++g) {
+        if (g->dirOnly && !isDir) continue;
+        const wchar_t* s  = g->path ? rel : name;
+        const size_t   sl = g->path ? relLen : nameLen;
+        if (GlobMatch(g->pat.c_str(), g->pat.c_str() + g->pat.size(), s, s + sl)) { best = g->index; break; }
+    }
+    return best;
+}
+
+bool IsIgnored(const IgnoreScope* sc, const wchar_t* name, size_t nameLen, const std::wstring& rel, bool isDir) {
+    for (; sc; sc = sc->parent.get()) {
+        const int r = sc->rules.match(name, nameLen, rel.c_str() + sc->baseLen, rel.size() - sc->baseLen, isDir);
+        if (r >= 0) return !sc->rules.negate[r];
+    }
+    return false;
+}
+
+void LoadIgnoreFile(const std::wstring& path, IgnoreRules& rules) {
+    std::string text;
+    if (ReadWholeFile(path.c_str(), text)) rules.parse(text.data(), text.size());
+}
+
+std::shared_ptr<const IgnoreScope> LoadBaseIgnore() {
+    static const char kDefaults[] = ".git\n.vs/\nnode_modules/\nbuild/\nout/\nx64/\n";
+    auto sc = std::make_shared<IgnoreScope>();
+    sc->rules.parse(kDefaults, sizeof(kDefaults) - 1);
+
+    wchar_t home[MAX_PATH];
+#ifdef _WIN32
+    const DWORD n = GetEnvironmentVariableW(L"USERPROFILE", home, MAX_PATH);
+#else
+    const DWORD n = GetEnvironmentVariableW(L"HOME", home, MAX_PATH);
+#endif
+    if (n && n < MAX_PATH) LoadIgnoreFile(std::wstring(home) + L"\\.helpersignore", sc->rules);
+    return sc;
+}
+
+bool IsExcludedExtension(const wchar_t* filename) {
+    static const IgnoreRules kRules = []() {
+        static const wchar_t* const kExts[] = {
+            L".bin",  L".bmp",   L".db",    L".dll",  L".exe",
+            L".filters", L".gif",L".ipch",  L".iso",  L".jpg",
+            L".jpeg", L".lib",   L".ncb",   L".obj",  L".opensdf",
+            L".pdb",  L".png",   L".sdf",   L".sqlite",L".sln",
+            L".suo",  L".tlog",  L".user",  L".vcxproj"
+        };
+        IgnoreRules r;
+        for (auto e : kExts) r.add(std::wstring(L"*") + e);
+        return r;
+    }();
+
+    wchar_t folded[MAX_PATH];
+    size_t  n = 0;
+    for (; filename[n] && n < MAX_PATH; ++n) folded[n] = FoldChar(filename[n]);
+    return kRules.match(folded, n, folded, n, false) >= 0;
+}
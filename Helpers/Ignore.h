@@ -0,0 +1,85 @@
+#pragma once
+#include "Platform.h"
+#include <cwctype>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// --- ИГНОР-ПРАВИЛА: .gitignore / .ignore + ПОЛЬЗОВАТЕЛЬСКИЙ КОНФИГ ---
+//
+// Синтаксис и приоритеты — как у git: последнее совпавшее правило побеждает,
+// файл правил глубже по дереву важнее родительского, '!' возвращает запись,
+// "x/" — только директории, '/' в начале или середине привязывает шаблон к
+// директории файла правил. В одной директории .ignore важнее .gitignore.
+// Регистр не учитывается (как в файловой системе Windows).
+//
+// Базовый уровень (ниже любого файла в дереве): встроенные .git, .vs, node_modules,
+// build, out, x64 и затем %USERPROFILE%\.helpersignore (на POSIX — ~/.helpersignore):
+// там их можно вернуть ("!build/").
+//
+// Шаблоны компилируются один раз на файл правил:
+//   "name" и "*suffix" — в общий trie по перевёрнутой строке: один проход по имени
+//   с конца находит последнее совпавшее правило обоих видов за O(длины имени);
+//   остальные — glob-и, их проверяем с конца и только пока номер старше найденного.
+// Исключённая директория не получает DirNode — FindFirstFileExW на неё не вызывается.
+
+__forceinline wchar_t FoldChar(wchar_t c) {
+    if (c < 128) return (c >= L'A' && c <= L'Z') ? (wchar_t)(c + 32) : c;
+    return (wchar_t)towlower(c);
+}
+
+// '*' и '?' не переходят через '/', "**" — через любое число уровней, [...] — класс
+bool GlobMatch(const wchar_t* p, const wchar_t* pe, const wchar_t* s, const wchar_t* se);
+
+// Скомпилированный набор правил одного файла (или базового уровня)
+struct IgnoreRules {
+    struct Node {                          // узел trie по перевёрнутому литералу
+        int exact[2]  = { -1, -1 };        // номер правила: [0] — для файлов, [1] — для директорий
+        int suffix[2] = { -1, -1 };
+    };
+    struct Glob {
+        std::wstring pat;
+        int          index;
+        bool         dirOnly;
+        bool         path;                 // с '/': сравнивается путь от директории правил
+    };
+
+    std::vector<Node>                  nodes{ 1 };
+    std::unordered_map<ULONGLONG, int> edges;      // (узел << 32 | символ) → узел
+    std::vector<Glob>                  globs;
+    std::vector<bool>                  negate;     // по номеру правила
+
+    bool empty() const { return negate.empty(); }
+
+    int child(int node, wchar_t c);
+
+    // Одна строка в формате .gitignore
+    void add(std::wstring pat);
+
+    // Текст файла правил (UTF-8, BOM допускается)
+    void parse(const char* text, size_t len);
+
+    // Номер последнего совпавшего правила или -1. name и rel — в FoldChar-регистре,
+    // rel — путь от директории правил через '/', name — его последний компонент.
+    int match(const wchar_t* name, size_t nameLen, const wchar_t* rel, size_t relLen, bool isDir) const;
+};
+
+// Правила одной директории; цепочка parent ведёт к базовому уровню
+struct IgnoreScope {
+    std::shared_ptr<const IgnoreScope> parent;
+    size_t                             baseLen = 0;   // длина относительного пути директории правил
+    IgnoreRules                        rules;
+};
+
+// rel — путь записи от корня обхода (FoldChar, '/'), name — его последний компонент
+bool IsIgnored(const IgnoreScope* sc, const wchar_t* name, size_t nameLen, const std::wstring& rel, bool isDir);
+
+// Дописывает в rules правила файла path; файла нет — ничего
+void LoadIgnoreFile(const std::wstring& path, IgnoreRules& rules);
+
+// Базовый уровень: встроенные правила, поверх — пользовательский конфиг
+std::shared_ptr<const IgnoreScope> LoadBaseIgnore();
+
+// Расширения, которые не попадают в дамп: те же "*.ext" в trie — O(длины имени)
+bool IsExcludedExtension(const wchar_t* filename);
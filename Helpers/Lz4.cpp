@@ -0,0 +1,141 @@
+#include "Lz4.h"
+#include <cstring>
+
+static __forceinline unsigned Lz4Read32(const unsigned char* p) { unsigned v; memcpy(&v, p, 4); return v; }
+static __forceinline unsigned Lz4Hash(unsigned v) { return (v * 2654435761u) >> (32 - kLz4HashLog); }
+static __forceinline size_t   Lz4Bound(size_t n)  { return n + n / 255 + 16; }
+
+// Сжимает src[0..n) (n ≤ kLz4Block) в dst ёмкостью Lz4Bound(n); table — 1 << kLz4HashLog
+static size_t Lz4CompressBlock(const char* source, size_t n, char* dest, unsigned* table) {
+    typedef unsigned char BYTE;
+    const BYTE* const src        = (const BYTE*)source;
+    const BYTE* const iend       = src + n;
+    const BYTE* const mflimit    = n > 12 ? iend - 12 : src;   // match начинается не ближе 12 байт к концу
+    const BYTE* const matchlimit = n > 5  ? iend - 5  : src;   // последние 5 байт — всегда литералы
+    const BYTE*       ip         = src;
+    const BYTE*       anchor     = src;
+    BYTE*             op         = (BYTE*)dest;
+
+    auto putLen = [&](size_t len) {
+        for (; len >= 255; len -= 255) *op++ = 255;
+        *op++ = (BYTE)len;
+    };
+    auto found = [&](const BYTE* m, const BYTE* p, unsigned seq) {
+        return m < p && p - m <= 65535 && Lz4Read32(m) == seq;
+    };
+
+    memset(table, 0, sizeof(unsigned) << kLz4HashLog);
+    if (n >= 13) {
+        for (;;) {
+            // Поиск совпадения; на несжимаемых участках шаг растёт
+            const BYTE* match;
+            unsigned    attempts = 1 << 6;
+            for (;;) {
+                if (ip > mflimit) goto lastLiterals;
+                const unsigned seq = Lz4Read32(ip);
+                const unsigned h   = Lz4Hash(seq);
+                match    = src + table[h];
+                table[h] = (unsigned)(ip - src);
+                if (found(match, ip, seq)) break;
+                ip += attempts++ >> 6;
+            }
+            while (ip > anchor && match > src && ip[-1] == match[-1]) { --ip; --match; }
+
+            BYTE*        token = op++;
+            const size_t lit   = (size_t)(ip - anchor);
+            if (lit >= 15) { *token = 15 << 4; putLen(lit - 15); } else *token = (BYTE)(lit << 4);
+            memcpy(op, anchor, lit);
+            op += lit;
+
+            for (;;) {
+                const unsigned off = (unsigned)(ip - match);
+                *op++ = (BYTE)off;
+                *op++ = (BYTE)(off >> 8);
+
+                ip += 4; match += 4;
+                const BYTE* start = ip;
+                while (ip + 4 <= matchlimit) {
+                    const unsigned x = Lz4Read32(ip) ^ Lz4Read32(match);
+                    if (x) { unsigned long i; _BitScanForward(&i, x); ip += i >> 3; goto matchEnd; }
+                    ip += 4; match += 4;
+                }
+                while (ip < matchlimit && *ip == *match) { ++ip; ++match; }
+            matchEnd:
+                const size_t ml = (size_t)(ip - start);
+                if (ml >= 15) { *token += 15; putLen(ml - 15); } else *token += (BYTE)ml;
+                anchor = ip;
+                if (ip > mflimit) goto lastLiterals;
+
+                // Следующий match сразу, без литералов между ними
+                table[Lz4Hash(Lz4Read32(ip - 2))] = (unsigned)(ip - 2 - src);
+                const unsigned seq = Lz4Read32(ip);
+                const unsigned h   = Lz4Hash(seq);
+                match    = src + table[h];
+                table[h] = (unsigned)(ip - src);
+                if (!found(match, ip, seq)) break;
+                token  = op++;
+                *token = 0;
+            }
+            ++ip;
+        }
+    }
+
+lastLiterals:
+    const size_t lit   = (size_t)(iend - anchor);
+    BYTE*        token = op++;
+    if (lit >= 15) { *token = 15 << 4; putLen(lit - 15); } else *token = (BYTE)(lit << 4);
+    memcpy(op, anchor, lit);
+    op += lit;
+    return (size_t)(op - (BYTE*)dest);
+}
+
+unsigned char Lz4Frame::HeaderChecksum(const unsigned char* p, size_t n) {
+    unsigned h = 374761393u + (unsigned)n;
+    for (size_t i = 0; i < n; ++i) {
+        h += p[i] * 374761393u;
+        h  = ((h << 11) | (h >> 21)) * 2654435761u;
+    }
+    h ^= h >> 15; h *= 2246822519u;
+    h ^= h >> 13; h *= 3266489917u;
+    h ^= h >> 16;
+    return (unsigned char)(h >> 8);
+}
+
+void Lz4Frame::compress(const char* src, size_t n, std::string& out) {
+    static const unsigned char kDesc[2] = { 0x60, 0x70 };
+    static const unsigned char kHeader[7] = {
+        0x04, 0x22, 0x4D, 0x18, kDesc[0], kDesc[1], HeaderChecksum(kDesc, 2)
+    };
+    out.append((const char*)kHeader, sizeof(kHeader));
+
+    for (size_t done = 0; done < n;) {
+        const size_t len = min(n - done, kLz4Block);
+        const size_t at  = out.size();
+        out.resize(at + 4 + Lz4Bound(len));
+        size_t   csz  = Lz4CompressBlock(src + done, len, &out[at + 4], table.data());
+        unsigned word = (unsigned)csz;
+        if (csz >= len) {                                // не сжалось — храним как есть
+            memcpy(&out[at + 4], src + done, len);
+            csz  = len;
+            word = (unsigned)len | 0x80000000u;
+        }
+        memcpy(&out[at], &word, 4);
+        out.resize(at + 4 + csz);
+        done += len;
+    }
+    out.append(4, '\0');                                 // EndMark
+}
+
+void Lz4WriteIndex(OutBuf& out, const std::vector<Lz4IndexEntry>& index, ULONGLONG rawTotal) {
+    const ULONGLONG count   = index.size();
+    const unsigned  payload = (unsigned)(8 + 8 + count * 16 + 8 + 4 + 4);
+    const unsigned  magic   = 0x184D2A5Eu;
+    out.write((const char*)&magic, 4);
+    out.write((const char*)&payload, 4);
+    out.write("HLPLZ4X1", 8);
+    out.write((const char*)&count, 8);
+    for (const Lz4IndexEntry& e : index) out.write((const char*)&e, 16);
+    out.write((const char*)&rawTotal, 8);
+    out.write((const char*)&payload, 4);
+    out.write("LZ4X", 4);
+}
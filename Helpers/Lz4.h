@@ -0,0 +1,72 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+#include "OutBuf.h"
+
+// --- LZ4: БЛОЧНОЕ СЖАТИЕ И КАДРЫ (режим "-dump <папка> lz4") ---
+// Минимальный кодер формата LZ4 (block + frame), без внешних зависимостей:
+// greedy-поиск по хэш-таблице 4-байтных последовательностей, как у lz4 -1.
+// Кадры независимы, поэтому кадры разных воркеров просто склеиваются — результат
+// читает обычный "lz4 -d". Последним идёт skippable-кадр с индексом кадров.
+
+static const size_t kLz4Block   = 4 * 1024 * 1024;   // BD = 7: блоки до 4 МБ
+static const int    kLz4HashLog = 16;
+
+// Кадр: magic | FLG BD HC | блоки { u32 размер (старший бит — без сжатия), данные } | u32 0.
+// FLG = 0x60: версия 01, независимые блоки, без контрольных сумм контента.
+struct Lz4Frame {
+    std::vector<unsigned> table = std::vector<unsigned>((size_t)1 << kLz4HashLog);
+
+    // HC — второй байт xxh32(FLG, BD); для коротких данных хватает хвостовых раундов
+    static unsigned char HeaderChecksum(const unsigned char* p, size_t n);
+
+    // Дописывает в out кадр с src[0..n)
+    void compress(const char* src, size_t n, std::string& out);
+};
+
+// Индекс кадров — skippable-кадр в конце файла, его игнорирует любой LZ4-декодер:
+//   u32 0x184D2A5E | u32 размер payload |
+//   payload: "HLPLZ4X1" | u64 N | N × { u64 смещение кадра в файле, u64 смещение в тексте }
+//            | u64 длина текста | u32 размер payload | "LZ4X"
+// Читатель берёт последние 8 байт, отступает на размер payload + 8 — и может
+// распаковать кадр, содержащий любое смещение из all.manifest.
+struct Lz4IndexEntry {
+    ULONGLONG comp;
+    ULONGLONG raw;
+};
+
+// Приёмник для StreamCleanFile в режиме lz4: копит текст до kLz4Block и пишет кадрами
+struct Lz4Out {
+    OutBuf&                     out;
+    Lz4Frame&                   lz;
+    std::vector<Lz4IndexEntry>& index;
+    ULONGLONG&                  compPos;    // позиция в сжатом файле
+    ULONGLONG                   rawPos;     // смещение начала raw в тексте
+    std::string                 raw, frame;
+
+    void write(const char* p, DWORD n) { writeView(p, n); }
+
+    void writeView(const char* p, size_t n) {
+        while (n) {
+            const size_t take = min(n, kLz4Block - raw.size());
+            raw.append(p, take);
+            p += take; n -= take;
+            if (raw.size() == kLz4Block) flush();
+        }
+    }
+
+    void flush() {
+        if (raw.empty()) return;
+        frame.clear();
+        lz.compress(raw.data(), raw.size(), frame);
+        index.push_back({ compPos, rawPos });
+        out.write(frame.data(), (DWORD)frame.size());
+        compPos += frame.size();
+        rawPos  += raw.size();
+        raw.clear();
+    }
+};
+
+// Индекс кадров в out; rawTotal — длина всего текста
+void Lz4WriteIndex(OutBuf& out, const std::vector<Lz4IndexEntry>& index, ULONGLONG rawTotal);
@@ -0,0 +1,68 @@
+#include "Manifest.h"
+#include <cstring>
+#include "Common.h"
+#include "OutBuf.h"
+
+static const char kManifestMagic[8] = { 'H','L','P','M','A','N','3','\0' };
+
+bool LoadManifest(const wchar_t* path, ULONGLONG allSize, unsigned contentFilters, Manifest& m) {
+    std::string data;
+    if (!ReadWholeFile(path, data) || data.size() < 32) return false;
+    if (memcmp(data.data(), kManifestMagic, 8) != 0) return false;
+
+    const char* p   = data.data() + 8;
+    const char* end = data.data() + data.size();
+    auto rd64 = [&](ULONGLONG& v) {
+        if (end - p < 8) return false;
+        memcpy(&v, p, 8); p += 8;
+        return true;
+    };
+
+    ULONGLONG storedSize = 0, count = 0, filters = 0;
+    rd64(storedSize); rd64(count); rd64(filters);
+    if (storedSize != allSize || filters != contentFilters) return false;
+
+    m.reserve((size_t)count);
+    std::wstring key;
+    for (ULONGLONG i = 0; i < count; ++i) {
+        DWORD len;
+        if (end - p < 4) return false;
+        memcpy(&len, p, 4); p += 4;
+        if ((ULONGLONG)(end - p) < len) return false;
+
+        ManifestEntry e;
+        e.relUtf8.assign(p, len); p += len;
+        if (!rd64(e.size) || !rd64(e.mtime) || !rd64(e.hash) || !rd64(e.offset) || !rd64(e.length) || !rd64(e.flags)) return false;
+        if (e.offset + e.length > allSize) return false;
+
+        int wl = MultiByteToWideChar(CP_UTF8, 0, e.relUtf8.data(), (int)len, NULL, 0);
+        if (wl <= 0) continue;
+        key.resize((size_t)wl);
+        MultiByteToWideChar(CP_UTF8, 0, e.relUtf8.data(), (int)len, &key[0], wl);
+        m.emplace(key, std::move(e));
+    }
+    return true;
+}
+
+bool SaveManifest(const wchar_t* path, ULONGLONG allSize, unsigned contentFilters,
+                  const std::vector<ManifestEntry>& entries) {
+    OutBuf mf;
+    if (!mf.open(path, 1 * 1024 * 1024)) return false;
+
+    const ULONGLONG count   = entries.size();
+    const ULONGLONG filters = contentFilters;
+    mf.write(kManifestMagic, 8);
+    mf.write((const char*)&allSize, 8);
+    mf.write((const char*)&count, 8);
+    mf.write((const char*)&filters, 8);
+    for (auto& e : entries) {
+        DWORD len = (DWORD)e.relUtf8.size();
+        mf.write((const char*)&len, 4);
+        mf.write(e.relUtf8.data(), len);
+        const ULONGLONG v[6] = { e.size, e.mtime, e.hash, e.offset, e.length, e.flags };
+        mf.write((const char*)v, (DWORD)sizeof(v));
+    }
+    mf.close();
+    return !mf.failed;
+}
+
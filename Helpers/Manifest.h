@@ -0,0 +1,39 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// --- МАНИФЕСТ ИНКРЕМЕНТАЛЬНОГО ДАМПА (all.manifest) ---
+//
+// Для каждого файла прошлого all.txt: относительный путь, размер и mtime из обхода,
+// хэш контента и положение его блока в all.txt. Следующий -dump копирует блоки
+// неизменившихся файлов из старого all.txt как есть, в воркеры идут только новые
+// и изменённые. Блок длины 0 — файл был пропущен (бинарный). Блок-ссылка на
+// дубликат (kEntryDup) не копируется никогда: оригинал мог измениться.
+// Блоки собраны набором трансформов filters — с другим набором манифест не годится.
+//
+// Формат: "HLPMAN3\0" | u64 размер all.txt | u64 N | u64 filters |
+//         N × { u32 len, path[len] (UTF-8), u64 size, mtime, hash, offset, length, flags }
+
+enum { kEntryDup = 1 };
+
+struct ManifestEntry {
+    std::string relUtf8;
+    ULONGLONG   size   = 0;
+    ULONGLONG   mtime  = 0;
+    ULONGLONG   hash   = 0;
+    ULONGLONG   offset = 0;
+    ULONGLONG   length = 0;
+    ULONGLONG   flags  = 0;
+};
+
+// Ключ — относительный путь в UTF-16, как его видит сканер
+typedef std::unordered_map<std::wstring, ManifestEntry> Manifest;
+
+// false → манифеста нет, он битый или описывает не тот all.txt (правили руками)
+bool LoadManifest(const wchar_t* path, ULONGLONG allSize, unsigned contentFilters, Manifest& m);
+
+// false — не открылся или не дописан (tmp удаляет вызывающий)
+bool SaveManifest(const wchar_t* path, ULONGLONG allSize, unsigned contentFilters,
+                  const std::vector<ManifestEntry>& entries);
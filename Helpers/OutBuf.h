@@ -0,0 +1,86 @@
+#pragma once
+#include "Platform.h"
+#include <cstring>
+
+// --- БУФЕРИЗОВАННЫЙ ВЫВОД ЧЕРЕЗ WriteFile (без виртуальных вызовов ofstream) ---
+struct OutBuf {
+    static const DWORD kDirectWrite = 64 * 1024;          // с этого размера writeView не копирует
+    static const DWORD kMaxWrite    = 64 * 1024 * 1024;   // один WriteFile
+
+    HANDLE h      = INVALID_HANDLE_VALUE;
+    char*  buf    = nullptr;
+    DWORD  cap    = 0;
+    DWORD  pos    = 0;
+    bool   owned  = true;    // false — чужой handle (stdout, pipe): close его не закрывает
+    bool   failed = false;   // WriteFile не прошёл (диск полон, читатель pipe закрыл его)
+
+    bool open(const wchar_t* path, DWORD bufSz) {
+        buf = new char[bufSz];
+        cap = bufSz;
+        h = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (h == INVALID_HANDLE_VALUE) { delete[] buf; buf = nullptr; return false; }
+        owned = true;
+        return true;
+    }
+
+    // Вывод в уже открытый поток; copyFrom для него не нужен, остальное — как с файлом
+    void attach(HANDLE stream, DWORD bufSz) {
+        buf   = new char[bufSz];
+        cap   = bufSz;
+        h     = stream;
+        owned = false;
+    }
+
+    // Большие блоки (контент файлов) идут напрямую, минуя внутренний буфер
+    __forceinline void write(const char* data, DWORD len) {
+        if (len >= cap) { flush(); put(data, len); return; }
+        while (len > 0) {
+            DWORD n = min(len, cap - pos);
+            memcpy(buf + pos, data, n);
+            pos += n; data += n; len -= n;
+            if (pos == cap) flush();
+        }
+    }
+
+    // Диапазон mapped view: крупный уходит в WriteFile прямо из страниц файла
+    // (ноль memcpy в user space), мелкий — через буфер, чтобы не плодить syscall-ы
+    void writeView(const char* data, size_t len) {
+        if (len < kDirectWrite) { write(data, (DWORD)len); return; }
+        flush();
+        while (len > 0) {
+            DWORD n = (DWORD)min(len, (size_t)kMaxWrite), w = 0;
+            if (!WriteFile(h, data, n, &w, NULL) || w == 0) { failed = true; return; }
+            data += w; len -= w;
+        }
+    }
+
+    // Копирует диапазон другого файла: ReadFile с offset прямо во внутренний буфер
+    bool copyFrom(HANDLE src, ULONGLONG off, ULONGLONG len) {
+        while (len > 0) {
+            if (pos == cap) flush();
+            DWORD n = (DWORD)min(len, (ULONGLONG)(cap - pos));
+            OVERLAPPED ov = {};
+            ov.Offset     = (DWORD)off;
+            ov.OffsetHigh = (DWORD)(off >> 32);
+            DWORD got = 0;
+            if (!ReadFile(src, buf + pos, n, &got, &ov) || got == 0) return false;
+            pos += got; off += got; len -= got;
+        }
+        return true;
+    }
+
+    void put(const char* data, DWORD len) {
+        DWORD w = 0;
+        if (!WriteFile(h, data, len, &w, NULL) || w != len) failed = true;
+    }
+
+    void flush() { if (pos) { put(buf, pos); pos = 0; } }
+
+    void close() {
+        flush();
+        if (h != INVALID_HANDLE_VALUE && owned) CloseHandle(h);
+        h = INVALID_HANDLE_VALUE;
+        delete[] buf; buf = nullptr;
+    }
+};
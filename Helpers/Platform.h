@@ -0,0 +1,173 @@
+#pragma once
+
+// --- ПЕРЕНОСИМОСТЬ: Win32 API И ИНТРИНСИКИ MSVC ---
+//
+// Ядро (обход, классификация, очистка, -list/-dump, форматы выходных файлов) написано
+// на Win32 API. На Windows это windows.h как есть. На POSIX — то подмножество, которым
+// ядро пользуется, с теми же именами, типами и семантикой (PlatformPosix.cpp):
+//   HANDLE — дескриптор файла + 1 (NULL и INVALID_HANDLE_VALUE не совпадают ни с одним);
+//   пути — по-прежнему с '\\': в системный вызов уходят через PosixPath (UTF-8, '/');
+//   wchar_t — UTF-32, CP_ACP — Latin-1; DWORD/LONG — 32 бита, как в форматах файлов.
+// Окно, -watch, -bench, -query, вставка картинок и реестр — только Windows (Helpers.cpp).
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <intrin.h>
+
+#else
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <string>
+#include <type_traits>
+#include <strings.h>
+#include <immintrin.h>
+
+#define __forceinline inline __attribute__((always_inline))
+#define WINAPI
+
+typedef int                BOOL;
+typedef unsigned char      BYTE;
+typedef unsigned short     WORD;
+typedef uint32_t           DWORD;
+typedef int32_t            LONG;
+typedef uint32_t           ULONG;
+typedef unsigned int       UINT;
+typedef long long          LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef void*              HANDLE;
+typedef wchar_t*           LPWSTR;
+
+#define TRUE  1
+#define FALSE 0
+
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define MAX_PATH             260
+#define INFINITE             0xFFFFFFFFu
+
+struct FILETIME {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+};
+
+union LARGE_INTEGER {
+    struct { DWORD LowPart; LONG HighPart; } u;
+    LONGLONG QuadPart;
+};
+
+// Только смещение синхронного ReadFile/WriteFile: асинхронного I/O на POSIX нет
+struct OVERLAPPED {
+    DWORD  Offset;
+    DWORD  OffsetHigh;
+    HANDLE hEvent;
+};
+
+enum : DWORD {
+    FILE_ATTRIBUTE_READONLY      = 0x1,
+    FILE_ATTRIBUTE_HIDDEN        = 0x2,
+    FILE_ATTRIBUTE_SYSTEM        = 0x4,
+    FILE_ATTRIBUTE_DIRECTORY     = 0x10,
+    FILE_ATTRIBUTE_ARCHIVE       = 0x20,
+    FILE_ATTRIBUTE_NORMAL        = 0x80,
+    FILE_ATTRIBUTE_REPARSE_POINT = 0x400,
+    INVALID_FILE_ATTRIBUTES      = 0xFFFFFFFFu,
+
+    GENERIC_READ                 = 0x80000000u,
+    GENERIC_WRITE                = 0x40000000u,
+    FILE_READ_ATTRIBUTES         = 0x80,
+    FILE_SHARE_READ              = 0x1,
+    FILE_SHARE_WRITE             = 0x2,
+    FILE_SHARE_DELETE            = 0x4,
+    CREATE_NEW                   = 1,
+    CREATE_ALWAYS                = 2,
+    OPEN_EXISTING                = 3,
+    OPEN_ALWAYS                  = 4,
+    TRUNCATE_EXISTING            = 5,
+    FILE_FLAG_SEQUENTIAL_SCAN    = 0x08000000,
+    FILE_FLAG_RANDOM_ACCESS      = 0x10000000,
+    FILE_FLAG_OVERLAPPED         = 0x40000000,
+
+    PAGE_READONLY                = 0x02,
+    FILE_MAP_READ                = 0x04,
+    MOVEFILE_REPLACE_EXISTING    = 0x1,
+
+    STD_INPUT_HANDLE             = (DWORD)-10,
+    STD_OUTPUT_HANDLE            = (DWORD)-11,
+    STD_ERROR_HANDLE             = (DWORD)-12,
+
+    CP_ACP                       = 0,
+    CP_UTF8                      = 65001,
+    MB_ERR_INVALID_CHARS         = 0x8,
+};
+
+// Файлы и отображения
+HANDLE CreateFileW(const wchar_t* path, DWORD access, DWORD share, void* security,
+                   DWORD disposition, DWORD flags, HANDLE templateFile);
+BOOL   ReadFile(HANDLE h, void* buf, DWORD len, DWORD* got, OVERLAPPED* ov);
+BOOL   WriteFile(HANDLE h, const void* buf, DWORD len, DWORD* written, OVERLAPPED* ov);
+BOOL   CloseHandle(HANDLE h);
+BOOL   GetFileSizeEx(HANDLE h, LARGE_INTEGER* size);
+BOOL   FlushFileBuffers(HANDLE h);
+HANDLE GetStdHandle(DWORD id);
+DWORD  GetFileAttributesW(const wchar_t* path);
+BOOL   DeleteFileW(const wchar_t* path);
+BOOL   MoveFileExW(const wchar_t* from, const wchar_t* to, DWORD flags);
+BOOL   CreateDirectoryW(const wchar_t* path, void* security);
+BOOL   RemoveDirectoryW(const wchar_t* path);
+HANDLE CreateFileMappingW(HANDLE file, void* security, DWORD protect, DWORD maxHigh, DWORD maxLow,
+                          const wchar_t* name);
+void*  MapViewOfFile(HANDLE mapping, DWORD access, DWORD offHigh, DWORD offLow, size_t len);
+BOOL   UnmapViewOfFile(const void* view);
+
+// Кодировки
+int MultiByteToWideChar(UINT cp, DWORD flags, const char* src, int srcLen, wchar_t* dst, int dstLen);
+int WideCharToMultiByte(UINT cp, DWORD flags, const wchar_t* src, int srcLen, char* dst, int dstLen,
+                        const char* defaultChar, BOOL* usedDefault);
+
+// Время, потоки, окружение
+BOOL  QueryPerformanceCounter(LARGE_INTEGER* t);
+BOOL  QueryPerformanceFrequency(LARGE_INTEGER* f);
+DWORD GetCurrentThreadId();
+DWORD GetEnvironmentVariableW(const wchar_t* name, wchar_t* buf, DWORD size);
+void  Sleep(DWORD ms);
+
+// Путь ядра ('\\', UTF-32) → путь для системного вызова (UTF-8, '/')
+std::string PosixPath(const std::wstring& path);
+
+// min/max из windows.h — макросы; здесь шаблоны с тем же общим типом результата
+template<typename A, typename B>
+inline typename std::common_type<A, B>::type min(A a, B b) { return b < a ? b : a; }
+template<typename A, typename B>
+inline typename std::common_type<A, B>::type max(A a, B b) { return a < b ? b : a; }
+
+inline int _wcsicmp(const wchar_t* a, const wchar_t* b)            { return wcscasecmp(a, b); }
+inline int _wcsnicmp(const wchar_t* a, const wchar_t* b, size_t n) { return wcsncasecmp(a, b, n); }
+inline int _stricmp(const char* a, const char* b)                  { return strcasecmp(a, b); }
+inline int _strnicmp(const char* a, const char* b, size_t n)       { return strncasecmp(a, b, n); }
+
+inline unsigned char _BitScanForward(unsigned long* index, unsigned long mask) {
+    if (!mask) return 0;
+    *index = (unsigned long)__builtin_ctzl(mask);
+    return 1;
+}
+inline unsigned char _BitScanReverse(unsigned long* index, unsigned long mask) {
+    if (!mask) return 0;
+    *index = (unsigned long)(sizeof(mask) * 8 - 1 - __builtin_clzl(mask));
+    return 1;
+}
+inline unsigned char _BitScanForward64(unsigned long* index, unsigned long long mask) {
+    if (!mask) return 0;
+    *index = (unsigned long)__builtin_ctzll(mask);
+    return 1;
+}
+inline unsigned char _BitScanReverse64(unsigned long* index, unsigned long long mask) {
+    if (!mask) return 0;
+    *index = (unsigned long)(63 - __builtin_clzll(mask));
+    return 1;
+}
+
+#endif
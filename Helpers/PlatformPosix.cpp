@@ -0,0 +1,295 @@
+#include "Platform.h"
+#ifndef _WIN32
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#else
+#include <pthread.h>
+#endif
+
+static __forceinline int    HandleFd(HANDLE h) { return (int)(intptr_t)h - 1; }
+static __forceinline HANDLE FdHandle(int fd)   { return (HANDLE)(intptr_t)(fd + 1); }
+
+static bool IsStdFd(int fd) { return fd >= 0 && fd <= 2; }
+
+// Длины отображений: UnmapViewOfFile получает только адрес
+static std::mutex                              g_viewMtx;
+static std::unordered_map<const void*, size_t> g_views;
+
+// Кодовая точка → UTF-8 в buf[4]; вне диапазона и суррогаты — U+FFFD
+static int EncodeUtf8(unsigned long c, char* buf) {
+    if (c > 0x10FFFF || (c >= 0xD800 && c < 0xE000)) c = 0xFFFD;
+    if (c < 0x80)    { buf[0] = (char)c; return 1; }
+    if (c < 0x800)   { buf[0] = (char)(0xC0 | (c >> 6));  buf[1] = (char)(0x80 | (c & 0x3F)); return 2; }
+    if (c < 0x10000) { buf[0] = (char)(0xE0 | (c >> 12)); buf[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+                       buf[2] = (char)(0x80 | (c & 0x3F)); return 3; }
+    buf[0] = (char)(0xF0 | (c >> 18));         buf[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+    buf[2] = (char)(0x80 | ((c >> 6) & 0x3F)); buf[3] = (char)(0x80 | (c & 0x3F));
+    return 4;
+}
+
+std::string PosixPath(const std::wstring& path) {
+    std::string out;
+    out.reserve(path.size() + 16);
+    char buf[4];
+    for (wchar_t c : path) out.append(buf, (size_t)EncodeUtf8(c == L'\\' ? L'/' : (unsigned long)c, buf));
+    return out;
+}
+
+HANDLE CreateFileW(const wchar_t* path, DWORD access, DWORD, void*, DWORD disposition, DWORD flags, HANDLE) {
+    int of = O_CLOEXEC;
+    if ((access & GENERIC_READ) && (access & GENERIC_WRITE)) of |= O_RDWR;
+    else if (access & GENERIC_WRITE)                         of |= O_WRONLY;
+    else                                                     of |= O_RDONLY;
+    switch (disposition) {
+        case CREATE_NEW:        of |= O_CREAT | O_EXCL;  break;
+        case CREATE_ALWAYS:     of |= O_CREAT | O_TRUNC; break;
+        case OPEN_ALWAYS:       of |= O_CREAT;           break;
+        case TRUNCATE_EXISTING: of |= O_TRUNC;           break;
+    }
+    const int fd = open(PosixPath(path).c_str(), of, 0666);
+    if (fd < 0) return INVALID_HANDLE_VALUE;
+    // CreateFileW без FILE_FLAG_BACKUP_SEMANTICS директорию не открывает
+    struct stat st;
+    if (fstat(fd, &st) != 0 || S_ISDIR(st.st_mode)) { close(fd); return INVALID_HANDLE_VALUE; }
+    if (flags & FILE_FLAG_SEQUENTIAL_SCAN) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    if (flags & FILE_FLAG_RANDOM_ACCESS)   posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+    return FdHandle(fd);
+}
+
+BOOL ReadFile(HANDLE h, void* buf, DWORD len, DWORD* got, OVERLAPPED* ov) {
+    const int fd = HandleFd(h);
+    ssize_t n;
+    do {
+        n = ov ? pread(fd, buf, len, (off_t)(((ULONGLONG)ov->OffsetHigh << 32) | ov->Offset))
+               : read(fd, buf, len);
+    } while (n < 0 && errno == EINTR);
+    if (got) *got = n > 0 ? (DWORD)n : 0;
+    return n >= 0;
+}
+
+// Как WriteFile на файле и блокирующем pipe: всё или ошибка
+BOOL WriteFile(HANDLE h, const void* buf, DWORD len, DWORD* written, OVERLAPPED* ov) {
+    const int   fd  = HandleFd(h);
+    const char* p   = (const char*)buf;
+    off_t       off = ov ? (off_t)(((ULONGLONG)ov->OffsetHigh << 32) | ov->Offset) : 0;
+    DWORD       done = 0;
+    while (done < len) {
+        const ssize_t n = ov ? pwrite(fd, p + done, len - done, off + done) : write(fd, p + done, len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (DWORD)n;
+    }
+    if (written) *written = done;
+    return done == len;
+}
+
+BOOL CloseHandle(HANDLE h) {
+    const int fd = HandleFd(h);
+    if (fd < 0) return FALSE;
+    if (IsStdFd(fd)) return TRUE;   // GetStdHandle: закрывать нечего
+    return close(fd) == 0;
+}
+
+BOOL GetFileSizeEx(HANDLE h, LARGE_INTEGER* size) {
+    struct stat st;
+    if (fstat(HandleFd(h), &st) != 0) return FALSE;
+    size->QuadPart = (LONGLONG)st.st_size;
+    return TRUE;
+}
+
+BOOL FlushFileBuffers(HANDLE h) {
+    return fsync(HandleFd(h)) == 0;
+}
+
+HANDLE GetStdHandle(DWORD id) {
+    switch (id) {
+        case STD_INPUT_HANDLE:  return FdHandle(0);
+        case STD_OUTPUT_HANDLE: return FdHandle(1);
+        case STD_ERROR_HANDLE:  return FdHandle(2);
+    }
+    return INVALID_HANDLE_VALUE;
+}
+
+DWORD GetFileAttributesW(const wchar_t* path) {
+    struct stat st;
+    if (stat(PosixPath(path).c_str(), &st) != 0) return INVALID_FILE_ATTRIBUTES;
+    DWORD a = S_ISDIR(st.st_mode) ? (DWORD)FILE_ATTRIBUTE_DIRECTORY : 0;
+    if (!(st.st_mode & S_IWUSR)) a |= FILE_ATTRIBUTE_READONLY;
+    return a ? a : FILE_ATTRIBUTE_NORMAL;
+}
+
+BOOL DeleteFileW(const wchar_t* path) {
+    return unlink(PosixPath(path).c_str()) == 0;
+}
+
+// rename заменяет атомарно; без MOVEFILE_REPLACE_EXISTING существующий — ошибка, как в Win32
+BOOL MoveFileExW(const wchar_t* from, const wchar_t* to, DWORD flags) {
+    const std::string dst = PosixPath(to);
+    if (!(flags & MOVEFILE_REPLACE_EXISTING) && access(dst.c_str(), F_OK) == 0) return FALSE;
+    return rename(PosixPath(from).c_str(), dst.c_str()) == 0;
+}
+
+BOOL CreateDirectoryW(const wchar_t* path, void*) {
+    return mkdir(PosixPath(path).c_str(), 0777) == 0;
+}
+
+BOOL RemoveDirectoryW(const wchar_t* path) {
+    return rmdir(PosixPath(path).c_str()) == 0;
+}
+
+// Отображение — свой дескриптор (dup): исходный handle можно сразу закрыть, как в Win32.
+// Только чтение; пустой файл, как и в Win32, не отображается.
+HANDLE CreateFileMappingW(HANDLE file, void*, DWORD protect, DWORD maxHigh, DWORD maxLow, const wchar_t*) {
+    if (protect != PAGE_READONLY || maxHigh || maxLow) return NULL;
+    struct stat st;
+    if (fstat(HandleFd(file), &st) != 0 || st.st_size == 0) return NULL;
+    const int fd = fcntl(HandleFd(file), F_DUPFD_CLOEXEC, 3);
+    return fd < 0 ? NULL : FdHandle(fd);
+}
+
+void* MapViewOfFile(HANDLE mapping, DWORD, DWORD offHigh, DWORD offLow, size_t len) {
+    const off_t off = (off_t)(((ULONGLONG)offHigh << 32) | offLow);
+    if (!len) {
+        struct stat st;
+        if (fstat(HandleFd(mapping), &st) != 0 || st.st_size <= off) return NULL;
+        len = (size_t)(st.st_size - off);
+    }
+    void* p = mmap(nullptr, len, PROT_READ, MAP_SHARED, HandleFd(mapping), off);
+    if (p == MAP_FAILED) return NULL;
+    std::lock_guard<std::mutex> lk(g_viewMtx);
+    g_views[p] = len;
+    return p;
+}
+
+BOOL UnmapViewOfFile(const void* view) {
+    size_t len;
+    {
+        std::lock_guard<std::mutex> lk(g_viewMtx);
+        auto it = g_views.find(view);
+        if (it == g_views.end()) return FALSE;
+        len = it->second;
+        g_views.erase(it);
+    }
+    return munmap(const_cast<void*>(view), len) == 0;
+}
+
+// Декодирует UTF-8; -1 — неверная последовательность (n байт пропустить)
+static long DecodeUtf8(const unsigned char* p, const unsigned char* e, int& n) {
+    const unsigned c = *p;
+    n = 1;
+    if (c < 0x80) return c;
+    const int more = (c & 0xE0) == 0xC0 ? 1 : (c & 0xF0) == 0xE0 ? 2 : (c & 0xF8) == 0xF0 ? 3 : -1;
+    if (more < 0) return -1;
+    unsigned long cp = c & (0x3F >> more);
+    for (int k = 1; k <= more; ++k) {
+        if (p + k >= e || (p[k] & 0xC0) != 0x80) { n = k; return -1; }
+        cp = (cp << 6) | (p[k] & 0x3F);
+    }
+    n = more + 1;
+    static const unsigned long kMin[] = { 0, 0x80, 0x800, 0x10000 };
+    if (cp < kMin[more] || cp > 0x10FFFF || (cp >= 0xD800 && cp < 0xE000)) return -1;
+    return (long)cp;
+}
+
+// Как в Win32: srcLen = -1 — с завершающим нулём; dstLen = 0 — только посчитать;
+// буфер мал — 0. Неверный UTF-8 — U+FFFD, с MB_ERR_INVALID_CHARS — 0. CP_ACP — Latin-1.
+int MultiByteToWideChar(UINT cp, DWORD flags, const char* src, int srcLen, wchar_t* dst, int dstLen) {
+    if (srcLen < 0) srcLen = (int)strlen(src) + 1;
+    const unsigned char* p = (const unsigned char*)src;
+    const unsigned char* e = p + srcLen;
+    int out = 0;
+    while (p < e) {
+        long c;
+        int  n = 1;
+        if (cp == CP_UTF8) {
+            c = DecodeUtf8(p, e, n);
+            if (c < 0) {
+                if (flags & MB_ERR_INVALID_CHARS) return 0;
+                c = 0xFFFD;
+            }
+        } else {
+            c = *p;
+        }
+        p += n;
+        if (dstLen) {
+            if (out == dstLen) return 0;
+            dst[out] = (wchar_t)c;
+        }
+        ++out;
+    }
+    return out;
+}
+
+int WideCharToMultiByte(UINT cp, DWORD, const wchar_t* src, int srcLen, char* dst, int dstLen,
+                        const char*, BOOL* usedDefault) {
+    if (srcLen < 0) srcLen = (int)wcslen(src) + 1;
+    if (usedDefault) *usedDefault = FALSE;
+    int out = 0;
+    for (int i = 0; i < srcLen; ++i) {
+        unsigned long c = (unsigned long)src[i];
+        char buf[4];
+        int  n;
+        if (cp == CP_UTF8) {
+            n = EncodeUtf8(c, buf);
+        } else {
+            if (c > 0xFF) { c = '?'; if (usedDefault) *usedDefault = TRUE; }
+            buf[0] = (char)c;
+            n = 1;
+        }
+        if (dstLen) {
+            if (out + n > dstLen) return 0;
+            memcpy(dst + out, buf, (size_t)n);
+        }
+        out += n;
+    }
+    return out;
+}
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER* t) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    t->QuadPart = (LONGLONG)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* f) {
+    f->QuadPart = 1000000000LL;
+    return TRUE;
+}
+
+DWORD GetCurrentThreadId() {
+#if defined(__linux__)
+    return (DWORD)syscall(SYS_gettid);
+#else
+    return (DWORD)(uintptr_t)pthread_self();
+#endif
+}
+
+// Размер с нулём, если буфер мал; длина без нуля, если записано; 0 — переменной нет
+DWORD GetEnvironmentVariableW(const wchar_t* name, wchar_t* buf, DWORD size) {
+    char key[256];
+    const int kl = WideCharToMultiByte(CP_UTF8, 0, name, -1, key, (int)sizeof(key), NULL, NULL);
+    if (!kl) return 0;
+    const char* v = getenv(key);
+    if (!v) return 0;
+    const int n = MultiByteToWideChar(CP_UTF8, 0, v, -1, nullptr, 0);
+    if (!n || (DWORD)n > size) return (DWORD)n;
+    MultiByteToWideChar(CP_UTF8, 0, v, -1, buf, (int)size);
+    return (DWORD)n - 1;
+}
+
+void Sleep(DWORD ms) {
+    timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+#endif
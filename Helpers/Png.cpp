@@ -0,0 +1,636 @@
+#include "Png.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <immintrin.h>   // AVX2
+
+static const size_t kPngBand         = 512 * 1024;   // фильтрованных байт на полосу
+static const size_t kDeflateWindow   = 32 * 1024;
+static const int    kDeflateHashLog  = 15;
+static const int    kDeflateChain    = 8;            // кандидатов на позицию
+static const size_t kDeflateTokens   = 64 * 1024;    // токенов на блок Хаффмана
+
+// --- CRC-32 (чанки PNG): slicing-by-8 ---
+struct Crc32Table {
+    unsigned t[8][256];
+    Crc32Table() {
+        for (unsigned i = 0; i < 256; ++i) {
+            unsigned c = i;
+            for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[0][i] = c;
+        }
+        for (unsigned i = 0; i < 256; ++i)
+            for (int s = 1; s < 8; ++s) t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xFF];
+    }
+};
+
+static unsigned Crc32(unsigned crc, const unsigned char* p, size_t n) {
+    static const Crc32Table tab;
+    const auto& t = tab.t;
+    crc = ~crc;
+    for (; n >= 8; p += 8, n -= 8) {
+        unsigned lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    while (n--) crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// --- ADLER-32 (хвост zlib-потока) ---
+static const unsigned kAdlerMod = 65521;
+
+static unsigned Adler32(unsigned adler, const unsigned char* p, size_t n) {
+    unsigned a = adler & 0xFFFF, b = adler >> 16;
+    while (n) {
+        size_t k = min(n, (size_t)5552);   // без переполнения b до взятия остатка
+        n -= k;
+        for (; k; --k) { a += *p++; b += a; }
+        a %= kAdlerMod;
+        b %= kAdlerMod;
+    }
+    return a | b << 16;
+}
+
+// Сумма склейки: adler1 — первой части, adler2 — второй длины len2
+static unsigned Adler32Combine(unsigned adler1, unsigned adler2, ULONGLONG len2) {
+    const unsigned rem = (unsigned)(len2 % kAdlerMod);
+    unsigned a = adler1 & 0xFFFF;
+    unsigned b = (unsigned)((ULONGLONG)rem * a % kAdlerMod);
+    a += (adler2 & 0xFFFF) + kAdlerMod - 1;
+    b += (adler1 >> 16) + (adler2 >> 16) + kAdlerMod - rem;
+    if (a >= kAdlerMod) a -= kAdlerMod;
+    if (a >= kAdlerMod) a -= kAdlerMod;
+    if (b >= 2 * kAdlerMod) b -= 2 * kAdlerMod;
+    if (b >= kAdlerMod) b -= kAdlerMod;
+    return a | b << 16;
+}
+
+// --- ФИЛЬТРЫ СТРОК PNG ---
+// Строка — RGB (3 байта на пиксель); row и prev с kPngRowPad нулями перед началом,
+// так что a = row[i-3] и c = prev[i-3] читаются без ветвлений. Для первой строки
+// prev — нули.
+static const size_t kPngRowPad = 16;
+
+enum PngFilter { kPngNone, kPngSub, kPngUp, kPngAvg, kPngPaeth, kPngFilters };
+
+static __forceinline unsigned char PaethPredict(int a, int b, int c) {
+    const int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2 * c);
+    return (unsigned char)(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+}
+
+// |v| как у знакового байта — вклад в сумму эвристики
+static __forceinline __m128i SignedAbs8(__m128i v) {
+    return _mm_min_epu8(v, _mm_sub_epi8(_mm_setzero_si128(), v));
+}
+
+static __forceinline __m128i PaethPredict16(__m128i a, __m128i b, __m128i c) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i half[2];
+    for (int h = 0; h < 2; ++h) {
+        const __m128i a16 = h ? _mm_unpackhi_epi8(a, zero) : _mm_unpacklo_epi8(a, zero);
+        const __m128i b16 = h ? _mm_unpackhi_epi8(b, zero) : _mm_unpacklo_epi8(b, zero);
+        const __m128i c16 = h ? _mm_unpackhi_epi8(c, zero) : _mm_unpacklo_epi8(c, zero);
+        const __m128i bc  = _mm_sub_epi16(b16, c16);
+        const __m128i ac  = _mm_sub_epi16(a16, c16);
+        const __m128i abc = _mm_add_epi16(bc, ac);
+        const __m128i pa  = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+        const __m128i pb  = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+        const __m128i pc  = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+        // a, если pa <= pb и pa <= pc; иначе b, если pb <= pc; иначе c
+        const __m128i useA = _mm_andnot_si128(_mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc)), _mm_set1_epi16(-1));
+        const __m128i useB = _mm_andnot_si128(_mm_cmpgt_epi16(pb, pc), _mm_set1_epi16(-1));
+        const __m128i bc16 = _mm_or_si128(_mm_and_si128(useB, b16), _mm_andnot_si128(useB, c16));
+        half[h] = _mm_or_si128(_mm_and_si128(useA, a16), _mm_andnot_si128(useA, bc16));
+    }
+    return _mm_packus_epi16(half[0], half[1]);
+}
+
+// Все пять фильтров строки n байт в out[f] (по n + 1: байт типа фильтра и данные);
+// возвращает выбранный фильтр
+static int FilterPngRow(const unsigned char* row, const unsigned char* prev, size_t n, unsigned char* const out[kPngFilters]) {
+    ULONGLONG cost[kPngFilters] = {};
+    size_t    i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+        const __m128i a = _mm_loadu_si128((const __m128i*)(row + i - 3));
+        const __m128i b = _mm_loadu_si128((const __m128i*)(prev + i));
+        const __m128i c = _mm_loadu_si128((const __m128i*)(prev + i - 3));
+        // floor((a + b) / 2): avg_epu8 округляет вверх
+        const __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+        const __m128i v[kPngFilters] = {
+            x, _mm_sub_epi8(x, a), _mm_sub_epi8(x, b), _mm_sub_epi8(x, avg), _mm_sub_epi8(x, PaethPredict16(a, b, c))
+        };
+        for (int f = 0; f < kPngFilters; ++f) {
+            _mm_storeu_si128((__m128i*)(out[f] + 1 + i), v[f]);
+            const __m128i s = _mm_sad_epu8(SignedAbs8(v[f]), _mm_setzero_si128());
+            cost[f] += (ULONGLONG)_mm_cvtsi128_si32(s) + (ULONGLONG)_mm_cvtsi128_si32(_mm_srli_si128(s, 8));
+        }
+    }
+    for (; i < n; ++i) {
+        const int x = row[i], a = row[i - 3], b = prev[i], c = prev[i - 3];
+        const unsigned char v[kPngFilters] = {
+            (unsigned char)x, (unsigned char)(x - a), (unsigned char)(x - b),
+            (unsigned char)(x - ((a + b) >> 1)), (unsigned char)(x - PaethPredict(a, b, c))
+        };
+        for (int f = 0; f < kPngFilters; ++f) {
+            out[f][1 + i] = v[f];
+            cost[f] += v[f] < 128 ? v[f] : 256 - v[f];
+        }
+    }
+
+    int best = kPngNone;
+    for (int f = 1; f < kPngFilters; ++f)
+        if (cost[f] < cost[best]) best = f;
+    out[best][0] = (unsigned char)best;
+    return best;
+}
+
+// Строка DIB (BGR или BGRX) → RGB; dst с запасом 16 байт за концом строки
+static void DibRowToRgb(const unsigned char* src, int bytesPerPixel, int width, unsigned char* dst) {
+    int x = 0;
+#if defined(__AVX2__)
+    // pshufb (SSSE3 есть везде, где есть AVX2): 4 пикселя за раз, запись 16 байт внахлёст
+    if (bytesPerPixel == 4) {
+        const __m128i shuf = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        for (; x + 4 <= width; x += 4)
+            _mm_storeu_si128((__m128i*)(dst + x * 3), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + x * 4)), shuf));
+    } else {
+        const __m128i shuf = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1);
+        for (; x + 6 <= width; x += 4)   // чтение 16 байт при 12 нужных — не дальше строки
+            _mm_storeu_si128((__m128i*)(dst + x * 3), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + x * 3)), shuf));
+    }
+#endif
+    for (; x < width; ++x) {
+        const unsigned char* s = src + (size_t)x * bytesPerPixel;
+        dst[x * 3 + 0] = s[2];
+        dst[x * 3 + 1] = s[1];
+        dst[x * 3 + 2] = s[0];
+    }
+}
+
+// --- DEFLATE: LZ77 + ДИНАМИЧЕСКИЙ ХАФФМАН ---
+
+struct DeflateTables {
+    unsigned char  lenSym[256];      // длина - 3 → код длины - 257
+    unsigned char  distLow[256];     // расстояние - 1 < 256 → код расстояния
+    unsigned char  distHigh[256];    // (расстояние - 1) >> 7 → код расстояния
+    unsigned short lenBase[29];
+    unsigned char  lenExtra[29];
+    unsigned short distBase[30];
+    unsigned char  distExtra[30];
+
+    DeflateTables() {
+        static const unsigned short kLenBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const unsigned short kDistBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        for (int s = 0; s < 29; ++s) {
+            lenBase[s]  = kLenBase[s];
+            lenExtra[s] = (unsigned char)(s < 8 || s == 28 ? 0 : (s - 4) / 4);
+            const int end = s == 28 ? 259 : kLenBase[s] + (1 << lenExtra[s]);
+            for (int l = kLenBase[s]; l < end && l <= 258; ++l) lenSym[l - 3] = (unsigned char)s;
+        }
+        for (int s = 0; s < 30; ++s) {
+            distBase[s]  = kDistBase[s];
+            distExtra[s] = (unsigned char)(s < 4 ? 0 : (s - 2) / 2);
+            const int end = kDistBase[s] + (1 << distExtra[s]);
+            for (int d = kDistBase[s]; d < end; ++d) {
+                if (d <= 256) distLow[d - 1] = (unsigned char)s;
+                else          distHigh[(d - 1) >> 7] = (unsigned char)s;
+            }
+        }
+    }
+
+    __forceinline int distCode(unsigned d) const { return d <= 256 ? distLow[d - 1] : distHigh[(d - 1) >> 7]; }
+};
+
+static const DeflateTables& GetDeflateTables() {
+    static const DeflateTables t;
+    return t;
+}
+
+// Биты младшим вперёд, как требует deflate
+struct DeflateBits {
+    std::string& out;
+    ULONGLONG    acc = 0;
+    int          n   = 0;
+
+    __forceinline void put(unsigned bits, int len) {
+        acc |= (ULONGLONG)bits << n;
+        n += len;
+        if (n >= 32) {
+            const unsigned w = (unsigned)acc;
+            out.append((const char*)&w, 4);
+            acc >>= 32;
+            n -= 32;
+        }
+    }
+
+    void align() {
+        while (n > 0) { out += (char)(acc & 0xFF); acc >>= 8; n = max(n - 8, 0); }
+        acc = 0;
+    }
+};
+
+static __forceinline unsigned ReverseBits(unsigned code, int len) {
+    unsigned r = 0;
+    for (int i = 0; i < len; ++i, code >>= 1) r = r << 1 | (code & 1);
+    return r;
+}
+
+// Длины кодов Хаффмана по частотам, не длиннее maxLen; code — канонические коды,
+// уже развёрнутые для записи младшим битом вперёд
+static void BuildHuffman(const unsigned* freq, int count, int maxLen, unsigned char* len, unsigned short* code) {
+    // Минимально-избыточный код (Moffat, на месте) по частотам в порядке возрастания
+    std::vector<std::pair<unsigned, int>> sym;
+    for (int s = 0; s < count; ++s) {
+        len[s] = 0;
+        if (freq[s]) sym.push_back({ freq[s], s });
+    }
+    std::sort(sym.begin(), sym.end());
+    const int n = (int)sym.size();
+    std::vector<unsigned> k(n);
+    for (int i = 0; i < n; ++i) k[i] = sym[i].first;
+    if (n == 1) k[0] = 1;
+    if (n > 1) {
+        k[0] += k[1];
+        int root = 0, leaf = 2;
+        for (int next = 1; next < n - 1; ++next) {
+            if (leaf >= n || k[root] < k[leaf]) { k[next] = k[root]; k[root++] = (unsigned)next; }
+            else k[next] = k[leaf++];
+            if (leaf >= n || (root < next && k[root] < k[leaf])) { k[next] += k[root]; k[root++] = (unsigned)next; }
+            else k[next] += k[leaf++];
+        }
+        k[n - 2] = 0;
+        for (int next = n - 3; next >= 0; --next) k[next] = k[k[next]] + 1;
+        int avbl = 1, used = 0, depth = 0, root2 = n - 2, next = n - 1;
+        while (avbl > 0) {
+            while (root2 >= 0 && (int)k[root2] == depth) { ++used; --root2; }
+            while (avbl > used) { k[next--] = (unsigned)depth; --avbl; }
+            avbl = 2 * used;
+            ++depth;
+            used = 0;
+        }
+    }
+
+    // Ограничение длины: лишнее переносится на maxLen, неравенство Крафта
+    // восстанавливается удлинением более коротких кодов
+    int num[33] = {};
+    for (int i = 0; i < n; ++i) ++num[min((int)k[i], 32)];
+    for (int l = maxLen + 1; l <= 32; ++l) { num[maxLen] += num[l]; num[l] = 0; }
+    if (n > 1) {
+        unsigned total = 0;
+        for (int l = maxLen; l > 0; --l) total += (unsigned)num[l] << (maxLen - l);
+        while (total != 1u << maxLen) {
+            --num[maxLen];
+            for (int l = maxLen - 1; l > 0; --l)
+                if (num[l]) { --num[l]; num[l + 1] += 2; break; }
+            --total;
+        }
+    }
+    // Самые частые символы (конец sym) — самые короткие коды
+    for (int l = 1, j = n; l <= maxLen; ++l)
+        for (int c = num[l]; c > 0; --c) len[sym[--j].second] = (unsigned char)l;
+
+    // Канонические коды
+    int      blCount[16] = {};
+    unsigned nextCode[16] = {};
+    for (int s = 0; s < count; ++s) ++blCount[len[s]];
+    blCount[0] = 0;
+    for (int l = 1, c = 0; l <= 15; ++l) { c = (c + blCount[l - 1]) << 1; nextCode[l] = (unsigned)c; }
+    for (int s = 0; s < count; ++s)
+        code[s] = len[s] ? (unsigned short)ReverseBits(nextCode[len[s]]++, len[s]) : 0;
+}
+
+// Сжимает data[start..n) кусками одного deflate-потока; data[0..start) — словарь
+// (конец предыдущей полосы). last — с BFINAL, иначе в конце пустой stored-блок.
+struct DeflateEncoder {
+    std::vector<int>      head = std::vector<int>((size_t)1 << kDeflateHashLog);
+    std::vector<int>      prev = std::vector<int>(kDeflateWindow);
+    std::vector<unsigned> tokens;    // литерал < 256; иначе 1 << 31 | (длина - 3) << 16 | (расстояние - 1)
+    unsigned              litFreq[286];
+    unsigned              distFreq[30];
+
+    static __forceinline unsigned Hash(const unsigned char* p) {
+        unsigned v;
+        memcpy(&v, p, 4);
+        return (v * 2654435761u) >> (32 - kDeflateHashLog);
+    }
+
+    __forceinline void insert(const unsigned char* data, int pos) {
+        const unsigned h = Hash(data + pos);
+        prev[pos & (kDeflateWindow - 1)] = head[h];
+        head[h] = pos;
+    }
+
+    // raw — исходные байты блока: если Хаффман не выигрывает (шум, фото), пишем их stored
+    void writeBlock(DeflateBits& bw, bool final, const unsigned char* raw, size_t rawLen) {
+        const DeflateTables& t = GetDeflateTables();
+        litFreq[256] = 1;
+        // Хотя бы два кода в каждом дереве — иначе часть декодеров их не примет
+        int used = 0;
+        for (int s = 0; s < 30; ++s) used += distFreq[s] != 0;
+        if (used < 2) { distFreq[0] += !distFreq[0]; distFreq[1] += !distFreq[1]; }
+
+        unsigned char  litLen[286], distLen[30];
+        unsigned short litCode[286], distCode[30];
+        BuildHuffman(litFreq, 286, 15, litLen, litCode);
+        BuildHuffman(distFreq, 30, 15, distLen, distCode);
+
+        int hlit = 286, hdist = 30;
+        while (hlit > 257 && !litLen[hlit - 1]) --hlit;
+        while (hdist > 1 && !distLen[hdist - 1]) --hdist;
+
+        // Длины обоих деревьев подряд, RLE кодами 16/17/18
+        unsigned char all[286 + 30];
+        memcpy(all, litLen, hlit);
+        memcpy(all + hlit, distLen, hdist);
+        const int total = hlit + hdist;
+        std::vector<unsigned short> rle;   // символ | доп. биты << 8
+        unsigned clFreq[19] = {};
+        for (int i = 0; i < total;) {
+            const unsigned char l = all[i];
+            int run = 1;
+            while (i + run < total && all[i + run] == l) ++run;
+            if (l == 0 && run >= 3) {
+                const int r = min(run, 138);
+                if (r <= 10) { rle.push_back((unsigned short)(17 | (r - 3) << 8));  ++clFreq[17]; }
+                else         { rle.push_back((unsigned short)(18 | (r - 11) << 8)); ++clFreq[18]; }
+                i += r;
+            } else if (l != 0 && run >= 4) {
+                rle.push_back(l); ++clFreq[l];
+                const int r = min(run - 1, 6);
+                rle.push_back((unsigned short)(16 | (r - 3) << 8)); ++clFreq[16];
+                i += 1 + r;
+            } else {
+                rle.push_back(l); ++clFreq[l];
+                ++i;
+            }
+        }
+        unsigned char  clLen[19];
+        unsigned short clCode[19];
+        BuildHuffman(clFreq, 19, 7, clLen, clCode);
+        static const unsigned char kClOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        int hclen = 19;
+        while (hclen > 4 && !clLen[kClOrder[hclen - 1]]) --hclen;
+
+        static const unsigned char kClExtra[19] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7 };
+        ULONGLONG bits = 17 + 3 * hclen;
+        for (unsigned short r : rle) bits += clLen[r & 0xFF] + kClExtra[r & 0xFF];
+        for (int s = 0; s < 286; ++s) bits += (ULONGLONG)litFreq[s] * (litLen[s] + (s > 256 ? t.lenExtra[s - 257] : 0));
+        for (int s = 0; s < 30; ++s)  bits += (ULONGLONG)distFreq[s] * (distLen[s] + t.distExtra[s]);
+        if (bits > rawLen * 8 + (rawLen / 65535 + 1) * 40) {
+            for (size_t off = 0; off < rawLen || off == 0; off += 65535) {
+                const unsigned len = (unsigned)min(rawLen - off, (size_t)65535);
+                bw.put(final && off + len == rawLen ? 1 : 0, 1);
+                bw.put(0, 2);
+                bw.align();
+                const unsigned char hdr[4] = { (unsigned char)len, (unsigned char)(len >> 8), (unsigned char)~len, (unsigned char)(~len >> 8) };
+                bw.out.append((const char*)hdr, 4);
+                bw.out.append((const char*)raw + off, len);
+                if (!len) break;
+            }
+        } else {
+            writeHuffman(bw, final, litLen, litCode, distLen, distCode, clLen, clCode, rle, hlit, hdist, hclen);
+        }
+
+        tokens.clear();
+        memset(litFreq, 0, sizeof(litFreq));
+        memset(distFreq, 0, sizeof(distFreq));
+    }
+
+    void writeHuffman(DeflateBits& bw, bool final, const unsigned char* litLen, const unsigned short* litCode,
+                      const unsigned char* distLen, const unsigned short* distCode, const unsigned char* clLen,
+                      const unsigned short* clCode, const std::vector<unsigned short>& rle, int hlit, int hdist, int hclen) {
+        const DeflateTables& t = GetDeflateTables();
+        static const unsigned char kClOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        bw.put(final ? 1 : 0, 1);
+        bw.put(2, 2);
+        bw.put((unsigned)(hlit - 257), 5);
+        bw.put((unsigned)(hdist - 1), 5);
+        bw.put((unsigned)(hclen - 4), 4);
+        for (int i = 0; i < hclen; ++i) bw.put(clLen[kClOrder[i]], 3);
+        for (unsigned short r : rle) {
+            const int s = r & 0xFF;
+            bw.put(clCode[s], clLen[s]);
+            if (s == 16) bw.put(r >> 8, 2);
+            else if (s == 17) bw.put(r >> 8, 3);
+            else if (s == 18) bw.put(r >> 8, 7);
+        }
+
+        for (unsigned tk : tokens) {
+            if (!(tk >> 31)) { bw.put(litCode[tk], litLen[tk]); continue; }
+            const unsigned l  = (tk >> 16) & 0xFF;
+            const unsigned d  = (tk & 0xFFFF) + 1;
+            const int      ls = t.lenSym[l];
+            bw.put(litCode[257 + ls], litLen[257 + ls]);
+            if (t.lenExtra[ls]) bw.put(l + 3 - t.lenBase[ls], t.lenExtra[ls]);
+            const int ds = t.distCode(d);
+            bw.put(distCode[ds], distLen[ds]);
+            if (t.distExtra[ds]) bw.put(d - t.distBase[ds], t.distExtra[ds]);
+        }
+        bw.put(litCode[256], litLen[256]);
+    }
+
+    void compress(const unsigned char* data, size_t start, size_t n, bool last, std::string& out) {
+        const DeflateTables& t = GetDeflateTables();
+        DeflateBits bw{ out };
+        std::fill(head.begin(), head.end(), -1);
+        tokens.clear();
+        tokens.reserve(kDeflateTokens);
+        memset(litFreq, 0, sizeof(litFreq));
+        memset(distFreq, 0, sizeof(distFreq));
+
+        // Словарь: только хэши, без вывода
+        for (size_t p = start > kDeflateWindow ? start - kDeflateWindow : 0; p + 4 <= start; ++p) insert(data, (int)p);
+
+        size_t pos = start, blockStart = start, misses = 0;
+        while (pos < n) {
+            if (tokens.size() >= kDeflateTokens) {
+                writeBlock(bw, false, data + blockStart, pos - blockStart);
+                blockStart = pos;
+            }
+
+            int bestLen = 0, bestDist = 0;
+            if (pos + 4 <= n) {
+                const size_t maxLen = min((size_t)258, n - pos);
+                int cand = head[Hash(data + pos)];
+                for (int chain = kDeflateChain; cand >= 0 && chain; --chain) {
+                    const size_t dist = pos - (size_t)cand;
+                    if (dist > kDeflateWindow) break;
+                    unsigned c4, p4;
+                    memcpy(&c4, data + cand, 4);
+                    memcpy(&p4, data + pos, 4);
+                    if (c4 == p4 && data[cand + bestLen] == data[pos + bestLen]) {
+                        size_t l = 0;
+#if defined(_M_IX86)
+                        // x86: _BitScanForward64 нет — по 4 байта, как в Lz4CompressBlock
+                        while (l + 4 <= maxLen) {
+                            unsigned x, y;
+                            memcpy(&x, data + cand + l, 4);
+                            memcpy(&y, data + pos + l, 4);
+                            if (x != y) { unsigned long i; _BitScanForward(&i, x ^ y); l += i >> 3; goto measured; }
+                            l += 4;
+                        }
+#else
+                        while (l + 8 <= maxLen) {
+                            ULONGLONG x, y;
+                            memcpy(&x, data + cand + l, 8);
+                            memcpy(&y, data + pos + l, 8);
+                            if (x != y) { unsigned long i; _BitScanForward64(&i, x ^ y); l += i >> 3; goto measured; }
+                            l += 8;
+                        }
+#endif
+                        while (l < maxLen && data[cand + l] == data[pos + l]) ++l;
+                    measured:
+                        if ((int)l > bestLen) {
+                            bestLen  = (int)l;
+                            bestDist = (int)dist;
+                            if (l == maxLen) break;
+                        }
+                    }
+                    const int next = prev[cand & (kDeflateWindow - 1)];
+                    if (next >= cand) break;   // слот окна уже перезаписан
+                    cand = next;
+                }
+                insert(data, (int)pos);
+            }
+
+            if (bestLen >= 4) {
+                tokens.push_back(1u << 31 | (unsigned)(bestLen - 3) << 16 | (unsigned)(bestDist - 1));
+                ++litFreq[257 + t.lenSym[bestLen - 3]];
+                ++distFreq[t.distCode((unsigned)bestDist)];
+                // Короткие совпадения вставляем целиком; в длинных сериях хватает хвоста
+                const size_t end = pos + bestLen;
+                size_t p = bestLen <= 16 ? pos + 1 : end - 3;
+                for (; p < end && p + 4 <= n; ++p) insert(data, (int)p);
+                pos = end;
+                misses = 0;
+            } else {
+                // Долго без совпадений (шум, фото) — часть литералов без поиска, как в LZ4
+                const size_t lits = min(1 + (++misses >> 8), n - pos);
+                for (size_t i = 0; i < lits; ++i, ++pos) {
+                    tokens.push_back(data[pos]);
+                    ++litFreq[data[pos]];
+                }
+            }
+        }
+
+        writeBlock(bw, last, data + blockStart, pos - blockStart);
+        if (!last) {
+            // Пустой stored-блок: кусок кончается на границе байта (sync flush)
+            bw.put(0, 3);
+            bw.align();
+            out.append("\x00\x00\xFF\xFF", 4);
+        }
+        bw.align();
+    }
+};
+
+static void PngPutBE32(std::string& s, unsigned v) {
+    const char b[4] = { (char)(v >> 24), (char)(v >> 16), (char)(v >> 8), (char)v };
+    s.append(b, 4);
+}
+
+// Чанк PNG из s[from..): длина и тип перед данными, CRC после
+static void PngFinishChunk(std::string& s, size_t from) {
+    const unsigned len = (unsigned)(s.size() - from - 8);
+    for (int i = 0; i < 4; ++i) s[from + i] = (char)(len >> (24 - 8 * i));
+    PngPutBE32(s, Crc32(0, (const unsigned char*)s.data() + from + 4, len + 4));
+}
+
+static void PngBeginChunk(std::string& s, const char* type) {
+    s.append(4, '\0');
+    s.append(type, 4);
+}
+
+bool EncodePng(const PngSource& img, std::string& png, int threads) {
+    if (img.width <= 0 || img.height <= 0 || (img.bytesPerPixel != 3 && img.bytesPerPixel != 4)) return false;
+    const size_t rowBytes = (size_t)img.width * 3;
+    const size_t line     = rowBytes + 1;                                  // с байтом фильтра
+    const int    bandRows = (int)max((size_t)1, kPngBand / line);
+    const int    bands    = (img.height + bandRows - 1) / bandRows;
+    const int    dictRows = (int)((kDeflateWindow + line - 1) / line);    // строк на словарь полосы
+
+    std::vector<std::string> parts(bands);
+    std::vector<unsigned>    adler(bands);
+    std::atomic<int>         nextBand{ 0 };
+
+    auto work = [&]() {
+        DeflateEncoder enc;
+        std::vector<unsigned char> rgb(2 * (kPngRowPad + rowBytes + 16));
+        std::vector<unsigned char> cand((size_t)kPngFilters * (line + 16));
+        std::vector<unsigned char> data;
+        unsigned char* rows[2] = { &rgb[kPngRowPad], &rgb[2 * kPngRowPad + rowBytes + 16] };
+        unsigned char* out[kPngFilters];
+        for (int f = 0; f < kPngFilters; ++f) out[f] = &cand[(size_t)f * (line + 16)];
+
+        for (int b; (b = nextBand++) < bands;) {
+            const int y0   = b * bandRows;
+            const int y1   = min(img.height, y0 + bandRows);
+            const int from = max(0, y0 - dictRows);   // строки словаря фильтруем заново
+
+            data.resize((size_t)(y1 - from) * line);
+            unsigned char* prevRow = rows[0];
+            unsigned char* curRow  = rows[1];
+            if (from > 0) DibRowToRgb(img.pixels + (from - 1) * img.stride, img.bytesPerPixel, img.width, prevRow);
+            else          memset(prevRow - kPngRowPad, 0, kPngRowPad + rowBytes + 16);
+            memset(curRow - kPngRowPad, 0, kPngRowPad);
+            for (int y = from; y < y1; ++y) {
+                DibRowToRgb(img.pixels + y * img.stride, img.bytesPerPixel, img.width, curRow);
+                const int f = FilterPngRow(curRow, prevRow, rowBytes, out);
+                memcpy(&data[(size_t)(y - from) * line], out[f], line);
+                std::swap(prevRow, curRow);
+            }
+
+            const size_t start = (size_t)(y0 - from) * line;
+            const size_t dict  = min(start, kDeflateWindow);
+            adler[b] = Adler32(1, data.data() + start, data.size() - start);
+
+            std::string& s = parts[b];
+            PngBeginChunk(s, "IDAT");
+            if (b == 0) s.append("\x78\x01", 2);   // заголовок zlib: deflate, окно 32 КБ
+            enc.compress(data.data() + start - dict, dict, data.size() - start + dict, b == bands - 1, s);
+            PngFinishChunk(s, 0);
+        }
+    };
+
+    if (threads <= 0) threads = (int)max(1u, std::thread::hardware_concurrency());
+    threads = min(threads, bands);
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i) pool.emplace_back(work);
+    work();
+    for (auto& t : pool) t.join();
+
+    png.assign("\x89PNG\r\n\x1A\n", 8);
+    size_t at = png.size();
+    PngBeginChunk(png, "IHDR");
+    PngPutBE32(png, (unsigned)img.width);
+    PngPutBE32(png, (unsigned)img.height);
+    png.append("\x08\x02\x00\x00\x00", 5);   // 8 бит, RGB, deflate, фильтры PNG, без interlace
+    PngFinishChunk(png, at);
+
+    unsigned sum = adler[0];
+    for (int b = 1; b < bands; ++b) {
+        const ULONGLONG len = (ULONGLONG)(min(img.height, (b + 1) * bandRows) - b * bandRows) * line;
+        sum = Adler32Combine(sum, adler[b], len);
+    }
+    for (auto& s : parts) { png += s; std::string().swap(s); }
+
+    at = png.size();
+    PngBeginChunk(png, "IDAT");
+    PngPutBE32(png, sum);
+    PngFinishChunk(png, at);
+
+    at = png.size();
+    PngBeginChunk(png, "IEND");
+    PngFinishChunk(png, at);
+    return true;
+}
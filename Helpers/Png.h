@@ -0,0 +1,30 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+
+// --- PNG-КОДЕР: ФИЛЬТРЫ СТРОК + МНОГОПОТОЧНЫЙ DEFLATE ("-paste") ---
+// Свой кодер вместо WIC, без внешних зависимостей: вход — сырой буфер BGR/BGRX
+// (строки DIB из буфера обмена), выход — RGB 8 бит, обычный PNG.
+//
+// Картинка режется на полосы строк ~kPngBand байт. Полосы сжимаются параллельно
+// и независимо, как у pigz: каждая — кусок ОДНОГО deflate-потока, словарь — последние
+// 32 КБ предыдущей полосы (их строки воркер фильтрует сам заново), в конце — пустой
+// stored-блок до границы байта. Поэтому куски просто склеиваются, а каждый воркер
+// сразу оформляет свой кусок отдельным IDAT со своим CRC. Adler-32 потока собирается
+// из сумм полос (Adler32Combine) и уходит последним IDAT.
+//
+// Фильтр строки — из пяти стандартных по минимуму суммы |байт| (эвристика libpng),
+// все пять считаются за один SSE2-проход. LZ77 — хэш-цепочки по 4 байтам, greedy;
+// блоки — динамический Хаффман с длинами кодов до 15 бит.
+
+// Источник пикселей: строка y сверху — pixels + y * stride (stride < 0 — DIB снизу вверх)
+struct PngSource {
+    const unsigned char* pixels        = nullptr;
+    int                  width         = 0;
+    int                  height        = 0;
+    int                  bytesPerPixel = 4;   // 3 — BGR, 4 — BGRX (альфа не пишется)
+    ptrdiff_t            stride        = 0;
+};
+
+// threads = 0 — по числу ядер
+bool EncodePng(const PngSource& img, std::string& png, int threads = 0);
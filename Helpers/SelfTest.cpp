@@ -0,0 +1,600 @@
+#include "SelfTest.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "Common.h"
+#include "ContentFilters.h"
+#include "Engine.h"
+
+void BenchText(std::mt19937_64& rng, std::string& out, size_t size) {
+    static const char* const kLines[] = {
+        "int value = compute(a, b);\n",
+        "    if (ptr == nullptr) return false;\n",
+        "// comment line with a few words in it\n",
+        "    for (size_t i = 0; i < n; ++i) sum += data[i];\n",
+        "struct Item { int id; const char* name; };\n",
+        "    result.push_back(std::move(item));\n",
+        "}\n",
+        "\n",
+    };
+    while (out.size() < size) out += kLines[rng() % 8];
+    out.resize(size);
+}
+
+void BenchHexArray(std::mt19937_64& rng, std::string& out, size_t size) {
+    const size_t start = out.size();
+    BenchText(rng, out, start + size / 8);
+    out += "static const unsigned char kBlob[] = {";
+    const size_t tableEnd = out.size() + size * 3 / 4;
+    char hex[8];
+    while (out.size() < tableEnd) {
+        snprintf(hex, sizeof(hex), "0x%02x, ", (unsigned)(rng() & 0xFF));
+        out += hex;
+        if (rng() % 16 == 0) out += "\n    ";
+    }
+    out += "};\n";
+    BenchText(rng, out, max(out.size(), start + size));
+}
+
+struct SelfTest {
+    std::string report;
+    int         passed = 0;
+    int         failed = 0;
+
+    static std::string Quote(const std::string& s) {
+        std::string q = "\"";
+        for (size_t i = 0; i < s.size() && i < 160; ++i) {
+            const unsigned char c = (unsigned char)s[i];
+            if      (c == '\n') q += "\\n";
+            else if (c == '\r') q += "\\r";
+            else if (c == '\t') q += "\\t";
+            else if (c < 0x20 || c >= 0x7F) { char b[8]; snprintf(b, sizeof(b), "\\x%02x", c); q += b; }
+            else q += (char)c;
+        }
+        return q + (s.size() > 160 ? "\"..." : "\"");
+    }
+
+    // Первые 100 провалов — в отчёт с входом, остальные только считаются
+    bool check(bool ok, const char* name, const std::string& input = std::string()) {
+        if (ok) { ++passed; return true; }
+        if (++failed <= 100) {
+            report += "FAIL ";
+            report += name;
+            if (!input.empty()) report += ": " + Quote(input);
+            report += '\n';
+        }
+        return false;
+    }
+};
+
+// Исходный автомат CleanHexArrays (до SIMD-ядер) — эталон для HexArrayFilter.
+// Без pre-check "= {" и лимита 500 КБ: это была политика вызывающего кода.
+static void RefCleanHexArrays(const char* src, size_t len, std::string& result) {
+    const char* cur = src;
+    const char* end = src + len;
+
+    while (cur < end) {
+        const char* eq = (const char*)memchr(cur, '=', (size_t)(end - cur));
+        if (!eq) { result.append(cur, end); break; }
+
+        result.append(cur, (size_t)(eq - cur));
+        cur = eq;
+
+        const char* s = eq + 1;
+        while (s < end && (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')) ++s;
+
+        if (s >= end || *s != '{') { result += *cur++; continue; }
+        ++s;
+
+        int  count = 0;
+        bool valid = true;
+        while (s < end) {
+            unsigned char c = (unsigned char)*s;
+            if (c == '}') break;
+            if ((c >= '0' && c <= '9') ||
+                (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F') ||
+                c == 'x' || c == 'X'  || c == ',' ||
+                c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                ++count; ++s;
+            } else { valid = false; break; }
+        }
+
+        if (!valid || s >= end || *s != '}') { result += *cur++; continue; }
+        ++s;
+        if (s >= end || *s != ';')           { result += *cur++; continue; }
+        ++s;
+
+        if (count >= 50) {
+            result += "= { /* HEX DATA HIDDEN */ };";
+            cur = s;
+        } else {
+            result += *cur++;
+        }
+    }
+}
+
+// Вход окнами, концы окон — cuts (по возрастанию, внутри входа)
+template<typename Filter>
+static void CleanWindowed(const std::string& src, const std::vector<size_t>& cuts, std::string& out) {
+    struct AppendSink {
+        std::string& s;
+        const char*  base;
+        void literal(const char* p, size_t n)   { s.append(p, n); }
+        void source(ULONGLONG off, ULONGLONG n) { s.append(base + off, (size_t)n); }
+    } sink{ out, src.data() };
+
+    Filter      f;
+    std::string win;
+    size_t      off = 0;
+    for (size_t i = 0; i <= cuts.size(); ++i) {
+        const size_t to = i < cuts.size() ? cuts[i] : src.size();
+        win.assign(src, off, to - off);
+        f.feed(win.data(), off, win.size(), sink, to == src.size());
+        off = to;
+    }
+    f.finish(src.size(), sink);
+}
+
+static void RandomCuts(std::mt19937_64& rng, size_t len, size_t maxWindow, std::vector<size_t>& cuts) {
+    cuts.clear();
+    for (size_t at = 1 + rng() % maxWindow; at < len; at += 1 + rng() % maxWindow) cuts.push_back(at);
+}
+
+// Кусочки около hex-массива: '=', скобки, пробельные, тело, мусор
+static void SelfTestHexInput(std::mt19937_64& rng, std::string& s, size_t len) {
+    static const char* const kParts[] = {
+        "=", " ", "{", "}", ";", "0x1F, ", "\r\n", "\t", "x", "g", "a", "=\n{", "= {", "};", "\n", "==", "={"
+    };
+    s.clear();
+    while (s.size() < len) {
+        if (rng() % 8) { s += kParts[rng() % 17]; continue; }
+        // Массив с телом вокруг порога в 50 байт, иногда с чужим байтом
+        s += rng() % 2 ? "= {" : "=\t\r\n{";
+        const size_t body = 44 + rng() % 12;
+        for (size_t i = 0; i < body; ++i) s += "0123456789abcdefABCDEFxX, \t\r\n"[rng() % 29];
+        if (rng() % 6 == 0) s[s.size() - 1 - rng() % body] = 'z';
+        s += rng() % 5 ? "};" : "} ;";
+    }
+    s.resize(len);
+}
+
+// Ядра тела hex-массива и его триггера: AVX2-, SSE2- и скалярный путь дают одно и то же
+static void SelfTestHexKernels(SelfTest& t, std::mt19937_64& rng) {
+    std::string s;
+    for (int iter = 0; iter < 2000; ++iter) {
+        const size_t len = rng() % 160;
+        SelfTestHexInput(rng, s, len);
+        const char* const end = s.data() + s.size();
+        for (size_t i = 0; i <= len; ++i) {
+            const char* expect = s.data() + i;
+            while (expect < end && IsHexBodyChar((unsigned char)*expect)) ++expect;
+            if (!t.check(SkipHexBody(s.data() + i, end) == expect, "SkipHexBody", s)) break;
+        }
+        // Маски читают блок + 32 байта lookahead
+        for (size_t b = 0; b + 64 <= len; ++b) {
+            const char*    p   = s.data() + b;
+            const unsigned m32 = HexArrayFilter::Trigger32(p);
+            const unsigned m16 = HexArrayFilter::Trigger16(p) | HexArrayFilter::Trigger16(p + 16) << 16;
+            unsigned       ref = 0;
+            for (int i = 0; i < 32; ++i) ref |= (unsigned)HexArrayFilter::Trigger(p + i, end) << i;
+            if (!t.check(m32 == ref && m16 == ref, "HexArrayFilter::Trigger32/16", s)) break;
+        }
+    }
+}
+
+// Фильтр целиком, на весь вход и окнами, против исходного автомата
+static void SelfTestHexFilter(SelfTest& t, std::mt19937_64& rng) {
+    std::string         s, ref, got;
+    std::vector<size_t> cuts;
+    auto compare = [&](const char* name) {
+        ref.clear();
+        RefCleanHexArrays(s.data(), s.size(), ref);
+        got.clear();
+        CleanHexArrays(s.data(), s.size(), got);
+        t.check(got == ref, name, s);
+        for (size_t maxWindow : { (size_t)1, (size_t)7, (size_t)33, (size_t)4096 }) {
+            RandomCuts(rng, s.size(), maxWindow, cuts);
+            got.clear();
+            CleanWindowed<ContentFilter<HexArrayFilter>>(s, cuts, got);
+            t.check(got == ref, "HexArrayFilter windowed", s);
+        }
+    };
+
+    for (int iter = 0; iter < 3000; ++iter) {
+        SelfTestHexInput(rng, s, rng() % 400);
+        compare("HexArrayFilter random");
+    }
+    // Массив с каждым сдвигом относительно блоков и телом у порога
+    for (size_t lead = 0; lead < 40; ++lead)
+        for (size_t body = 48; body <= 52; ++body)
+            for (size_t tail = 0; tail < 4; ++tail) {
+                s.assign(lead, ' ');
+                s += "= {";
+                for (size_t i = 0; i < body; ++i) s += i % 6 == 5 ? ',' : "0x7f"[i % 4];
+                s += "};";
+                s.append(tail, '\n');
+                compare("HexArrayFilter aligned");
+            }
+    // Большая таблица: тело проходит через много AVX2-блоков
+    s.clear();
+    BenchHexArray(rng, s, 64 * 1024);
+    compare("HexArrayFilter table");
+}
+
+// Вход → ожидаемый вывод одного трансформа: на весь вход, с одним разрезом окна
+// в каждой позиции и случайной нарезкой
+template<typename Filter>
+static void SelfTestCase(SelfTest& t, std::mt19937_64& rng, const char* name,
+                         const std::string& in, const std::string& expect) {
+    std::string         got;
+    std::vector<size_t> cuts;
+    CleanWith<Filter>(in.data(), in.size(), got);
+    if (!t.check(got == expect, name, in)) return;
+    for (size_t at = 1; at < in.size(); ++at) {
+        cuts.assign(1, at);
+        got.clear();
+        CleanWindowed<Filter>(in, cuts, got);
+        if (!t.check(got == expect, name, in)) return;
+    }
+    for (size_t maxWindow : { (size_t)1, (size_t)3, (size_t)17, (size_t)100 }) {
+        RandomCuts(rng, in.size(), maxWindow, cuts);
+        got.clear();
+        CleanWindowed<Filter>(in, cuts, got);
+        if (!t.check(got == expect, name, in)) return;
+    }
+}
+
+// Каждый трансформ на своих образцах: срабатывание, порог, отказ, "\r\n"
+static void SelfTestFilterCases(SelfTest& t, std::mt19937_64& rng) {
+    typedef ContentFilter<HexArrayFilter>     Hex;
+    typedef ContentFilter<Base64Filter>       B64;
+    typedef ContentFilter<SpaceRunFilter>     Space;
+    typedef ContentFilter<MinifiedLineFilter> Min;
+    typedef FilterSet<kXfAll>::type           All;
+
+    std::string body, crlfBody;
+    for (int i = 0; i < 16; ++i) {
+        char b[8];
+        snprintf(b, sizeof(b), "0x%02x, ", i * 17);
+        body += b;
+        crlfBody += b;
+        if (i % 8 == 7) crlfBody += "\r\n";
+    }
+    SelfTestCase<Hex>(t, rng, "HexArrayFilter case",
+        "static const unsigned char k[] = {" + body + "};\nint x;",
+        "static const unsigned char k[] = { /* HEX DATA HIDDEN */ };\nint x;");
+    SelfTestCase<Hex>(t, rng, "HexArrayFilter case CRLF",
+        "const BYTE k[] =\r\n{\r\n" + crlfBody + "};\r\n",
+        "const BYTE k[] = { /* HEX DATA HIDDEN */ };\r\n");
+    SelfTestCase<Hex>(t, rng, "HexArrayFilter case threshold",
+        "a = {" + std::string(50, '1') + "};", "a = { /* HEX DATA HIDDEN */ };");
+    for (const std::string& in : { "a = {" + std::string(49, '1') + "};", "a = {" + body + "} ;",
+                                   "a = {" + body + "g};", "a = {" + body })
+        SelfTestCase<Hex>(t, rng, "HexArrayFilter case untouched", in, in);
+
+    std::string b64;
+    while (b64.size() < 300) b64 += "QUJDRGVmZ2gxMjM0+/9z";
+    const std::string lower(300, 'q');
+    SelfTestCase<B64>(t, rng, "Base64Filter case URI",
+        "<img src=\"data:image/png;base64," + b64.substr(0, 64) + "==\">",
+        "<img src=\"data:image/png;base64,/* BASE64 DATA HIDDEN */\">");
+    SelfTestCase<B64>(t, rng, "Base64Filter case URI at end",
+        "url(data:font/woff2;base64," + b64.substr(0, 80),
+        "url(data:font/woff2;base64,/* BASE64 DATA HIDDEN */");
+    SelfTestCase<B64>(t, rng, "Base64Filter case quoted",
+        "k = \"" + b64.substr(0, 256) + "\";\r\n",
+        "k = \"/* BASE64 DATA HIDDEN */\";\r\n");
+    SelfTestCase<B64>(t, rng, "Base64Filter case quoted padded",
+        "k = '" + b64.substr(0, 290) + "==';",
+        "k = '/* BASE64 DATA HIDDEN */';");
+    for (const std::string& in : { "data:image/png;base64," + b64.substr(0, 63) + "==\"",
+                                   "k = \"" + b64.substr(0, 255) + "\";", "k = \"" + lower + "\";",
+                                   "k = \"" + b64.substr(0, 290) + "';", "k = `" + b64 })
+        SelfTestCase<B64>(t, rng, "Base64Filter case untouched", in, in);
+
+    SelfTestCase<Space>(t, rng, "SpaceRunFilter case",
+        "{\n    x;\n\n\n\n    y;\n}", "{\n    x;\n\n    y;\n}");
+    SelfTestCase<Space>(t, rng, "SpaceRunFilter case indented blanks",
+        "a\n  \n \t\n\n\n  b", "a\n\n  b");
+    SelfTestCase<Space>(t, rng, "SpaceRunFilter case CRLF",
+        "a;\r\n\r\n\r\n\r\n\r\n\tb;\r\n", "a;\r\n\r\n\tb;\r\n");
+    SelfTestCase<Space>(t, rng, "SpaceRunFilter case at end",
+        "a\r\n\r\n\r\n\r\n", "a\r\n\r\n");
+    SelfTestCase<Space>(t, rng, "SpaceRunFilter case spaces",
+        "a" + std::string(64, ' ') + "b", "a b");
+    SelfTestCase<Space>(t, rng, "SpaceRunFilter case threshold", "a\n\n\nb", "a\n\nb");
+    SelfTestCase<Space>(t, rng, "SpaceRunFilter case CRLF indented", "a\r\n\r\n  \r\nb", "a\r\n\r\nb");
+    // Третий '\n' дальше kGap: триггера нет ни целиком, ни на стыке окон
+    for (const std::string& in : { std::string("a\n\nb"), std::string("a\r\n\r\n\tb\r\n"),
+                                   "a" + std::string(63, ' ') + "b", std::string("a\n\n        \n\nb") })
+        SelfTestCase<Space>(t, rng, "SpaceRunFilter case untouched", in, in);
+
+    const std::string line(4096, 'a');
+    SelfTestCase<Min>(t, rng, "MinifiedLineFilter case",
+        "x\n" + line + "\ny", "x\n/* MINIFIED LINE HIDDEN: 4096 bytes */\ny");
+    SelfTestCase<Min>(t, rng, "MinifiedLineFilter case CRLF",
+        "x\r\n" + line + "\r\ny\r\n", "x\r\n/* MINIFIED LINE HIDDEN: 4096 bytes */\r\ny\r\n");
+    SelfTestCase<Min>(t, rng, "MinifiedLineFilter case first line",
+        line + "bcd\nend\n", "/* MINIFIED LINE HIDDEN: 4099 bytes */\nend\n");
+    SelfTestCase<Min>(t, rng, "MinifiedLineFilter case last line",
+        "x\n" + line, "x\n/* MINIFIED LINE HIDDEN: 4096 bytes */");
+    for (const std::string& in : { "x\n" + line.substr(1) + "\ny", "x\r\n" + line.substr(1) + "\r\ny",
+                                   line.substr(1), "x\n" + line.substr(1) })
+        SelfTestCase<Min>(t, rng, "MinifiedLineFilter case untouched", in, in);
+    // Строка длиннее kCarry: копии кандидата нет, '\r' перед '\n' — в прошлом окне
+    const std::string longLine(9000, 'q');
+    SelfTestCase<Min>(t, rng, "MinifiedLineFilter case long CRLF",
+        "x\r\n" + longLine + "\r\ny\r\n", "x\r\n/* MINIFIED LINE HIDDEN: 9000 bytes */\r\ny\r\n");
+    SelfTestCase<FilterSet<kXfSpace | kXfMinified>::type>(t, rng, "FilterSet case long CRLF",
+        "a\n" + longLine + "\r\n\r\n\r\n\r\nx", "a\n/* MINIFIED LINE HIDDEN: 9000 bytes */\r\n\r\nx");
+
+    // Все вместе: серия оставляет '\n', с которого меряется длинная строка.
+    // Короткая строка через границу окна отказывает, и её начало в прошлых окнах
+    // разбирается заново другими трансформами.
+    SelfTestCase<All>(t, rng, "FilterSet case",
+        "k = {" + body + "};\r\n\r\n\r\n\r\n" + line + "\r\ns = \"" + b64.substr(0, 256) + "\";",
+        "k = { /* HEX DATA HIDDEN */ };\r\n\r\n/* MINIFIED LINE HIDDEN: 4096 bytes */\r\n"
+        "s = \"/* BASE64 DATA HIDDEN */\";");
+    SelfTestCase<All>(t, rng, "FilterSet case short lines",
+        "x\nk = {" + body + "};\ny" + std::string(70, ' ') + "z\n\n\n\nw",
+        "x\nk = { /* HEX DATA HIDDEN */ };\ny z\n\nw");
+    SelfTestCase<All>(t, rng, "FilterSet case first line",
+        "k = {" + body + "};", "k = { /* HEX DATA HIDDEN */ };");
+    SelfTestCase<All>(t, rng, "FilterSet case last line",
+        "x\r\ns = '" + b64.substr(0, 256) + "'", "x\r\ns = '/* BASE64 DATA HIDDEN */'");
+}
+
+// Все трансформы вместе окнами против прохода целиком на случайной смеси
+static void SelfTestFilterSet(SelfTest& t, std::mt19937_64& rng) {
+    typedef FilterSet<kXfAll>::type All;
+    static const char* const kParts[] = {
+        "\n", "\r\n", "    ", "\t", "x", ";", "= {", "0x1F, ", "};", "\"", "QUJD", "data:a;base64,", "\n\n\n"
+    };
+    std::string         s, ref, got;
+    std::vector<size_t> cuts;
+    for (int iter = 0; iter < 2000; ++iter) {
+        s.clear();
+        const size_t len = rng() % 600;
+        while (s.size() < len) {
+            const unsigned k = (unsigned)(rng() % 16);
+            if (k < 13) s += kParts[k];
+            else if (k == 13) s.append(16 + rng() % 80, ' ');
+            else if (k == 14) for (int i = 0; i < 12; ++i) s += "0x7f, ";
+            else s.append(rng() % 2 ? 64 : 260, "QUJDRGVm"[rng() % 8]);
+        }
+        // Изредка длинная строка — MinifiedLineFilter срабатывает
+        if (rng() % 8 == 0) s.insert(rng() % (s.size() + 1), std::string(4096 + rng() % 8, 'm'));
+        ref.clear();
+        CleanWith<All>(s.data(), s.size(), ref);
+        for (size_t maxWindow : { (size_t)1, (size_t)7, (size_t)64, (size_t)1000 }) {
+            RandomCuts(rng, s.size(), maxWindow, cuts);
+            got.clear();
+            CleanWindowed<All>(s, cuts, got);
+            if (!t.check(got == ref, "FilterSet windowed", s)) break;
+        }
+    }
+}
+
+// Ядро целиком на маленьком дереве: all.txt и file_list.txt в папке против того же
+// прогона в поток (EngineContext::out), повторный -dump (блоки старого all.txt по
+// манифесту) — против первого
+static void SelfTestEngine(SelfTest& t, const std::wstring& dir) {
+    const std::wstring tree       = dir + L"selftest.tree\\";
+    const std::wstring streamPath = dir + L"selftest.stream.txt";
+
+    std::string     hex = "static const unsigned char k[] = {", big;
+    std::mt19937_64 rng(2);
+    for (int i = 0; i < 64; ++i) hex += "0x1f, ";
+    hex += "};\r\nint x;\r\n";
+    BenchText(rng, big, 4096);   // крупнее kDupMinSize: копии идут ссылкой
+    const struct { const wchar_t* name; std::string data; } files[] = {
+        { L"a.cpp",        hex },
+        { L"big.h",        big },
+        { L"sub\\copy1.h", big },
+        { L"sub\\copy2.h", big },
+        { L"skip.txt",     "SKIPPED\n" },
+        { L".gitignore",   "skip.txt\n" },
+        { L"blob.dat",     std::string("\0\1\2\3", 4) },
+    };
+    static const wchar_t* const kOutputs[] = { L"all.txt", L"all.manifest", L"file_list.txt", L"file_list.idx" };
+    auto cleanup = [&]() {
+        for (auto& f : files) DeleteFileW((tree + f.name).c_str());
+        for (auto n : kOutputs) DeleteFileW((tree + n).c_str());
+        DeleteFileW(streamPath.c_str());
+        RemoveDirectoryW((tree + L"sub").c_str());
+        RemoveDirectoryW(tree.c_str());
+    };
+    cleanup();
+    CreateDirectoryW(tree.c_str(), NULL);
+    CreateDirectoryW((tree + L"sub").c_str(), NULL);
+    for (auto& f : files) WriteWholeFile(tree + f.name, f.data);
+
+    // Вывод прогона: файл в папке или поток в streamPath (рядом с деревом, не внутри)
+    auto run = [&](bool dump, bool stream, std::string& out) {
+        EngineContext ctx;
+        if (stream) {
+            ctx.out = CreateFileW(streamPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (ctx.out == INVALID_HANDLE_VALUE) return false;
+        }
+        const bool ok = dump ? GenerateAllTxt(ctx, tree) : GenerateFileList(ctx, tree);
+        if (stream) CloseHandle(ctx.out);
+        out.clear();
+        return ok && ReadWholeFile((stream ? streamPath : tree + (dump ? L"all.txt" : L"file_list.txt")).c_str(), out);
+    };
+
+    std::string file, stream, again;
+    if (t.check(run(true, false, file), "Engine -dump to file")) {
+        t.check(file.find("HEX DATA HIDDEN") != std::string::npos &&
+                file.find("[same content as: ") != std::string::npos &&
+                file.find("SKIPPED") == std::string::npos, "Engine -dump content", file);
+        t.check(run(true, true, stream) && stream == file, "Engine -dump to stream", stream);
+        t.check(run(true, false, again) && again == file, "Engine -dump incremental", again);
+    }
+    if (t.check(run(false, false, file), "Engine -list to file")) {
+        t.check(file.find("big.h") != std::string::npos && file.find("skip.txt") == std::string::npos,
+                "Engine -list content", file);
+        t.check(run(false, true, stream) && stream == file, "Engine -list to stream", stream);
+    }
+    cleanup();
+}
+
+// Блок LZ4 → out (эталонный разбор формата, без оптимизаций)
+static bool Lz4DecodeBlock(const unsigned char* p, size_t n, std::string& out) {
+    const unsigned char* end  = p + n;
+    const size_t         base = out.size();
+    while (p < end) {
+        const unsigned token = *p++;
+        size_t         lit   = token >> 4;
+        for (unsigned b = lit == 15 ? 255 : 0; b == 255; lit += b) {
+            if (p == end) return false;
+            b = *p++;
+        }
+        if ((size_t)(end - p) < lit) return false;
+        out.append((const char*)p, lit);
+        p += lit;
+        if (p == end) break;   // последняя последовательность — только литералы
+        if (end - p < 2) return false;
+        const size_t off = (size_t)p[0] | (size_t)p[1] << 8;
+        size_t       len = (token & 15) + 4;
+        p += 2;
+        for (unsigned b = (token & 15) == 15 ? 255 : 0; b == 255; len += b) {
+            if (p == end) return false;
+            b = *p++;
+        }
+        if (!off || off > out.size() - base) return false;
+        for (size_t i = out.size() - off; len; --len, ++i) out += out[i];
+    }
+    return true;
+}
+
+// Файл из кадров LZ4 → текст; skippable-кадры (индекс) пропускаются
+static bool Lz4DecodeFile(const std::string& in, std::string& out) {
+    const unsigned char* p   = (const unsigned char*)in.data();
+    const unsigned char* end = p + in.size();
+    auto u32 = [](const unsigned char* q) {
+        return (unsigned)q[0] | (unsigned)q[1] << 8 | (unsigned)q[2] << 16 | (unsigned)q[3] << 24;
+    };
+    while (p < end) {
+        if (end - p < 8) return false;
+        const unsigned magic = u32(p);
+        if ((magic & 0xFFFFFFF0u) == 0x184D2A50u) {
+            const size_t n = u32(p + 4);
+            if ((size_t)(end - p) - 8 < n) return false;
+            p += 8 + n;
+            continue;
+        }
+        if (magic != 0x184D2204u) return false;
+        const unsigned flg = p[4];
+        p += 7 + (flg & 0x08 ? 8 : 0) + (flg & 0x01 ? 4 : 0);
+        for (;;) {
+            if (end - p < 4) return false;
+            const unsigned word = u32(p);
+            p += 4;
+            if (!word) break;
+            const size_t n = word & 0x7FFFFFFFu;
+            if ((size_t)(end - p) < n) return false;
+            if (word & 0x80000000u)                out.append((const char*)p, n);
+            else if (!Lz4DecodeBlock(p, n, out)) return false;
+            p += n + (flg & 0x10 ? 4 : 0);
+        }
+        if (flg & 0x04) p += 4;
+    }
+    return p == end;
+}
+
+// Дамп lz4 с повторами против обычного дампа в поток. Копиям кластеры выделяются
+// в обратном порядке обхода (FlushFileBuffers от последней к первой), а elevator=2
+// отдаёт задачи по LCN: копия с большим номером приходит к воркеру раньше, и ссылки
+// на первую копию дописывает писатель — свой кадр на каждую (см. ДЕДУПЛИКАЦИЯ).
+// Без LCN (ФС без FIEMAP, сеть) копии идут по порядку — сравнение то же.
+static void SelfTestDumpLz4(SelfTest& t, const std::wstring& dir) {
+    const std::wstring tree       = dir + L"selftest.lz4\\";
+    const std::wstring streamPath = dir + L"selftest.stream.txt";
+
+    std::mt19937_64          rng(3);
+    std::string              small, large, unique;
+    std::vector<std::string> names;
+    BenchText(rng, small, 4096);         // в arena-блоке: ссылку вклеивает писатель
+    BenchText(rng, large, 96 * 1024);    // крупнее kArenaFile: ссылку пишет писатель
+    for (int i = 0; i < 6; ++i) {
+        names.push_back("s" + std::to_string(i) + ".txt");
+        names.push_back("l" + std::to_string(i) + ".txt");
+    }
+    for (int i = 0; i < 120; ++i) names.push_back("u" + std::to_string(i) + ".txt");
+    auto pathOf = [&](const std::string& n) { return tree + std::wstring(n.begin(), n.end()); };
+    auto cleanup = [&]() {
+        for (const std::string& n : names) DeleteFileW(pathOf(n).c_str());
+        DeleteFileW((tree + L"all.txt.lz4").c_str());
+        DeleteFileW(streamPath.c_str());
+        RemoveDirectoryW(tree.c_str());
+    };
+    cleanup();
+    CreateDirectoryW(tree.c_str(), NULL);
+    for (const std::string& n : names) {
+        unique.clear();
+        if (n[0] == 'u') BenchText(rng, unique, 300);   // мельче kDupMinSize — не дубликат
+        WriteWholeFile(pathOf(n), n[0] == 's' ? small : n[0] == 'l' ? large : unique);
+    }
+
+    std::string plain, packed, text;
+    {
+        EngineContext ctx;
+        ctx.out = CreateFileW(streamPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        bool ok = ctx.out != INVALID_HANDLE_VALUE && GenerateAllTxt(ctx, tree);
+        if (ctx.out != INVALID_HANDLE_VALUE) CloseHandle(ctx.out);
+        ok = ok && ReadWholeFile(streamPath.c_str(), plain);
+        size_t refs = 0;
+        for (size_t at = 0; (at = plain.find("[same content as: ", at)) != std::string::npos; ++at) ++refs;
+        if (!t.check(ok && refs >= 3, "Engine -dump duplicates", plain)) { cleanup(); return; }
+    }
+
+    // Порядок обхода — по обычному дампу
+    const std::string all = "\n" + plain;
+    std::vector<std::pair<size_t, std::string>> copies;
+    for (const std::string& n : names)
+        if (n[0] != 'u') copies.push_back({ all.find("\n" + n + ":\n"), n });
+    std::sort(copies.rbegin(), copies.rend());
+    for (auto& c : copies) {
+        HANDLE h = CreateFileW(pathOf(c.second).c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (h == INVALID_HANDLE_VALUE) continue;
+        FlushFileBuffers(h);
+        CloseHandle(h);
+    }
+
+    for (int workers : { 1, 8 }) {
+        EngineContext ctx;
+        ctx.opt.workers  = workers;
+        ctx.opt.elevator = 2;
+        ctx.opt.lz4      = true;
+        packed.clear();
+        text.clear();
+        const bool ok = GenerateAllTxt(ctx, tree) && ReadWholeFile((tree + L"all.txt.lz4").c_str(), packed);
+        if (!t.check(ok && Lz4DecodeFile(packed, text) && text == plain, "Engine -dump lz4 duplicates", text)) break;
+    }
+    cleanup();
+}
+
+static bool RunSelfTests(const std::wstring& dir, std::string& report) {
+    SelfTest        t;
+    std::mt19937_64 rng(1);
+    SelfTestHexKernels(t, rng);
+    SelfTestHexFilter(t, rng);
+    SelfTestFilterCases(t, rng);
+    SelfTestFilterSet(t, rng);
+    SelfTestEngine(t, dir);
+    SelfTestDumpLz4(t, dir);
+
+    char line[96];
+    snprintf(line, sizeof(line), "%s: %d passed, %d failed\n", t.failed ? "FAILED" : "OK", t.passed, t.failed);
+    report = line + t.report;
+    return t.failed == 0;
+}
+
+int RunSelfTest(const std::wstring& folderPath) {
+    std::wstring dir = folderPath;
+    if (!dir.empty() && dir.back() != L'\\') dir += L'\\';
+    std::string report;
+    const bool ok = RunSelfTests(dir, report);
+    WriteWholeFile(dir + L"selftest.txt", report);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "Platform.h"
+#include <random>
+#include <string>
+
+// --- САМОПРОВЕРКА: -selftest "<папка>" ---
+// Ядра и трансформы против эталонов: случайные входы, длины и смещения вокруг границ
+// блоков 16/32 байт (там AVX2 отдаёт хвост SSE2, а SSE2 — скалярному циклу) и нарезка
+// входа на окна, как у StreamCleanFile. Окно копируется в свой буфер ровно по размеру,
+// так что чтение за его концом видно по результату. Каждый трансформ — ещё и на
+// образцах с ожидаемым выводом, в т.ч. с "\r\n" и разрезом окна в каждой позиции.
+// Ядро -list/-dump — на маленьких деревьях: вывод в папку против вывода в поток,
+// распакованный дамп lz4 с повторами против обычного.
+// Итог — <папка>\selftest.txt; при любом расхождении код возврата 1.
+int RunSelfTest(const std::wstring& folderPath);
+
+// Генераторы содержимого — общие с -bench
+void BenchText(std::mt19937_64& rng, std::string& out, size_t size);
+// ~3/4 файла — hex-таблица, вокруг обычный код
+void BenchHexArray(std::mt19937_64& rng, std::string& out, size_t size);
@@ -0,0 +1,146 @@
+#include "Text.h"
+#include <climits>
+
+bool HasNullByte(const char* data, size_t len) {
+    const char* p   = data;
+    const char* end = data + len;
+
+#if defined(__AVX2__)
+    const __m256i z256 = _mm256_setzero_si256();
+    for (; p + 32 <= end; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, z256))) return true;
+    }
+#endif
+    const __m128i z128 = _mm_setzero_si128();
+    for (; p + 16 <= end; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, z128))) return true;
+    }
+    for (; p < end; ++p)
+        if (!*p) return true;
+    return false;
+}
+
+TextScan ScanText(const char* p, size_t n) {
+    TextScanner  sc;
+    const char*  end = p + n;
+    for (; end - p >= 64; p += 64) sc.feed64(p);
+    return sc.finish(p, (size_t)(end - p));
+}
+
+TextKind DetectTextKind(const char* p, size_t n, size_t& bom) {
+    const unsigned char* u = (const unsigned char*)p;
+    bom = 0;
+    if (n >= 3 && u[0] == 0xEF && u[1] == 0xBB && u[2] == 0xBF) { bom = 3; return kTextUtf8; }
+    if (n >= 2 && u[0] == 0xFF && u[1] == 0xFE) { bom = 2; return kTextUtf16LE; }
+    if (n >= 2 && u[0] == 0xFE && u[1] == 0xFF) { bom = 2; return kTextUtf16BE; }
+
+    // Латиница в UTF-16: ноль в каждом втором байте, в другой половине нулей нет
+    const size_t pairs = min(n, (size_t)512) / 2;
+    if (pairs < 8) return kTextUtf8;
+    size_t zeroEven = 0, zeroOdd = 0;
+    for (size_t i = 0; i < pairs; ++i) {
+        zeroEven += !u[2 * i];
+        zeroOdd  += !u[2 * i + 1];
+    }
+    if (!zeroEven && zeroOdd * 4 >= pairs * 3) return kTextUtf16LE;
+    if (!zeroOdd && zeroEven * 4 >= pairs * 3) return kTextUtf16BE;
+    return kTextUtf8;
+}
+
+static __forceinline char* PutUtf8(char* d, unsigned cp) {
+    if (cp < 0x800) {
+        *d++ = (char)(0xC0 | (cp >> 6));
+    } else if (cp < 0x10000) {
+        *d++ = (char)(0xE0 | (cp >> 12));
+        *d++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+    } else {
+        *d++ = (char)(0xF0 | (cp >> 18));
+        *d++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *d++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+    }
+    *d++ = (char)(0x80 | (cp & 0x3F));
+    return d;
+}
+
+TextScan Utf16ToUtf8(const char* p, size_t n, bool be, std::string& out) {
+    TextScan     s;
+    const size_t units = n / 2;
+    out.resize(units * 3 + 1);
+    char* const  d0 = &out[0];
+    char*        d  = d0;
+    size_t       i  = 0;
+
+    auto unit = [&](size_t k) -> unsigned {
+        const unsigned char* u = (const unsigned char*)p + 2 * k;
+        return be ? (unsigned)(u[0] << 8 | u[1]) : (unsigned)(u[1] << 8 | u[0]);
+    };
+    auto one = [&]() {
+        unsigned cp = unit(i++);
+        if (cp < 0x80) {
+            if (IsCtrlByte((unsigned char)cp)) { ++s.ctrl; s.nul |= cp == 0; }
+            *d++ = (char)cp;
+            return;
+        }
+        if (cp >= 0xD800 && cp <= 0xDFFF) {
+            const unsigned lo = i < units ? unit(i) : 0;
+            if (cp <= 0xDBFF && lo >= 0xDC00 && lo <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                ++i;
+            } else {
+                cp = 0xFFFD;
+                ++s.ctrl;
+            }
+        }
+        d = PutUtf8(d, cp);
+    };
+
+    const __m128i high = _mm_set1_epi16((short)0xFF80);
+    while (i + 8 <= units) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + 2 * i));
+        if (be) v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, high), _mm_setzero_si128())) == 0xFFFF) {
+            const __m128i b = _mm_packus_epi16(v, v);
+            if (unsigned m = CtrlMask(b) & 0xFF) {
+                s.ctrl += PopCount32(m);
+                s.nul  |= (_mm_movemask_epi8(_mm_cmpeq_epi8(b, _mm_setzero_si128())) & 0xFF) != 0;
+            }
+            _mm_storel_epi64((__m128i*)d, b);
+            d += 8;
+            i += 8;
+            continue;
+        }
+        for (const size_t stop = i + 8; i < stop; ) one();
+    }
+    while (i < units) one();
+    if (n & 1) ++s.ctrl;
+
+    out.resize((size_t)(d - d0));
+    return s;
+}
+
+// ANSI-кодовая страница системы → UTF-8 (через UTF-16)
+static bool AnsiToUtf8(const char* p, size_t n, std::string& out, std::wstring& wide) {
+    if (n > (size_t)INT_MAX / 3) return false;
+    wide.resize(n);
+    const int wn = MultiByteToWideChar(CP_ACP, 0, p, (int)n, &wide[0], (int)n);
+    if (wn <= 0) return false;
+    out.resize((size_t)wn * 3);
+    const int un = WideCharToMultiByte(CP_UTF8, 0, wide.data(), wn, &out[0], wn * 3, NULL, NULL);
+    if (un <= 0) return false;
+    out.resize((size_t)un);
+    return true;
+}
+
+bool LooksLikeAnsi(const char* p, size_t n) {
+    Utf8Scalar u;
+    u.feed((const unsigned char*)p, n);
+    u.finish();
+    return u.bad > u.seqs;
+}
+
+bool RecodeText(TextKind kind, const char* p, size_t n, std::string& text, std::wstring& wide) {
+    if (kind != kTextUtf8) return !IsBinaryText(Utf16ToUtf8(p, n, kind == kTextUtf16BE, text), n / 2);
+    return AnsiToUtf8(p, n, text, wide);
+}
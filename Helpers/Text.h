@@ -0,0 +1,237 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <cstring>
+#include <immintrin.h>   // AVX2
+
+// --- SIMD ПОИСК НУЛЕВОГО БАЙТА ---
+// SSE2 (гарантирован на x64) + AVX2 при наличии /arch:AVX2
+bool HasNullByte(const char* data, size_t len);
+
+// --- КЛАССИФИКАЦИЯ ТЕКСТА: UTF-8 + УПРАВЛЯЮЩИЕ БАЙТЫ ---
+// Идёт полосами по 64 байта внутри прохода HashScan — содержимое читается один раз.
+// Проверка UTF-8 в AVX2 — табличная схема Кейзера–Лемира (simdjson/simdutf): три
+// pshufb по полубайтам пары соседних байт дают маску ошибок, длина 3/4-байтных
+// последовательностей сверяется через prev2/prev3. Полоса из одного ASCII — только
+// movemask. Без AVX2 pshufb нет (SSE2), поэтому не-ASCII полосы проверяет
+// скалярный автомат Utf8Scalar. Управляющие байты (C0 без \t \n \v \f \r и ESC)
+// считаются в обоих слоях сравнениями.
+
+// Итог классификации содержимого
+struct TextScan {
+    ULONGLONG ctrl = 0;       // управляющих байт (NUL тоже)
+    bool      nul  = false;
+    bool      utf8 = true;    // корректный UTF-8 (чистый ASCII — тоже)
+};
+
+// Больше 1% управляющих байт или хоть один NUL — бинарный файл
+static const ULONGLONG kTextMaxCtrlPermille = 10;
+
+__forceinline bool IsBinaryText(const TextScan& s, ULONGLONG n) {
+    return s.nul || s.ctrl * 1000 > n * kTextMaxCtrlPermille;
+}
+
+__forceinline unsigned PopCount32(unsigned m) {
+    m = m - ((m >> 1) & 0x55555555u);
+    m = (m & 0x33333333u) + ((m >> 2) & 0x33333333u);
+    return (((m + (m >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+}
+
+__forceinline bool IsCtrlByte(unsigned char c) {
+    return c < 0x20 && !(c >= 0x09 && c <= 0x0D) && c != 0x1B;
+}
+
+// Скалярный валидатор UTF-8 с переносом состояния между кусками. После ошибки
+// байт разбирается заново как начало последовательности: bad — число ошибок,
+// seqs — корректных многобайтных последовательностей.
+struct Utf8Scalar {
+    unsigned      need = 0;                // сколько продолжений ещё ждём
+    unsigned char lo = 0x80, hi = 0xBF;    // диапазон следующего продолжения
+    ULONGLONG     bad = 0, seqs = 0;
+
+    void feed(const unsigned char* p, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            const unsigned char c = p[i];
+            if (need) {
+                if (c >= lo && c <= hi) {
+                    lo = 0x80; hi = 0xBF;
+                    if (--need == 0) ++seqs;
+                    continue;
+                }
+                ++bad; need = 0; lo = 0x80; hi = 0xBF;
+            }
+            if (c < 0x80) continue;
+            if      (c >= 0xC2 && c <= 0xDF) need = 1;
+            else if (c == 0xE0)              { need = 2; lo = 0xA0; }   // overlong
+            else if (c == 0xED)              { need = 2; hi = 0x9F; }   // суррогаты
+            else if (c >= 0xE1 && c <= 0xEF) need = 2;
+            else if (c == 0xF0)              { need = 3; lo = 0x90; }   // overlong
+            else if (c == 0xF4)              { need = 3; hi = 0x8F; }   // > U+10FFFF
+            else if (c >= 0xF1 && c <= 0xF3) need = 3;
+            else ++bad;
+        }
+    }
+    bool finish() { if (need) { ++bad; need = 0; } return bad == 0; }
+};
+
+#if defined(__AVX2__)
+// Предыдущие N байт к каждой позиции: хвост prev + начало in
+template<int N>
+__forceinline __m256i Utf8Prev(__m256i in, __m256i prev) {
+    return _mm256_alignr_epi8(in, _mm256_permute2x128_si256(prev, in, 0x21), 16 - N);
+}
+
+__forceinline __m256i Utf8Errors(__m256i in, __m256i prev) {
+    enum : unsigned char {
+        kTooShort = 1 << 0, kTooLong = 1 << 1, kOverlong3 = 1 << 2, kTooLarge = 1 << 3,
+        kSurrogate = 1 << 4, kOverlong2 = 1 << 5, kTooLarge1000 = 1 << 6, kOverlong4 = 1 << 6,
+        kTwoConts = 1 << 7, kCarry = kTooShort | kTooLong | kTwoConts
+    };
+#define HELPERS_LUT16(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+    // Старший полубайт первого байта пары
+    const __m256i byte1High = HELPERS_LUT16(
+        kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+        kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+        kTooShort | kOverlong2, kTooShort, kTooShort | kOverlong3 | kSurrogate,
+        kTooShort | kTooLarge | kTooLarge1000 | kOverlong4);
+    // Младший полубайт первого байта
+    const __m256i byte1Low = HELPERS_LUT16(
+        kCarry | kOverlong3 | kOverlong2 | kOverlong4, kCarry | kOverlong2, kCarry, kCarry,
+        kCarry | kTooLarge, kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000);
+    // Старший полубайт второго байта
+    const __m256i byte2High = HELPERS_LUT16(
+        kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4,
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge,
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+        kTooShort, kTooShort, kTooShort, kTooShort);
+#undef HELPERS_LUT16
+    const __m256i nib   = _mm256_set1_epi8(0x0F);
+    const __m256i prev1 = Utf8Prev<1>(in, prev);
+    const __m256i sc = _mm256_and_si256(_mm256_and_si256(
+        _mm256_shuffle_epi8(byte1High, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nib)),
+        _mm256_shuffle_epi8(byte1Low,  _mm256_and_si256(prev1, nib))),
+        _mm256_shuffle_epi8(byte2High, _mm256_and_si256(_mm256_srli_epi16(in, 4), nib)));
+    // Третий/четвёртый байт 3- и 4-байтных последовательностей обязан быть продолжением
+    const __m256i must23 = _mm256_or_si256(
+        _mm256_subs_epu8(Utf8Prev<2>(in, prev), _mm256_set1_epi8((char)(0xE0 - 0x80))),
+        _mm256_subs_epu8(Utf8Prev<3>(in, prev), _mm256_set1_epi8((char)(0xF0 - 0x80))));
+    return _mm256_xor_si256(_mm256_and_si256(must23, _mm256_set1_epi8((char)0x80)), sc);
+}
+
+__forceinline unsigned CtrlMask(__m256i v) {
+    const __m256i c0 = _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), v),
+                                        _mm256_cmpgt_epi8(v, _mm256_set1_epi8(-1)));
+    const __m256i w  = _mm256_sub_epi8(v, _mm256_set1_epi8(0x09));   // \t..\r → 0..4
+    const __m256i ok = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(w, _mm256_set1_epi8(4)), w),
+                                       _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x1B)));
+    return (unsigned)_mm256_movemask_epi8(_mm256_andnot_si256(ok, c0));
+}
+#endif
+
+__forceinline unsigned CtrlMask(__m128i v) {
+    const __m128i c0 = _mm_and_si128(_mm_cmplt_epi8(v, _mm_set1_epi8(0x20)),
+                                     _mm_cmpgt_epi8(v, _mm_set1_epi8(-1)));
+    const __m128i w  = _mm_sub_epi8(v, _mm_set1_epi8(0x09));
+    const __m128i ok = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(w, _mm_set1_epi8(4)), w),
+                                    _mm_cmpeq_epi8(v, _mm_set1_epi8(0x1B)));
+    return (unsigned)_mm_movemask_epi8(_mm_andnot_si128(ok, c0));
+}
+
+struct TextScanner {
+    TextScan res;
+#if defined(__AVX2__)
+    __m256i err  = _mm256_setzero_si256();
+    __m256i prev = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();   // последовательность не дописана к концу полосы
+#else
+    Utf8Scalar u8;
+#endif
+
+    __forceinline void ctrl(const char* p, unsigned m) {
+        if (!m) return;
+        res.ctrl += PopCount32(m);
+        for (; m; m &= m - 1) {
+            unsigned long i;
+            _BitScanForward(&i, m);
+            if (!p[i]) { res.nul = true; break; }
+        }
+    }
+
+    __forceinline void feed64(const char* p) {
+#if defined(__AVX2__)
+        const __m256i a = _mm256_loadu_si256((const __m256i*)p);
+        const __m256i b = _mm256_loadu_si256((const __m256i*)(p + 32));
+        ctrl(p,      CtrlMask(a));
+        ctrl(p + 32, CtrlMask(b));
+        if (!_mm256_movemask_epi8(_mm256_or_si256(a, b))) {
+            err = _mm256_or_si256(err, incomplete);
+        } else {
+            err = _mm256_or_si256(err, Utf8Errors(a, prev));
+            err = _mm256_or_si256(err, Utf8Errors(b, a));
+            static const char kMax[32] = {
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1)
+            };
+            incomplete = _mm256_subs_epu8(b, _mm256_loadu_si256((const __m256i*)kMax));
+        }
+        prev = b;
+#else
+        unsigned high = 0;
+        for (int i = 0; i < 4; ++i) {
+            const __m128i v = _mm_loadu_si128((const __m128i*)p + i);
+            ctrl(p + 16 * i, CtrlMask(v));
+            high |= (unsigned)_mm_movemask_epi8(v);
+        }
+        if (high || u8.need) u8.feed((const unsigned char*)p, 64);
+#endif
+    }
+
+    // Хвост короче полосы: дополняется пробелами — они ASCII и не управляющие
+    __forceinline TextScan finish(const char* p, size_t n) {
+        alignas(32) char last[64];
+        memset(last, ' ', sizeof(last));
+        memcpy(last, p, n);
+        feed64(last);
+#if defined(__AVX2__)
+        err = _mm256_or_si256(err, incomplete);
+        res.utf8 = _mm256_testz_si256(err, err) != 0;
+#else
+        res.utf8 = u8.finish();
+#endif
+        return res;
+    }
+};
+
+// Только классификация, без хэша (голова крупного файла)
+TextScan ScanText(const char* p, size_t n);
+
+// --- КОДИРОВКА ФАЙЛА: BOM, UTF-16 → UTF-8 ---
+// В all.txt всё в UTF-8. UTF-16 (PowerShell, .rc, .reg, вывод редакторов Windows)
+// узнаётся по BOM, без BOM — по нулям через байт в начале файла, и перекодируется
+// здесь же с подсчётом управляющих символов. Файл, не прошедший проверку UTF-8,
+// где ошибок больше, чем корректных многобайтных последовательностей, считается
+// написанным в ANSI-кодировке системы (cp1251 и т.п.) и перекодируется через неё.
+
+enum TextKind { kTextUtf8, kTextUtf16LE, kTextUtf16BE };
+
+// bom — сколько байт пропустить в начале
+TextKind DetectTextKind(const char* p, size_t n, size_t& bom);
+
+// UTF-16 (без BOM) → out. SSE2: 8 символов за шаг; все < 0x80 → packus в 8 байт,
+// иначе шаг разбирается поштучно (суррогатная пара может зайти в следующий).
+// Непарный суррогат → U+FFFD и считается управляющим, как и нечётный последний байт.
+TextScan Utf16ToUtf8(const char* p, size_t n, bool be, std::string& out);
+
+// Не-UTF-8 файл похож на ANSI, а не на UTF-8 с парой битых байт
+bool LooksLikeAnsi(const char* p, size_t n);
+
+// UTF-16 или ANSI (p — без BOM) → text; false — по содержимому бинарный или не перекодировался
+bool RecodeText(TextKind kind, const char* p, size_t n, std::string& text, std::wstring& wide);
@@ -0,0 +1,183 @@
+#pragma once
+#include "Platform.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cmath>
+#include "Common.h"
+
+// --- ТРАССИРОВКА КОНВЕЙЕРА ДАМПА ("-dump <папка> stats" / "trace") ---
+//
+// Каждый поток конвейера пишет только в свой TraceThread (thread_local, без атомиков
+// и блокировок): гистограмму длительностей на стадию и, в режиме trace, события
+// для Chrome trace (chrome://tracing, Perfetto). Гистограмма log-linear, как HDR:
+// 8 под-корзин на каждую степень двойки наносекунд — погрешность квантилей ≤ 12.5%.
+// Событие короче kTraceMinEventNs в trace не пишется (в гистограмму — да), иначе
+// файл рос бы на каждый файл дерева.
+//
+// Выключенная трассировка — одна проверка t_trace на замер;
+// HELPERS_TRACE=0 убирает замеры из сборки целиком.
+
+#ifndef HELPERS_TRACE
+#define HELPERS_TRACE 1
+#endif
+
+enum TraceStage {
+    kStEnumerate,     // FindFirstFileExW/FindNextFileW + игнор-правила директории
+    kStWaitDir,       // сканер ждёт директорию, которую перечисляет другой поток
+    kStExtents,       // HDD: первый экстент файлов окна (FSCTL_GET_RETRIEVAL_POINTERS)
+    kStOpen,          // CreateFileW + GetFileSizeEx
+    kStMap,           // CreateFileMappingW + MapViewOfFile
+    kStBatchRead,     // BatchReader: открытие + чтение пачки мелких файлов
+    kStHeadCheck,     // кодировка по BOM + HasNullByte по первому килобайту
+    kStHash,          // HashScan: хэш + проверка UTF-8 и управляющих байт
+    kStTranscode,     // UTF-16 / ANSI → UTF-8
+    kStClean,         // CleanContent / ContentFilter (трансформы контента)
+    kStCompress,      // lz4
+    kStWrite,         // чанк в OutBuf (WriteFile, потоковые файлы)
+    kStWaitPath,      // воркер ждёт задачи из pathChan
+    kStWaitOut,       // output-поток ждёт чанки из outChan
+    kStWaitSend,      // отправка в канал (долго — канал полон)
+    kStWaitArena,     // воркер ждёт свободный arena-блок
+    kStWaitOrder,     // номер задачи не влезает в окно переупорядочивания писателя
+    kStWaitBudget,    // сканер ждёт ByteBudget
+    kStCount
+};
+
+static const char* const kTraceStageNames[kStCount] = {
+    "enumerate", "wait_dir", "extents", "open", "map", "batch_read", "head_check", "hash", "transcode", "clean",
+    "compress", "write", "wait_path_chan", "wait_out_chan", "send", "wait_arena", "wait_order",
+    "wait_budget"
+};
+
+struct TraceHist {
+    static const int kSub     = 8;            // под-корзин на степень двойки
+    static const int kBuckets = 64 * kSub;
+
+    ULONGLONG count = 0, sumNs = 0, maxNs = 0;
+    ULONGLONG buckets[kBuckets] = {};
+
+    // 0..7 — точно, дальше: (старший бит - 2) * 8 + следующие 3 бита
+    static __forceinline int bucketOf(ULONGLONG ns) {
+        if (ns < kSub) return (int)ns;
+        unsigned long msb;
+#if defined(_M_IX86)
+        // x86: _BitScanReverse64 нет — по половинам
+        if (_BitScanReverse(&msb, (unsigned long)(ns >> 32))) msb += 32;
+        else _BitScanReverse(&msb, (unsigned long)ns);
+#else
+        _BitScanReverse64(&msb, ns);
+#endif
+        return (int)((msb - 2) * kSub + ((ns >> (msb - 3)) & (kSub - 1)));
+    }
+    static ULONGLONG upperOf(int b) {
+        if (b < kSub) return (ULONGLONG)b;
+        const int msb = b / kSub + 2;
+        return ((ULONGLONG)(kSub + b % kSub + 1) << (msb - 3)) - 1;
+    }
+
+    __forceinline void add(ULONGLONG ns) {
+        ++count; sumNs += ns;
+        if (ns > maxNs) maxNs = ns;
+        ++buckets[bucketOf(ns)];
+    }
+
+    void merge(const TraceHist& o) {
+        count += o.count; sumNs += o.sumNs; maxNs = max(maxNs, o.maxNs);
+        for (int b = 0; b < kBuckets; ++b) buckets[b] += o.buckets[b];
+    }
+
+    // Верхняя граница корзины, в которую попал q-квантиль
+    ULONGLONG percentile(double q) const {
+        const ULONGLONG target = max(1ULL, (ULONGLONG)ceil(q * (double)count));
+        ULONGLONG acc = 0;
+        for (int b = 0; b < kBuckets; ++b)
+            if ((acc += buckets[b]) >= target) return min(upperOf(b), maxNs);
+        return maxNs;
+    }
+};
+
+struct TraceEvent {
+    LONGLONG t0, t1;
+    int      stage;
+};
+
+struct TraceThread {
+    const char*             role;         // "scanner", "walker", "worker", "writer"
+    DWORD                   tid;
+    bool                    keepEvents;   // режим trace: писать и события
+    TraceHist               hist[kStCount];
+    std::vector<TraceEvent> events;
+};
+
+// Глубина очередей и резерв бюджета — сэмплер в GenerateAllTxt, раз в ~1 мс
+struct TraceSample {
+    LONGLONG  t;
+    ULONGLONG pathDepth, outDepth, inFlight;
+};
+
+// Трассировка одного прогона (EngineContext::trace): потоки регистрируются под mutex,
+// читает TraceWriteReport после join. mode — 0 выкл, 1 — гистограммы (all.stats.json),
+// 2 — плюс события (all.trace.json).
+struct TraceLog {
+    std::mutex                                mutex;
+    std::vector<std::unique_ptr<TraceThread>> threads;
+    std::vector<TraceSample>                  samples;
+    LONGLONG                                  start = 0;
+    int                                       mode  = 0;
+};
+
+inline thread_local TraceThread* t_trace = nullptr;
+
+static const ULONGLONG kTraceMinEventNs = 20 * 1000;
+static const size_t    kTraceMaxEvents  = 1 << 20;    // на поток
+
+inline void TraceReset(TraceLog& log, int mode) {
+    std::lock_guard<std::mutex> lk(log.mutex);
+    log.threads.clear();
+    log.samples.clear();
+    log.start = QpcNow();
+    log.mode  = mode;
+}
+
+// В начале каждого потока конвейера. Без трассировки только сбрасывает t_trace.
+inline void TraceThreadBegin(TraceLog& log, const char* role) {
+    t_trace = nullptr;
+    if (!HELPERS_TRACE || !log.mode) return;
+    std::unique_ptr<TraceThread> t(new TraceThread);
+    t->role       = role;
+    t->tid        = GetCurrentThreadId();
+    t->keepEvents = log.mode > 1;
+    t_trace = t.get();
+    std::lock_guard<std::mutex> lk(log.mutex);
+    log.threads.push_back(std::move(t));
+}
+
+inline void TraceRecord(TraceStage st, LONGLONG t0, LONGLONG t1) {
+    TraceThread* t = t_trace;
+    const ULONGLONG ns = (ULONGLONG)(QpcToMs(t1 - t0) * 1e6);
+    t->hist[st].add(ns);
+    if (t->keepEvents && ns >= kTraceMinEventNs && t->events.size() < kTraceMaxEvents)
+        t->events.push_back({ t0, t1, st });
+}
+
+// TRACE_SCOPE — до конца блока; TRACE_SPAN/TRACE_DONE — участок, который может
+// оборваться continue/return (тогда замер закрывает деструктор)
+#if HELPERS_TRACE
+struct TraceSpan {
+    TraceStage st;
+    LONGLONG   t0;
+    explicit TraceSpan(TraceStage s) : st(s), t0(t_trace ? QpcNow() : 0) {}
+    ~TraceSpan() { done(); }
+    void done() { if (t0) { TraceRecord(st, t0, QpcNow()); t0 = 0; } }
+};
+#define TRACE_CAT2(a, b)      a##b
+#define TRACE_CAT(a, b)       TRACE_CAT2(a, b)
+#define TRACE_SCOPE(st)       TraceSpan TRACE_CAT(traceSpan, __LINE__)(st)
+#define TRACE_SPAN(var, st)   TraceSpan var(st)
+#define TRACE_DONE(var)       var.done()
+#else
+#define TRACE_SCOPE(st)       ((void)0)
+#define TRACE_SPAN(var, st)   ((void)0)
+#define TRACE_DONE(var)       ((void)0)
+#endif
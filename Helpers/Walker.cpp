@@ -0,0 +1,270 @@
+#include "Walker.h"
+#ifdef _WIN32
+#include <winioctl.h>    // IOCTL_STORAGE_QUERY_PROPERTY
+#else
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/sysmacros.h>
+#endif
+#endif
+
+#ifdef _WIN32
+bool Win32DirSource::open(const std::wstring& dirPath) {
+    const std::wstring pattern = dirPath + L'*';
+    hFind = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &fd,
+        FindExSearchNameMatch, NULL,
+        FIND_FIRST_EX_LARGE_FETCH | FIND_FIRST_EX_CASE_SENSITIVE);
+    have = hFind != INVALID_HANDLE_VALUE;
+    return have;
+}
+
+bool Win32DirSource::next(std::wstring& names, std::vector<WalkItem>& items) {
+    for (size_t k = 0; have && k < kBatch; have = FindNextFileW(hFind, &fd) != FALSE) {
+        const wchar_t* name = fd.cFileName;
+        const bool isDir = (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        if (isDir && name[0] == L'.' && (name[1] == L'\0' || (name[1] == L'.' && name[2] == L'\0'))) continue;
+
+        DWORD nl = (DWORD)wcslen(name);
+        WalkItem it;
+        it.nameOff = (DWORD)names.size();
+        it.nameLen = nl;
+        it.attrs   = fd.dwFileAttributes;
+        it.size    = ((ULONGLONG)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+        it.mtime   = fd.ftLastWriteTime;
+        it.child   = -1;
+        names.append(name, nl + 1);
+        items.push_back(it);
+        ++k;
+    }
+    return have;
+}
+
+void Win32DirSource::close() {
+    if (hFind != INVALID_HANDLE_VALUE) FindClose(hFind);
+    hFind = INVALID_HANDLE_VALUE;
+    have  = false;
+}
+#else
+bool PosixDirSource::open(const std::wstring& dirPath) {
+    const int fd = openat(AT_FDCWD, PosixPath(dirPath).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+    dir = fdopendir(fd);
+    if (!dir) ::close(fd);
+    return dir != nullptr;
+}
+
+bool PosixDirSource::next(std::wstring& names, std::vector<WalkItem>& items) {
+    if (!dir) return false;
+    for (size_t k = 0; k < kBatch;) {
+        const dirent* de = readdir(dir);
+        if (!de) return false;
+        const char* n = de->d_name;
+        if (n[0] == '.' && (n[1] == '\0' || (n[1] == '.' && n[2] == '\0'))) continue;
+        if (strchr(n, '\\')) continue;
+
+        struct stat st;
+        DWORD attrs = 0;
+        if (fstatat(dirfd(dir), n, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+        if (S_ISLNK(st.st_mode)) {
+            if (fstatat(dirfd(dir), n, &st, 0) != 0 || !S_ISREG(st.st_mode)) continue;
+            attrs |= FILE_ATTRIBUTE_REPARSE_POINT;
+        }
+        if (S_ISDIR(st.st_mode))       attrs |= FILE_ATTRIBUTE_DIRECTORY;
+        else if (!S_ISREG(st.st_mode)) continue;
+        if (!(st.st_mode & S_IWUSR))   attrs |= FILE_ATTRIBUTE_READONLY;
+        if (n[0] == '.')               attrs |= FILE_ATTRIBUTE_HIDDEN;
+        if (!attrs)                    attrs  = FILE_ATTRIBUTE_NORMAL;
+
+        const int len = (int)strlen(n);
+        name.resize((size_t)len);
+        const int wn = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, n, len, &name[0], len);
+        if (wn <= 0) continue;
+        name.resize((size_t)wn);
+
+        // FILETIME: сотни наносекунд от 1601-01-01
+        const ULONGLONG ft = ((ULONGLONG)st.st_mtim.tv_sec + 11644473600ULL) * 10000000ULL
+                           + (ULONGLONG)st.st_mtim.tv_nsec / 100;
+        WalkItem it;
+        it.nameOff = (DWORD)names.size();
+        it.nameLen = (DWORD)wn;
+        it.attrs   = attrs;
+        it.size    = S_ISDIR(st.st_mode) ? 0 : (ULONGLONG)st.st_size;
+        it.mtime.dwLowDateTime  = (DWORD)ft;
+        it.mtime.dwHighDateTime = (DWORD)(ft >> 32);
+        it.child   = -1;
+        names.append(name.c_str(), (size_t)wn + 1);
+        items.push_back(it);
+        ++k;
+    }
+    return true;
+}
+
+void PosixDirSource::close() {
+    if (dir) closedir(dir);   // закрывает и дескриптор из openat
+    dir = nullptr;
+}
+#endif
+
+std::shared_ptr<const IgnoreScope> DirIgnoreScope(const std::wstring& dirPath, size_t baseLen,
+        std::shared_ptr<const IgnoreScope> scope, bool hasGit, bool hasIgn) {
+    if (!hasGit && !hasIgn) return scope;
+    auto sc = std::make_shared<IgnoreScope>();
+    if (hasGit) LoadIgnoreFile(dirPath + L".gitignore", sc->rules);
+    if (hasIgn) LoadIgnoreFile(dirPath + L".ignore",    sc->rules);
+    if (sc->rules.empty()) return scope;
+    sc->parent  = std::move(scope);
+    sc->baseLen = baseLen;
+    return sc;
+}
+
+void FilterDirEntries(DirNode& n, size_t rootLen) {
+    std::shared_ptr<const IgnoreScope> scope = n.ignore;
+
+    std::wstring rel;                       // путь от корня: '/' и FoldChar-регистр
+    rel.reserve(n.path.size() - rootLen + MAX_PATH);
+    for (size_t i = rootLen; i < n.path.size(); ++i)
+        rel += n.path[i] == L'\\' ? L'/' : FoldChar(n.path[i]);
+    const size_t dirLen = rel.size();
+
+    bool hasGit = false, hasIgn = false;
+    for (const WalkItem& it : n.items) {
+        if (it.attrs & FILE_ATTRIBUTE_DIRECTORY) continue;
+        if      (_wcsicmp(n.name(it), L".gitignore") == 0) hasGit = true;
+        else if (_wcsicmp(n.name(it), L".ignore")    == 0) hasIgn = true;
+    }
+    scope = DirIgnoreScope(n.path, dirLen, std::move(scope), hasGit, hasIgn);
+
+    size_t keep = 0;
+    for (size_t i = 0; i < n.items.size(); ++i) {
+        WalkItem       it    = n.items[i];
+        const wchar_t* name  = n.name(it);
+        const bool     isDir = (it.attrs & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        if (scope) {
+            rel.resize(dirLen);
+            for (DWORD k = 0; k < it.nameLen; ++k) rel += FoldChar(name[k]);
+            if (IsIgnored(scope.get(), rel.c_str() + dirLen, it.nameLen, rel, isDir)) continue;
+        }
+        if (isDir) {
+            auto sub = std::make_shared<DirNode>();
+            sub->path.reserve(n.path.size() + it.nameLen + 1);
+            sub->path.append(n.path).append(name, it.nameLen) += L'\\';
+            sub->ignore = scope;
+            it.child = (int)n.children.size();
+            n.children.push_back(std::move(sub));
+        }
+        n.items[keep++] = it;
+    }
+    n.items.resize(keep);
+}
+
+int WalkerThreads(bool ssd) {
+    return ssd ? max(2, min(8, (int)std::thread::hardware_concurrency() / 2)) : 0;
+}
+
+#ifdef _WIN32
+VolumeKind ClassifyVolume(const wchar_t* path) {
+    wchar_t volumePath[MAX_PATH] = {};
+    if (!GetVolumePathNameW(path, volumePath, MAX_PATH)) return kVolUnknown;
+    if ((volumePath[0] == L'\\' && volumePath[1] == L'\\') || GetDriveTypeW(volumePath) == DRIVE_REMOTE)
+        return kVolRemote;
+
+    // Из "C:\" делаем "\\.\C:" для DeviceIoControl
+    if (wcslen(volumePath) < 2 || volumePath[1] != L':') return kVolUnknown;
+    wchar_t devPath[] = { L'\\',L'\\',L'.',L'\\', volumePath[0], L':', L'\0' };
+
+    HANDLE hDev = CreateFileW(devPath, 0, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING, 0, NULL);
+    if (hDev == INVALID_HANDLE_VALUE) return kVolUnknown;
+
+    STORAGE_PROPERTY_QUERY query = {};
+    query.PropertyId = StorageDeviceSeekPenaltyProperty;
+    query.QueryType  = PropertyStandardQuery;
+
+    DEVICE_SEEK_PENALTY_DESCRIPTOR desc = {};
+    DWORD bytesReturned = 0;
+    VolumeKind kind = kVolUnknown;
+
+    if (DeviceIoControl(hDev, IOCTL_STORAGE_QUERY_PROPERTY,
+            &query, sizeof(query), &desc, sizeof(desc), &bytesReturned, NULL))
+        kind = desc.IncursSeekPenalty ? kVolHdd : kVolSsd;
+
+    CloseHandle(hDev);
+    return kind;
+}
+
+#else
+VolumeKind ClassifyVolume(const wchar_t* path) {
+    const std::string p = PosixPath(path);
+    struct statfs fs;
+    if (statfs(p.c_str(), &fs) != 0) return kVolUnknown;
+    switch ((unsigned long)fs.f_type) {
+        case 0x6969:         // NFS
+        case 0x517B:         // SMB
+        case 0xFF534D42:     // CIFS
+        case 0xFE534D42:     // SMB2
+            return kVolRemote;
+    }
+#if defined(__linux__)
+    // Раздел: queue/ лежит у родительского устройства, отсюда второй путь
+    struct stat st;
+    if (stat(p.c_str(), &st) != 0) return kVolUnknown;
+    char sys[96];
+    for (const char* fmt : { "/sys/dev/block/%u:%u/queue/rotational", "/sys/dev/block/%u:%u/../queue/rotational" }) {
+        snprintf(sys, sizeof(sys), fmt, major(st.st_dev), minor(st.st_dev));
+        if (FILE* f = fopen(sys, "r")) {
+            const int c = fgetc(f);
+            fclose(f);
+            if (c == '0' || c == '1') return c == '1' ? kVolHdd : kVolSsd;
+        }
+    }
+#endif
+    return kVolUnknown;
+}
+#endif
+
+bool IsPathOnSSD(const wchar_t* path) {
+    return ClassifyVolume(path) != kVolHdd;
+}
+
+#ifdef _WIN32
+ULONGLONG FirstExtentLcn(const wchar_t* path) {
+    HANDLE h = CreateFileW(path, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, 0, NULL);
+    if (h == INVALID_HANDLE_VALUE) return 0;
+
+    STARTING_VCN_INPUT_BUFFER in  = {};
+    RETRIEVAL_POINTERS_BUFFER out = {};
+    DWORD got = 0;
+    // Буфер на один экстент: ERROR_MORE_DATA у фрагментированного файла — нормальный исход
+    const BOOL ok = DeviceIoControl(h, FSCTL_GET_RETRIEVAL_POINTERS, &in, sizeof(in), &out, sizeof(out), &got, NULL);
+    const bool have = (ok || GetLastError() == ERROR_MORE_DATA) && out.ExtentCount > 0 && out.Extents[0].Lcn.QuadPart > 0;
+    CloseHandle(h);
+    return have ? (ULONGLONG)out.Extents[0].Lcn.QuadPart : 0;
+}
+
+#else
+ULONGLONG FirstExtentLcn(const wchar_t* path) {
+#if defined(__linux__)
+    const int fd = open(PosixPath(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    alignas(8) char buf[sizeof(fiemap) + sizeof(fiemap_extent)] = {};
+    fiemap* m = (fiemap*)buf;
+    m->fm_length       = ~0ULL;
+    m->fm_extent_count = 1;
+    const bool ok = ioctl(fd, FS_IOC_FIEMAP, m) == 0 && m->fm_mapped_extents > 0 &&
+                    !(m->fm_extents[0].fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE));
+    close(fd);
+    return ok ? (ULONGLONG)(m->fm_extents[0].fe_physical >> 12) : 0;
+#else
+    (void)path;
+    return 0;
+#endif
+}
+#endif
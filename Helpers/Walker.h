@@ -0,0 +1,284 @@
+#pragma once
+#include "Platform.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+#include "Engine.h"
+#include "Ignore.h"
+
+// --- ПАРАЛЛЕЛЬНЫЙ ОБХОД ДЕРЕВА: WORK-STEALING ---
+//
+// [Поток 0..N-1]: чтение директорий (бэкенд Source) по своей очереди,
+//                 пустая очередь → воруем самую старую (= самую крупную) у соседей.
+// [Вызывающий поток]: отдаёт записи потребителю строго в порядке последовательного
+//                 DFS; если нужная директория ещё никем не взята — читает её сам.
+//
+// Итог: перечисление идёт параллельно, а порядок вывода для неизменного дерева
+// тот же, что у однопоточного обхода. Без потоков (N = 0) — обычный DFS.
+// Забег вперёд ограничен: прочитанные, но ещё не пройденные потребителем записи
+// считаются в ahead, и выше kWalkAhead потоки ждут (потребитель может стоять
+// на ByteBudget дампа — без лимита в памяти оказалось бы всё дерево).
+// Игнор-правила применяются сразу после чтения директории: исключённые записи
+// в узел не попадают, исключённые поддиректории не читаются вовсе.
+
+struct DirNode;
+
+struct WalkItem {
+    DWORD     nameOff;   // смещение имени в DirNode::names (имя с завершающим '\0')
+    DWORD     nameLen;
+    DWORD     attrs;
+    ULONGLONG size;
+    FILETIME  mtime;
+    int       child;     // индекс в DirNode::children, -1 для файлов
+};
+
+struct DirNode {
+    enum { kPending, kClaimed, kDone };
+
+    std::wstring                          path;     // полный путь с завершающим '\\'
+    std::wstring                          names;
+    std::vector<WalkItem>                 items;    // в порядке перечисления
+    std::vector<std::shared_ptr<DirNode>> children;
+    std::shared_ptr<const IgnoreScope>    ignore;   // правила, действующие в этой директории
+    std::atomic<int>                      state{ kPending };
+
+    const wchar_t* name(const WalkItem& it) const { return names.c_str() + it.nameOff; }
+};
+
+// Бэкенд перечисления: open — начать чтение директории (путь с завершающим '\\'),
+// next — дописать в names/items очередную пачку записей (child = -1, без "." и ".."),
+// false — записей больше нет. DirWalker параметризован бэкендом; платформенно-зависимый
+// код обхода сосредоточен только в нём. Win32DirSource — FindFirstFileExW/FindNextFileW,
+// PosixDirSource — openat/fdopendir/readdir + fstatat относительно дескриптора директории.
+#ifdef _WIN32
+struct Win32DirSource {
+    static const size_t kBatch = 256;
+
+    HANDLE           hFind = INVALID_HANDLE_VALUE;
+    WIN32_FIND_DATAW fd    = {};
+    bool             have  = false;   // в fd лежит ещё не отданная запись
+
+    bool open(const std::wstring& dirPath);
+    bool next(std::wstring& names, std::vector<WalkItem>& items);
+    void close();
+};
+#else
+// Ссылка на директорию не раскрывается (цикл), на файл — как сам файл.
+// FIFO, сокеты и устройства пропускаются: чтение FIFO повесило бы дамп.
+// Имена не в UTF-8 и с '\\' пропускаются: путь ядра из них обратно не собрать.
+// Атрибуты — в терминах Win32: точка в начале имени = HIDDEN, нет права записи = READONLY.
+struct PosixDirSource {
+    static const size_t kBatch = 256;
+
+    DIR*         dir = nullptr;
+    std::wstring name;
+
+    bool open(const std::wstring& dirPath);
+    bool next(std::wstring& names, std::vector<WalkItem>& items);
+    void close();
+};
+#endif
+
+// Читает одну директорию целиком в узел; отмена прерывает между пачками
+template<typename Source>
+void ReadDirEntries(DirNode& n, const EngineContext& ctx) {
+    Source src;
+    if (!src.open(n.path)) return;
+    while (src.next(n.names, n.items) && !ctx.cancelled()) {}
+    src.close();
+}
+
+// Правила .gitignore / .ignore директории dirPath поверх scope; baseLen — длина её rel
+std::shared_ptr<const IgnoreScope> DirIgnoreScope(const std::wstring& dirPath, size_t baseLen,
+        std::shared_ptr<const IgnoreScope> scope, bool hasGit, bool hasIgn);
+
+// Подхватывает .gitignore/.ignore директории, выкидывает исключённые записи
+// и заводит узлы только для оставшихся поддиректорий. rootLen — длина пути корня.
+void FilterDirEntries(DirNode& n, size_t rootLen);
+
+static const size_t kWalkAhead = 256 * 1024;   // записей (~20 МБ с именами)
+
+struct alignas(64) WalkQueue {
+    std::mutex                            mtx;
+    std::deque<std::shared_ptr<DirNode>>  q;
+};
+
+template<typename Source>
+struct DirWalkerT {
+    std::vector<std::unique_ptr<WalkQueue>> queues;   // [0..N-1] — потоки, [N] — вызывающий
+    std::vector<std::thread>                threads;
+    std::atomic<int>                        queued{ 0 };
+    std::atomic<size_t>                     ahead{ 0 };   // записи прочитанных, но не пройденных узлов
+    std::atomic<bool>                       stop{ false };
+    size_t                                  rootLen = 0;
+    EngineContext&                          ctx;
+
+    DirWalkerT(int numThreads, EngineContext& c) : ctx(c) {
+        for (int i = 0; i <= numThreads; ++i) queues.push_back(std::make_unique<WalkQueue>());
+    }
+
+    // Перечисляет узел, если он ещё не взят другим потоком.
+    // Поддиректории кладутся в свою очередь в обратном порядке: владелец
+    // снимает с хвоста и идёт в глубину в порядке DFS, воры берут с головы.
+    void readNode(const std::shared_ptr<DirNode>& n, int self) {
+        int expected = DirNode::kPending;
+        if (!n->state.compare_exchange_strong(expected, DirNode::kClaimed)) return;
+
+        {
+            TRACE_SCOPE(kStEnumerate);
+            ReadDirEntries<Source>(*n, ctx);
+            FilterDirEntries(*n, rootLen);
+        }
+        ctx.progress.add(EngineProgress::kDirs);
+        ctx.progress.add(EngineProgress::kFilesFound, n->items.size() - n->children.size());
+        ahead.fetch_add(n->items.size());
+
+        if (!n->children.empty() && threads.size()) {
+            WalkQueue& wq = *queues[self];
+            {
+                std::lock_guard<std::mutex> lk(wq.mtx);
+                for (auto it = n->children.rbegin(); it != n->children.rend(); ++it)
+                    wq.q.push_back(*it);
+            }
+            if (queued.fetch_add((int)n->children.size()) == 0) queued.notify_all();
+        }
+
+        n->state.store(DirNode::kDone, std::memory_order_release);
+        n->state.notify_all();
+    }
+
+    bool popOrSteal(int self, std::shared_ptr<DirNode>& out) {
+        {
+            WalkQueue& own = *queues[self];
+            std::lock_guard<std::mutex> lk(own.mtx);
+            if (!own.q.empty()) { out = std::move(own.q.back()); own.q.pop_back(); --queued; return true; }
+        }
+        const int n = (int)queues.size();
+        for (int k = 1; k < n; ++k) {
+            const int v = (self + k) % n;
+            WalkQueue& victim = *queues[v];
+            std::lock_guard<std::mutex> lk(victim.mtx);
+            if (victim.q.empty()) continue;
+            // Очередь вызывающего потока разбираем с хвоста: там ближайшие по DFS
+            // директории, которые ему понадобятся первыми.
+            if (v == n - 1) { out = std::move(victim.q.back());  victim.q.pop_back(); }
+            else            { out = std::move(victim.q.front()); victim.q.pop_front(); }
+            --queued;
+            return true;
+        }
+        return false;
+    }
+
+    void threadFn(int self) {
+        TraceThreadBegin(ctx.trace, "walker");
+        std::shared_ptr<DirNode> n;
+        while (!stop.load(std::memory_order_relaxed)) {
+            const size_t a = ahead.load();
+            if (a >= kWalkAhead) { ahead.wait(a); continue; }   // ждём потребителя
+            if (popOrSteal(self, n)) { readNode(n, self); n.reset(); continue; }
+            int q = queued.load();
+            if (q == 0) queued.wait(0);
+            else        std::this_thread::yield();
+        }
+    }
+
+    void waitReady(const std::shared_ptr<DirNode>& n) {
+        readNode(n, (int)queues.size() - 1);
+        TRACE_SCOPE(kStWaitDir);
+        int s;
+        while ((s = n->state.load(std::memory_order_acquire)) != DirNode::kDone)
+            n->state.wait(s);
+    }
+
+    // onFile(const DirNode& dir, const WalkItem& it) вызывается в текущем потоке
+    // для каждого файла в порядке DFS. Пройденные узлы сразу освобождаются.
+    // Поддерево (-watch): ignore — правила, действующие в rootPath (без его
+    // собственных), treeLen — длина пути корня всего дерева.
+    template<typename F>
+    void run(const std::wstring& rootPath, F&& onFile,
+             std::shared_ptr<const IgnoreScope> ignore = nullptr, size_t treeLen = 0) {
+        const int numThreads = (int)queues.size() - 1;
+        rootLen = treeLen ? treeLen : rootPath.size();
+        for (int i = 0; i < numThreads; ++i)
+            threads.emplace_back(&DirWalkerT::threadFn, this, i);
+
+        struct Frame { std::shared_ptr<DirNode> node; size_t next; };
+        std::vector<Frame> stk;
+        stk.reserve(64);
+
+        auto root = std::make_shared<DirNode>();
+        root->path   = rootPath;
+        root->ignore = ignore ? std::move(ignore) : LoadBaseIgnore();
+        waitReady(root);
+        stk.push_back({ std::move(root), 0 });
+
+        while (!stk.empty() && !ctx.cancelled()) {
+            Frame& f = stk.back();
+            if (f.next == f.node->items.size()) {
+                const size_t done = f.node->items.size();
+                stk.pop_back();
+                if (ahead.fetch_sub(done) >= kWalkAhead && ahead.load() < kWalkAhead) ahead.notify_all();
+                continue;
+            }
+
+            const DirNode&  dir = *f.node;
+            const WalkItem& it  = dir.items[f.next++];
+
+            if (it.child >= 0) {
+                std::shared_ptr<DirNode> sub = std::move(f.node->children[it.child]);
+                waitReady(sub);
+                stk.push_back({ std::move(sub), 0 });
+            } else {
+                onFile(dir, it);
+            }
+        }
+
+        stop = true;
+        queued.fetch_add(1);
+        queued.notify_all();
+        ahead.store(0);
+        ahead.notify_all();
+        for (auto& t : threads) t.join();
+        threads.clear();
+    }
+};
+
+#ifdef _WIN32
+typedef DirWalkerT<Win32DirSource> DirWalker;
+#else
+typedef DirWalkerT<PosixDirSource> DirWalker;
+#endif
+
+// Потоки перечисления: на HDD параллельный FindNextFileW только гоняет головку
+int WalkerThreads(bool ssd);
+
+// --- ОПРЕДЕЛЕНИЕ ТИПА ДИСКА (SSD / HDD / СЕТЬ) ---
+// Использует IOCTL_STORAGE_QUERY_PROPERTY → IncursSeekPenalty.
+// SSD = нет штрафа за seek → можно много параллельных потоков.
+// HDD = есть штраф      → параллельность вредит (head thrashing).
+// Сеть (UNC, подключённый диск) = предел — задержка, а не seek: нужно больше
+// запросов в полёте. Не определили — kVolUnknown, а не «SSD».
+// Linux: queue/rotational блочного устройства тома (sysfs), сеть — по типу ФС (statfs).
+enum VolumeKind { kVolSsd, kVolHdd, kVolRemote, kVolUnknown };
+static const char* const kVolumeKindNames[] = { "ssd", "hdd", "remote", "unknown" };
+VolumeKind ClassifyVolume(const wchar_t* path);
+
+// Только HDD требует осторожности; остальное параллелим
+bool IsPathOnSSD(const wchar_t* path);
+
+// Первый кластер данных файла на томе — ключ elevator-сортировки чтений на HDD.
+// 0 — неизвестно: файл резидентный (данные в его записи MFT), начинается с дыры
+// (сжатый/разреженный) или ФС не отдаёт карту размещения (FAT, сеть).
+// Linux: FIEMAP, физическое смещение первого экстента в блоках по 4 КБ.
+ULONGLONG FirstExtentLcn(const wchar_t* path);
+
+inline ULONGLONG FileTimeToU64(const FILETIME& ft) {
+    return ((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}